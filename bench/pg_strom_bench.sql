@@ -0,0 +1,38 @@
+--
+-- pg_strom_bench.sql
+--
+-- Micro benchmarks of PG-Strom's internal facilities; not a part of the
+-- extension, so they are never installed by CREATE EXTENSION.
+--
+-- The shared memory allocator works only on the segment being set up by
+-- the postmaster with PG-Strom loaded, and the ring buffer benchmark runs
+-- the same code as the server queue; so the benchmarks are built into
+-- pg_strom.so and run inside of a live server, rather than as a separate
+-- program. Run this script as superuser on the database where you want to
+-- run them, e.g:
+--
+--   psql -f bench/pg_strom_bench.sql
+--   SELECT pgstrom_mqueue_ring_bench(4, 4, 1000000);
+--   SELECT pgstrom_shmem_alloc_bench(65536, 100000, 32);
+--
+-- To measure the allocator under contention, run the latter on multiple
+-- sessions concurrently; e.g, using pgbench with a custom script.
+-- Drop them with the DROP FUNCTION at the tail of this file.
+--
+
+-- pgstrom_mqueue_ring_bench(nproducers, nconsumers, nitems)
+--   returns number of items transferred per second
+CREATE OR REPLACE FUNCTION pgstrom_mqueue_ring_bench(int4, int4, int8)
+  RETURNS float8
+  AS '$libdir/pg_strom'
+  LANGUAGE C STRICT;
+
+-- pgstrom_shmem_alloc_bench(size, nloops, nkeeps)
+--   returns average latency of a pair of alloc/free in microseconds
+CREATE OR REPLACE FUNCTION pgstrom_shmem_alloc_bench(int8, int4, int4)
+  RETURNS float8
+  AS '$libdir/pg_strom'
+  LANGUAGE C STRICT;
+
+-- DROP FUNCTION pgstrom_mqueue_ring_bench(int4, int4, int8);
+-- DROP FUNCTION pgstrom_shmem_alloc_bench(int8, int4, int4);
@@ -17,12 +17,19 @@
  * GNU General Public License for more details.
  */
 #include "postgres.h"
+#include "access/htup_details.h"
 #include "access/relscan.h"
 #include "access/sysattr.h"
+#include "access/xact.h"
+#include "access/xlog.h"
 #include "catalog/pg_type.h"
+#include "common/relpath.h"
 #include "miscadmin.h"
 #include "port.h"
+#include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
 #include "storage/predicate.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -30,6 +37,9 @@
 #include "utils/tqual.h"
 #include "pg_strom.h"
 #include "opencl_numeric.h"
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
 
 /*
  * pgstrom_create_param_buffer
@@ -177,8 +187,12 @@ pgstrom_fetch_data_store(TupleTableSlot *slot,
 	if (row_index >= kds->nitems)
 		return false;	/* out of range */
 
-	/* in case of row-store */
-	if (kds->format == KDS_FORMAT_ROW)
+	/*
+	 * in case of row-store; column-store also keeps the original tuples
+	 * on the pinned shared buffers
+	 */
+	if (kds->format == KDS_FORMAT_ROW ||
+		kds->format == KDS_FORMAT_COLUMN)
 	{
 		kern_rowitem   *ritem = KERN_DATA_STORE_ROWITEM(kds, row_index);
 		kern_blkitem   *bitem;
@@ -189,7 +203,10 @@ pgstrom_fetch_data_store(TupleTableSlot *slot,
 		bitem = KERN_DATA_STORE_BLKITEM(kds, ritem->blk_index);
 		lpp = PageGetItemId(bitem->page, ritem->item_offset);
 		Assert(ItemIdIsNormal(lpp));
-		blknum = BufferGetBlockNumber(bitem->buffer);
+		if (BufferIsInvalid(bitem->buffer) && pds->direct_blknums)
+			blknum = pds->direct_blknums[ritem->blk_index];
+		else
+			blknum = BufferGetBlockNumber(bitem->buffer);
 
 		tuple->t_data = (HeapTupleHeader) PageGetItem(bitem->page, lpp);
 		tuple->t_len = ItemIdGetLength(lpp);
@@ -306,6 +323,17 @@ pgstrom_release_data_store(pgstrom_data_store *pds)
 		pgstrom_release_data_store(pds->ktoast);
 	if (pds->local_pages)
 		pgstrom_shmem_free(pds->local_pages);
+	if (pds->dma_staging)
+		pgstrom_shmem_free(pds->dma_staging);
+	if (pds->direct_blknums)
+		pgstrom_shmem_free(pds->direct_blknums);
+	/*
+	 * The budget being charged is released when shared memory is actually
+	 * freed. If OpenCL server releases it, the source backend was already
+	 * aborted, and all of its budget was released at end of transaction.
+	 */
+	if (pds->reserved > 0 && !pgstrom_i_am_clserv)
+		pgstrom_shmem_unreserve(pds->reserved);
 	pgstrom_shmem_free(pds);
 }
 
@@ -374,6 +402,7 @@ init_kern_data_store(kern_data_store *kds,
 		kds->colmeta[i].attlen = attlen;
 		kds->colmeta[i].attnum = attnum;
 		kds->colmeta[i].attcacheoff = attcacheoff;
+		kds->colmeta[i].cs_offset = 0;	/* only column-format */
 		if (attcacheoff >= 0)
 			attcacheoff += attlen;
 	}
@@ -428,6 +457,9 @@ __pgstrom_create_data_store_row(const char *filename, int lineno,
 		pds->resowner = ResourceOwnerCreate(CurrentResourceOwner,
 											"pgstrom_data_store");
 		pds->local_pages = NULL;	/* allocation on demand */
+		pds->dma_staging = NULL;	/* allocation on demand */
+		pds->direct_blknums = NULL;	/* allocation on demand */
+		pds->reserved = 0;
 	}
 	PG_CATCH();
 	{
@@ -483,6 +515,9 @@ __pgstrom_create_data_store_row_flat(const char *filename, int lineno,
 	pds->ktoast = NULL;		/* never used */
 	pds->resowner = NULL;	/* never used */
 	pds->local_pages = NULL;/* never used */
+	pds->dma_staging = NULL;/* never used */
+	pds->direct_blknums = NULL;/* never used */
+	pds->reserved = 0;
 
 	return pds;
 }
@@ -524,6 +559,9 @@ __pgstrom_create_data_store_tupslot(const char *filename, int lineno,
 	pds->ktoast = NULL;		/* assigned on demand */
 	pds->resowner = NULL;	/* never used for tuple-slot */
 	pds->local_pages = NULL;/* never used for tuple-slot */
+	pds->dma_staging = NULL;/* never used for tuple-slot */
+	pds->direct_blknums = NULL;/* never used for tuple-slot */
+	pds->reserved = 0;
 
 	return pds;
 }
@@ -553,10 +591,36 @@ pgstrom_put_data_store(pgstrom_data_store *pds)
 		pgstrom_release_data_store(pds);
 }
 
+/*
+ * pgstrom_data_store_shmem_length
+ *
+ * It returns total length of shared memory being consumed by the
+ * data-store, for accounting of the reservation budget. Row-store may
+ * also have a staging buffer for DMA send, allocated by OpenCL server on
+ * demand, so it is accounted as well.
+ */
+Size
+pgstrom_data_store_shmem_length(pgstrom_data_store *pds)
+{
+	kern_data_store	*kds = pds->kds;
+	Size			length = sizeof(pgstrom_data_store) + kds->length;
+
+	if (pds->ktoast)
+		length += pgstrom_data_store_shmem_length(pds->ktoast);
+	if (pds->local_pages)
+		length += BLCKSZ * kds->maxblocks;
+	if (pds->direct_blknums)
+		length += sizeof(BlockNumber) * kds->maxblocks;
+	if (kds->format == KDS_FORMAT_ROW && opencl_dma_staging_threshold > 0)
+		length += BLCKSZ * kds->nblocks;
+	return length;
+}
+
 int
 pgstrom_data_store_insert_block(pgstrom_data_store *pds,
 								Relation rel, BlockNumber blknum,
-								Snapshot snapshot, bool page_prune)
+								Snapshot snapshot, bool page_prune,
+								BufferAccessStrategy strategy)
 {
 	kern_data_store	*kds = pds->kds;
 	kern_rowitem   *ritem;
@@ -584,8 +648,15 @@ pgstrom_data_store_insert_block(pgstrom_data_store *pds,
 	{
 		CurrentResourceOwner = pds->resowner;
 
-		/* load the target buffer */
-		buffer = ReadBuffer(rel, blknum);
+		/*
+		 * load the target buffer; if strategy is given, it shall be
+		 * loaded via the ring buffer not to thrash the shared buffer.
+		 * Buffers are pinned by pds->resowner until release of the
+		 * data-store, so pages referenced by in-flight chunks never
+		 * get evicted, even if the ring wraps around.
+		 */
+		buffer = ReadBufferExtended(rel, MAIN_FORKNUM, blknum,
+									RBM_NORMAL, strategy);
 
 		/* Just like heapgetpage(), however, jobs we focus on is OLAP
 		 * workload, so it's uncertain whether we should vacuum the page
@@ -680,8 +751,8 @@ pgstrom_data_store_insert_block(pgstrom_data_store *pds,
 			 * all the expected local-pages at once. It has two another
 			 * benefit; 1. duplicated pages tend to have continuous address
 			 * that may reduce number of DMA call, 2. memory allocation
-			 * request to BLCKSZ actually consumes 2*BLCKSZ because of
-			 * additional fields that does not fit 2^N manner.
+			 * request to BLCKSZ actually consumes one more shmem block
+			 * for the header fields, but it is amortized.
 			 */
 			if (!pds->local_pages)
 			{
@@ -709,6 +780,397 @@ pgstrom_data_store_insert_block(pgstrom_data_store *pds,
 	return ntup;
 }
 
+/*
+ * Direct relation reader
+ *
+ * On a scan far larger than shared_buffers, the path through the buffer
+ * manager is pure overhead; every block evicts another one, then it is
+ * pinned and referenced by DMA only once. Direct reader loads the blocks
+ * from the relation segment files onto local_pages of the data-store
+ * using io_uring, as long as the block is not cached on the shared buffer.
+ *
+ * Blocks being cached (may be dirty) are always loaded via the buffer
+ * manager, so we never see the stale image of the page. We check it
+ * twice, prior to and after the read, to ensure nobody has loaded the
+ * page during the I/O. Even if someone loaded, modified and wrote out
+ * the page during the I/O, modification is by transactions invisible to
+ * our snapshot, but the image we read may be torn. PageIsVerified() can
+ * detect torn pages only by the checksum, so direct reader is available
+ * only when data checksums are enabled.
+ *
+ * Because we cannot set hint bits on the pages being not associated with
+ * a shared buffer, only all-visible pages are loaded directly; others are
+ * loaded via the buffer manager, as pgstrom_data_store_insert_block() is
+ * doing. Also, serializable transactions are never supported because
+ * CheckForSerializableConflictOut() needs a shared buffer.
+ *
+ * If io_uring is not available on build or run time, we fall back to the
+ * existing path; pgstrom_begin_direct_read() returns NULL.
+ */
+#define DIRECT_READ_DEPTH		64		/* max number of blocks per batch */
+
+struct pgstrom_direct_reader
+{
+	Relation	rel;
+	BlockNumber	segno;		/* segment number currently opened */
+	int			fdesc;		/* file descriptor of the segment, or -1 */
+	bool		io_done[DIRECT_READ_DEPTH];
+};
+
+#ifdef HAVE_LIBURING
+static struct io_uring	direct_read_ring;
+static int				direct_read_ring_state = 0;	/* 1:ready, -1:unavail */
+
+/*
+ * direct_read_ring_cleanup
+ *
+ * on_proc_exit callback to release the ring of the backend.
+ */
+static void
+direct_read_ring_cleanup(int code, Datum arg)
+{
+	if (direct_read_ring_state > 0)
+		io_uring_queue_exit(&direct_read_ring);
+	direct_read_ring_state = -1;
+}
+
+/*
+ * direct_read_block_is_cached
+ *
+ * It checks whether the block is cached on the shared buffer, regardless
+ * of its dirty state.
+ */
+static bool
+direct_read_block_is_cached(Relation rel, BlockNumber blknum)
+{
+	BufferTag	tag;
+	uint32		hash;
+	LWLock	   *partition_lock;
+	int			buf_id;
+
+	INIT_BUFFERTAG(tag, rel->rd_node, MAIN_FORKNUM, blknum);
+	hash = BufTableHashCode(&tag);
+	partition_lock = BufMappingPartitionLock(hash);
+
+	LWLockAcquire(partition_lock, LW_SHARED);
+	buf_id = BufTableLookup(&tag, hash);
+	LWLockRelease(partition_lock);
+
+	return (buf_id >= 0);
+}
+#endif
+
+/*
+ * pgstrom_begin_direct_read
+ *
+ * It returns a direct reader of the relation, or NULL if not available.
+ */
+pgstrom_direct_reader *
+pgstrom_begin_direct_read(Relation rel, Snapshot snapshot)
+{
+#ifdef HAVE_LIBURING
+	static bool	cleanup_registered = false;
+	pgstrom_direct_reader *dreader;
+	int			rc;
+
+	/* torn page is detectable only by checksum */
+	if (!DataChecksumsEnabled())
+		return NULL;
+	/* local buffers are not visible to BufTableLookup */
+	if (RelationUsesLocalBuffers(rel))
+		return NULL;
+	/* all-visible is not reliable during recovery */
+	if (snapshot->takenDuringRecovery)
+		return NULL;
+	if (IsolationIsSerializable())
+		return NULL;
+
+	/*
+	 * The ring is set up once per backend, and shared by all the direct
+	 * readers, because a batch is always submitted and reaped within
+	 * pgstrom_data_store_direct_read().
+	 */
+	if (direct_read_ring_state == 0)
+	{
+		if (!cleanup_registered)
+		{
+			on_proc_exit(direct_read_ring_cleanup, 0);
+			cleanup_registered = true;
+		}
+		rc = io_uring_queue_init(DIRECT_READ_DEPTH, &direct_read_ring, 0);
+		if (rc < 0)
+		{
+			elog(DEBUG1, "io_uring is not available (%s), so direct read "
+				 "is disabled", strerror(-rc));
+			direct_read_ring_state = -1;
+		}
+		else
+			direct_read_ring_state = 1;
+	}
+	if (direct_read_ring_state < 0)
+		return NULL;
+
+	dreader = palloc0(sizeof(pgstrom_direct_reader));
+	dreader->rel = rel;
+	dreader->segno = InvalidBlockNumber;
+	dreader->fdesc = -1;
+
+	return dreader;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * pgstrom_end_direct_read
+ */
+void
+pgstrom_end_direct_read(pgstrom_direct_reader *dreader)
+{
+	if (dreader->fdesc >= 0)
+		CloseTransientFile(dreader->fdesc);
+	pfree(dreader);
+}
+
+#ifdef HAVE_LIBURING
+/*
+ * direct_read_submit
+ *
+ * It reads nblocks continuous blocks from blknum onto the pages, using
+ * io_uring. Result of individual block is set on dreader->io_done[].
+ */
+static void
+direct_read_submit(pgstrom_direct_reader *dreader, char *pages,
+				   BlockNumber blknum, cl_uint nblocks)
+{
+	BlockNumber	segno = blknum / RELSEG_SIZE;
+	off_t		offset = (off_t)(blknum % RELSEG_SIZE) * BLCKSZ;
+	cl_uint		i, submitted;
+	int			rc;
+
+	Assert(nblocks <= DIRECT_READ_DEPTH);
+	memset(dreader->io_done, 0, sizeof(bool) * nblocks);
+
+	/* io_uring may be disabled by an error; all the blocks go to fallback */
+	if (direct_read_ring_state < 0)
+		return;
+
+	/* open the relation segment file, if not yet */
+	if (dreader->segno != segno)
+	{
+		char   *path = relpathbackend(dreader->rel->rd_node,
+									  dreader->rel->rd_backend,
+									  MAIN_FORKNUM);
+		if (segno > 0)
+		{
+			char   *temp = psprintf("%s.%u", path, segno);
+
+			pfree(path);
+			path = temp;
+		}
+
+		if (dreader->fdesc >= 0)
+			CloseTransientFile(dreader->fdesc);
+		dreader->fdesc = OpenTransientFile(path, O_RDONLY | PG_BINARY, 0);
+		dreader->segno = segno;
+		pfree(path);
+	}
+	/* segment file may not exist yet; all the blocks go to fallback */
+	if (dreader->fdesc < 0)
+		return;
+
+	for (i=0; i < nblocks; i++)
+	{
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&direct_read_ring);
+
+		Assert(sqe != NULL);
+		io_uring_prep_read(sqe, dreader->fdesc,
+						   pages + BLCKSZ * i, BLCKSZ,
+						   offset + BLCKSZ * i);
+		io_uring_sqe_set_data(sqe, (void *)((uintptr_t) i));
+	}
+
+	for (submitted = 0; submitted < nblocks; submitted += rc)
+	{
+		rc = io_uring_submit(&direct_read_ring);
+		if (rc == -EINTR)
+			rc = 0;
+		else if (rc <= 0)
+			break;
+	}
+
+	/*
+	 * NOTE: all the submitted requests have to be reaped prior to any
+	 * error, because the kernel writes to the pages asynchronously.
+	 */
+	for (i=0; i < submitted; i++)
+	{
+		struct io_uring_cqe *cqe;
+		cl_uint		index;
+
+		do {
+			rc = io_uring_wait_cqe(&direct_read_ring, &cqe);
+		} while (rc == -EINTR);
+		if (rc < 0)
+		{
+			/*
+			 * Teardown of the ring cancels the requests in-flight, then
+			 * the ring is set up again on the next direct reader.
+			 */
+			io_uring_queue_exit(&direct_read_ring);
+			direct_read_ring_state = 0;
+			elog(ERROR, "failed on io_uring_wait_cqe (%s)", strerror(-rc));
+		}
+		index = (cl_uint)((uintptr_t) io_uring_cqe_get_data(cqe));
+		dreader->io_done[index] = (cqe->res == BLCKSZ);
+		io_uring_cqe_seen(&direct_read_ring, cqe);
+	}
+
+	/*
+	 * If a part of requests were not submitted, they still stay on the
+	 * submission queue. We have no way to revert them, so the ring is
+	 * discarded and direct read is disabled in this backend.
+	 */
+	if (submitted < nblocks)
+	{
+		elog(LOG, "failed on io_uring_submit (%s), so direct read is "
+			 "disabled", strerror(-rc));
+		io_uring_queue_exit(&direct_read_ring);
+		direct_read_ring_state = -1;
+		memset(dreader->io_done, 0, sizeof(bool) * nblocks);
+	}
+}
+#endif
+
+/*
+ * pgstrom_data_store_direct_read
+ *
+ * It loads the blocks from blknum onto the data-store, until either the
+ * data-store gets full or reaches the last_blknum, then returns the next
+ * block number to be loaded. Blocks not suitable for direct read are
+ * loaded via pgstrom_data_store_insert_block().
+ */
+BlockNumber
+pgstrom_data_store_direct_read(pgstrom_data_store *pds,
+							   pgstrom_direct_reader *dreader,
+							   BlockNumber blknum,
+							   BlockNumber last_blknum,
+							   Snapshot snapshot,
+							   BufferAccessStrategy strategy)
+{
+#ifdef HAVE_LIBURING
+	Relation		rel = dreader->rel;
+	kern_data_store *kds = pds->kds;
+
+	Assert(kds->format == KDS_FORMAT_ROW);
+
+	/* direct read needs local_pages and their block number */
+	if (!pds->local_pages)
+	{
+		pds->local_pages = pgstrom_shmem_alloc(BLCKSZ * kds->maxblocks);
+		if (!pds->local_pages)
+			elog(ERROR, "out of memory");
+	}
+	if (!pds->direct_blknums)
+	{
+		pds->direct_blknums =
+			pgstrom_shmem_alloc(sizeof(BlockNumber) * kds->maxblocks);
+		if (!pds->direct_blknums)
+			elog(ERROR, "out of memory");
+	}
+
+	while (blknum < last_blknum)
+	{
+		cl_uint		nblocks;
+		cl_uint		i;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* block being cached shall be loaded via the buffer manager */
+		if (direct_read_block_is_cached(rel, blknum))
+		{
+			if (pgstrom_data_store_insert_block(pds, rel, blknum, snapshot,
+												true, strategy) < 0)
+				break;
+			blknum++;
+			continue;
+		}
+
+		/*
+		 * Pick up the continuous uncached blocks, within a particular
+		 * segment file and the rest of local_pages.
+		 */
+		for (nblocks = 1;
+			 nblocks < DIRECT_READ_DEPTH &&
+			 kds->nblocks + nblocks < kds->maxblocks &&
+			 blknum + nblocks < last_blknum &&
+			 (blknum + nblocks) % RELSEG_SIZE != 0 &&
+			 !direct_read_block_is_cached(rel, blknum + nblocks);
+			 nblocks++);
+
+		direct_read_submit(dreader,
+						   pds->local_pages + BLCKSZ * kds->nblocks,
+						   blknum, nblocks);
+
+		/*
+		 * Note that i-th block was read onto the slot of kds->nblocks,
+		 * so pgstrom_data_store_insert_block() can use this slot as is
+		 * on fallback.
+		 */
+		for (i=0; i < nblocks; i++, blknum++)
+		{
+			kern_blkitem   *bitem = KERN_DATA_STORE_BLKITEM(kds, kds->nblocks);
+			kern_rowitem   *ritem = KERN_DATA_STORE_ROWITEM(kds, kds->nitems);
+			Page			page = (Page)(pds->local_pages +
+										  BLCKSZ * kds->nblocks);
+			OffsetNumber	lineoff;
+			int				lines;
+
+			if (!dreader->io_done[i] ||
+				PageIsNew(page) ||
+				!PageIsVerified(page, blknum) ||
+				!PageIsAllVisible(page) ||
+				direct_read_block_is_cached(rel, blknum))
+			{
+				if (pgstrom_data_store_insert_block(pds, rel, blknum,
+													snapshot, true,
+													strategy) < 0)
+					return blknum;
+				continue;
+			}
+
+			/* see pgstrom_data_store_insert_block() */
+			lines = PageGetMaxOffsetNumber(page);
+			if (kds->nitems + lines > kds->nrooms ||
+				STROMALIGN(offsetof(kern_data_store, colmeta[kds->ncols])) +
+				STROMALIGN(sizeof(kern_blkitem) * (kds->maxblocks)) +
+				STROMALIGN(sizeof(kern_rowitem) * (kds->nitems + lines)) +
+				BLCKSZ * kds->nblocks >= BLCKSZ * kds->maxblocks)
+				return blknum;
+
+			/* all the normal items are visible */
+			for (lineoff = FirstOffsetNumber; lineoff <= lines; lineoff++)
+			{
+				if (!ItemIdIsNormal(PageGetItemId(page, lineoff)))
+					continue;
+				ritem->blk_index = kds->nblocks;
+				ritem->item_offset = lineoff;
+				ritem++;
+				kds->nitems++;
+			}
+			bitem->buffer = InvalidBuffer;
+			bitem->page = page;
+			pds->direct_blknums[kds->nblocks] = blknum;
+			kds->nblocks++;
+		}
+	}
+	return blknum;
+#else
+	elog(ERROR, "PG-Strom was built without io_uring support");
+	return InvalidBlockNumber;	/* be compiler quiet */
+#endif
+}
+
 /*
  * pgstrom_data_store_insert_tuple
  *
@@ -827,6 +1289,209 @@ pgstrom_data_store_insert_tuple(pgstrom_data_store *pds,
 	return false;
 }
 
+/*
+ * pgstrom_data_store_columnize
+ *
+ * It transforms a data-store in row-format into column-format that has
+ * only the columns referenced by device kernel. attr_refs is a bitmap of
+ * attribute numbers offset by FirstLowInvalidHeapAttributeNumber, as
+ * pull_varattnos() makes. If the data-store is already in column-format
+ * but lacks some of referenced columns, it shall be re-constructed with
+ * union of them. Data-store in any other format is kept as is.
+ */
+void
+pgstrom_data_store_columnize(pgstrom_data_store *pds,
+							 TupleDesc tupdesc,
+							 Bitmapset *attr_refs)
+{
+	kern_data_store	   *kds = pds->kds;
+	kern_data_store	   *kds_new;
+	kern_rowitem	   *ritem;
+	kern_blkitem	   *bitem;
+	bool			   *referenced;
+	Datum			   *values;
+	bool			   *isnull;
+	Bitmapset		   *tempset;
+	HeapTupleData		tuple;
+	Size				required;
+	Size				usage;
+	cl_uint				nvarlena = 0;
+	bool				needs_build = false;
+	int					i, j, x;
+
+	if (!pgstrom_column_format || kds->nitems == 0)
+		return;
+	if (kds->format != KDS_FORMAT_ROW &&
+		kds->format != KDS_FORMAT_COLUMN)
+		return;
+	Assert(kds->ncols == tupdesc->natts);
+
+	/* pick up the columns to be loaded */
+	referenced = palloc0(sizeof(bool) * kds->ncols);
+	tempset = bms_copy(attr_refs);
+	while ((x = bms_first_member(tempset)) >= 0)
+	{
+		AttrNumber	anum = x + FirstLowInvalidHeapAttributeNumber;
+
+		if (anum == InvalidAttrNumber)
+		{
+			/* whole-row reference */
+			for (i=0; i < kds->ncols; i++)
+				referenced[i] = true;
+		}
+		else if (anum > 0 && anum <= kds->ncols)
+			referenced[anum - 1] = true;
+	}
+	bms_free(tempset);
+
+	for (i=0; i < kds->ncols; i++)
+	{
+		if (kds->format == KDS_FORMAT_COLUMN &&
+			kds->colmeta[i].cs_offset != 0)
+			referenced[i] = true;
+		else if (referenced[i])
+			needs_build = true;
+		if (referenced[i] && kds->colmeta[i].attlen < 0)
+			nvarlena++;
+	}
+	/* all the referenced columns are already loaded */
+	if (kds->format == KDS_FORMAT_COLUMN && !needs_build)
+	{
+		pfree(referenced);
+		return;
+	}
+
+	/*
+	 * Estimation of the required length. blkitems[] and rowitems[] are
+	 * shrunk to the actual usage, and the arena of varlena values can
+	 * never be larger than the source tuples.
+	 */
+	required = STROMALIGN(offsetof(kern_data_store, colmeta[kds->ncols])) +
+		STROMALIGN(sizeof(kern_blkitem) * kds->nblocks) +
+		STROMALIGN(sizeof(kern_rowitem) * kds->nitems);
+	for (i=0; i < kds->ncols; i++)
+	{
+		if (!referenced[i])
+			continue;
+		required += (STROMALIGN(KERN_DATA_STORE_COLUMN_UNITSZ(kds->colmeta[i])
+								* kds->nitems) +
+					 STROMALIGN(BITMAPLEN(kds->nitems)));
+	}
+	if (nvarlena > 0)
+	{
+		for (i=0; i < kds->nitems; i++)
+		{
+			ritem = KERN_DATA_STORE_ROWITEM(kds, i);
+			bitem = KERN_DATA_STORE_BLKITEM(kds, ritem->blk_index);
+			required += (ItemIdGetLength(PageGetItemId(bitem->page,
+													   ritem->item_offset)) +
+						 sizeof(cl_uint) * nvarlena);
+		}
+	}
+	required = STROMALIGN(required);
+
+	kds_new = pgstrom_shmem_alloc(required);
+	if (!kds_new)
+		elog(ERROR, "out of shared memory");
+
+	/* header, blkitems[] and rowitems[] are inherited from the source */
+	memcpy(kds_new, kds, offsetof(kern_data_store, colmeta[kds->ncols]));
+	kds_new->hostptr = (hostptr_t) &kds_new->hostptr;
+	kds_new->format = KDS_FORMAT_COLUMN;
+	kds_new->nrooms = kds->nitems;
+	kds_new->maxblocks = kds->nblocks;
+	memcpy(KERN_DATA_STORE_BLKITEM(kds_new, 0),
+		   KERN_DATA_STORE_BLKITEM(kds, 0),
+		   sizeof(kern_blkitem) * kds->nblocks);
+	memcpy(KERN_DATA_STORE_ROWITEM(kds_new, 0),
+		   KERN_DATA_STORE_ROWITEM(kds, 0),
+		   sizeof(kern_rowitem) * kds->nitems);
+
+	/* assignment of the column-arrays */
+	usage = KERN_DATA_STORE_COLUMN_BASE(kds_new);
+	for (i=0; i < kds_new->ncols; i++)
+	{
+		kern_colmeta   *cmeta = &kds_new->colmeta[i];
+
+		if (!referenced[i])
+		{
+			cmeta->cs_offset = 0;
+			continue;
+		}
+		cmeta->cs_offset = usage;
+		usage += STROMALIGN(KERN_DATA_STORE_COLUMN_UNITSZ(*cmeta) *
+							kds_new->nrooms);
+		memset((char *)kds_new + usage, 0, BITMAPLEN(kds_new->nrooms));
+		usage += STROMALIGN(BITMAPLEN(kds_new->nrooms));
+	}
+
+	/* deform the tuples, then put them on the column-arrays */
+	values = palloc(sizeof(Datum) * kds_new->ncols);
+	isnull = palloc(sizeof(bool) * kds_new->ncols);
+	memset(&tuple, 0, sizeof(HeapTupleData));
+	for (i=0; i < kds_new->nitems; i++)
+	{
+		ItemId		lpp;
+
+		ritem = KERN_DATA_STORE_ROWITEM(kds_new, i);
+		bitem = KERN_DATA_STORE_BLKITEM(kds_new, ritem->blk_index);
+		lpp = PageGetItemId(bitem->page, ritem->item_offset);
+		Assert(ItemIdIsNormal(lpp));
+		tuple.t_data = (HeapTupleHeader) PageGetItem(bitem->page, lpp);
+		tuple.t_len = ItemIdGetLength(lpp);
+
+		heap_deform_tuple(&tuple, tupdesc, values, isnull);
+
+		for (j=0; j < kds_new->ncols; j++)
+		{
+			kern_colmeta   *cmeta = &kds_new->colmeta[j];
+			char		   *dest;
+			Size			vl_len;
+
+			if (!referenced[j] || isnull[j])
+				continue;
+			KERN_DATA_STORE_COLUMN_NULLMAP(kds_new, j)[i >> 3]
+				|= (1 << (i & 0x07));
+			dest = (char *)KERN_DATA_STORE_COLUMN_VALUES(kds_new, j);
+			if (cmeta->attlen > 0)
+			{
+				dest += KERN_DATA_STORE_COLUMN_UNITSZ(*cmeta) * i;
+				if (cmeta->attbyval)
+					store_att_byval(dest, values[j], cmeta->attlen);
+				else
+					memcpy(dest, DatumGetPointer(values[j]), cmeta->attlen);
+			}
+			else
+			{
+				if (cmeta->attlen == -1)
+					vl_len = VARSIZE_ANY(DatumGetPointer(values[j]));
+				else
+					vl_len = strlen(DatumGetCString(values[j])) + 1;
+				usage = INTALIGN(usage);
+				Assert(usage + vl_len <= required);
+				memcpy((char *)kds_new + usage,
+					   DatumGetPointer(values[j]), vl_len);
+				((cl_uint *) dest)[i] = usage;
+				usage += vl_len;
+			}
+		}
+	}
+	kds_new->usage = usage;
+	kds_new->length = STROMALIGN(usage);
+	Assert(kds_new->length <= required);
+
+	pfree(values);
+	pfree(isnull);
+	pfree(referenced);
+
+	/*
+	 * NOTE: shared buffers being pinned are inherited by the new one,
+	 * so we don't need to touch the resource owner of pds.
+	 */
+	pds->kds = kds_new;
+	pgstrom_shmem_free(kds);
+}
+
 /*
  * clserv_dmasend_data_store
  *
@@ -849,7 +1514,7 @@ clserv_dmasend_data_store(pgstrom_data_store *pds,
 	kern_blkitem	   *bitem;
 	size_t				length;
 	size_t				offset;
-	cl_int				i, n, rc;
+	cl_int				i, n, nruns, rc;
 
 #ifdef USE_ASSERT_CHECKING
 	Assert(pgstrom_i_am_clserv);
@@ -906,6 +1571,58 @@ clserv_dmasend_data_store(pgstrom_data_store *pds,
 		}
 		return rc;
 	}
+	if (kds->format == KDS_FORMAT_COLUMN)
+	{
+		/*
+		 * Only the header and the column-arrays are sent; blkitems[] and
+		 * rowitems[] are never referenced by the device kernel.
+		 */
+		Assert(!pds->ktoast);
+		rc = clEnqueueWriteBuffer(kcmdq,
+								  kds_buffer,
+								  CL_FALSE,
+								  0,
+								  offsetof(kern_data_store,
+										   colmeta[kds->ncols]),
+								  kds,
+								  num_blockers,
+								  blockers,
+								  events + (*ev_index));
+		if (rc != CL_SUCCESS)
+		{
+			clserv_log("failed on clEnqueueWriteBuffer: %s",
+					   opencl_strerror(rc));
+			return rc;
+		}
+		(*ev_index)++;
+		pfm->bytes_dma_send += offsetof(kern_data_store,
+										colmeta[kds->ncols]);
+		pfm->num_dma_send++;
+
+		offset = KERN_DATA_STORE_COLUMN_BASE(kds);
+		if (kds->usage > offset)
+		{
+			rc = clEnqueueWriteBuffer(kcmdq,
+									  kds_buffer,
+									  CL_FALSE,
+									  offset,
+									  kds->usage - offset,
+									  (char *)kds + offset,
+									  num_blockers,
+									  blockers,
+									  events + (*ev_index));
+			if (rc != CL_SUCCESS)
+			{
+				clserv_log("failed on clEnqueueWriteBuffer: %s",
+						   opencl_strerror(rc));
+				return rc;
+			}
+			(*ev_index)++;
+			pfm->bytes_dma_send += kds->usage - offset;
+			pfm->num_dma_send++;
+		}
+		return CL_SUCCESS;
+	}
 	Assert(kds->format == KDS_FORMAT_ROW);
 	length = ((uintptr_t)KERN_DATA_STORE_ROWITEM(kds, kds->nitems) -
 			  (uintptr_t)(kds));
@@ -925,23 +1642,81 @@ clserv_dmasend_data_store(pgstrom_data_store *pds,
 		return rc;
 	}
 	(*ev_index)++;
-	pfm->bytes_dma_send += kds->length;
+	pfm->bytes_dma_send += length;
 	pfm->num_dma_send++;
 
 	offset = ((uintptr_t)KERN_DATA_STORE_ROWBLOCK(kds, 0) -
 			  (uintptr_t)(kds));
-	length = BLCKSZ;
 	bitem = KERN_DATA_STORE_BLKITEM(kds, 0);
+
+	/*
+	 * Count number of runs of the pages being continuous on the shared
+	 * buffer pool (or local_pages). Each run is sent with a single DMA.
+	 */
+	for (i=0, nruns=0; i < kds->nblocks; i++)
+	{
+		if (i == 0 ||
+			(uintptr_t)bitem[i-1].page + BLCKSZ != (uintptr_t)bitem[i].page)
+			nruns++;
+	}
+
+	/*
+	 * If runs are too short on average, it is cheaper to gather the pages
+	 * into a staging buffer and send it at once, than a large number of
+	 * small DMA requests.
+	 * NOTE: a particular data-store is never sent by multiple server
+	 * threads concurrently, so we don't need a lock to set up the staging
+	 * buffer. It is kept until the data-store is released, because DMA
+	 * is asynchronous, and reused if the data-store is sent again.
+	 */
+	if (nruns > 1 &&
+		opencl_dma_staging_threshold > 0 &&
+		kds->nblocks < opencl_dma_staging_threshold * nruns)
+	{
+		if (!pds->dma_staging)
+		{
+			char   *staging = pgstrom_shmem_alloc(BLCKSZ * kds->nblocks);
+
+			/* If shared memory is short, we give up staging */
+			if (staging)
+			{
+				for (i=0; i < kds->nblocks; i++)
+					memcpy(staging + BLCKSZ * i, bitem[i].page, BLCKSZ);
+				pds->dma_staging = staging;
+				pfm->bytes_dma_staged += BLCKSZ * kds->nblocks;
+			}
+		}
+		if (pds->dma_staging)
+		{
+			rc = clEnqueueWriteBuffer(kcmdq,
+									  kds_buffer,
+									  CL_FALSE,
+									  offset,
+									  BLCKSZ * kds->nblocks,
+									  pds->dma_staging,
+									  num_blockers,
+									  blockers,
+									  events + (*ev_index));
+			if (rc != CL_SUCCESS)
+			{
+				clserv_log("failed on clEnqueueWriteBuffer: %s",
+						   opencl_strerror(rc));
+				return rc;
+			}
+			(*ev_index)++;
+			pfm->bytes_dma_send += BLCKSZ * kds->nblocks;
+			pfm->num_dma_send++;
+			pfm->num_dma_saved += kds->nblocks - 1;
+			return CL_SUCCESS;
+		}
+	}
+
 	for (i=0, n=0; i < kds->nblocks; i++)
 	{
 		/* simple sanity check */
 		Assert(bitem[i].buffer <= NBuffers);
 
-		/*
-		 * NOTE: A micro optimization; if next page is located
-		 * on the continuous region, the upcoming DMA request
-		 * can be merged to reduce DMA management cost
-		 */
+		/* merge the request if next page is on the continuous region */
 		if (i+1 < kds->nblocks &&
 			(uintptr_t)bitem[i].page + BLCKSZ == (uintptr_t)bitem[i+1].page)
 		{
@@ -969,6 +1744,8 @@ clserv_dmasend_data_store(pgstrom_data_store *pds,
 		offset += BLCKSZ * (n+1);
 		n = 0;
 	}
+	pfm->num_dma_saved += kds->nblocks - nruns;
+
 	return CL_SUCCESS;
 }
 
@@ -999,19 +1776,21 @@ pgstrom_dump_data_store(pgstrom_data_store *pds)
 			 "nblocks=%u maxblocks=%u}",
 			 kds->format == KDS_FORMAT_ROW ? "row-store" :
 			 kds->format == KDS_FORMAT_ROW_FLAT ? "row-flat" :
-			 kds->format == KDS_FORMAT_TUPSLOT ? "tuple-slot" : "unknown",
+			 kds->format == KDS_FORMAT_TUPSLOT ? "tuple-slot" :
+			 kds->format == KDS_FORMAT_COLUMN ? "column" : "unknown",
 			 kds->length, kds->ncols, kds->nitems, kds->nrooms,
 			 kds->nblocks, kds->maxblocks);
 	for (i=0; i < kds->ncols; i++)
 	{
 		PDS_DUMP("attr[%d] {attbyval=%d attalign=%d attlen=%d "
-				 "attnum=%d attcacheoff=%d}",
+				 "attnum=%d attcacheoff=%d cs_offset=%u}",
 				 i,
 				 kds->colmeta[i].attbyval,
 				 kds->colmeta[i].attalign,
 				 kds->colmeta[i].attlen,
 				 kds->colmeta[i].attnum,
-				 kds->colmeta[i].attcacheoff);
+				 kds->colmeta[i].attcacheoff,
+				 kds->colmeta[i].cs_offset);
 	}
 
 	if (kds->format == KDS_FORMAT_ROW_FLAT)
@@ -183,6 +183,7 @@ typedef struct
 
 	int				pscan_nattrs;
 	vartrans_info  *pscan_vartrans;
+	Bitmapset	   *outer_attrefs;	/* outer columns referenced by device */
 	TupleTableSlot *pscan_slot;
 	TupleTableSlot *pscan_wider_slot;
 	ProjectionInfo *pscan_projection;
@@ -200,12 +201,14 @@ typedef struct
 
 	pgstrom_queue  *mqueue;
 	Datum			dprog_key;
+	pgstrom_message *prebuild;	/* speculative build, if any */
 	kern_parambuf  *kparams;
 
 	pgstrom_gpuhashjoin *curr_ghjoin;
 	cl_uint			curr_index;
 	bool			curr_recheck;
 	cl_int			num_running;
+	int				max_async_chunks;	/* current pipeline depth */
 	dlist_head		ready_pscans;
 
 	pgstrom_perfmon	pfm;
@@ -2330,6 +2333,7 @@ gpuhashjoin_begin(CustomPlan *node, EState *estate, int eflags)
 	ghjs->cps.ps.state = estate;
 	ghjs->cps.methods = &gpuhashjoin_plan_methods;
 	ghjs->join_types = copyObject(ghjoin->join_types);
+	ghjs->max_async_chunks = pgstrom_max_async_chunks;
 
 	/*
 	 * create expression context
@@ -2413,6 +2417,26 @@ gpuhashjoin_begin(CustomPlan *node, EState *estate, int eflags)
 	 */
 	ghjs->outer_bulkload = ghjoin->outer_bulkload;
 
+	/*
+	 * Outer columns being referenced by the device kernel; both of join
+	 * clauses and projection. Only them are loaded on column-format.
+	 */
+	for (i=0; i < ghjs->pscan_nattrs; i++)
+	{
+		vartrans_info  *vtrans = &ghjs->pscan_vartrans[i];
+
+		if (vtrans->srcdepth != 0)
+			continue;
+		ghjs->outer_attrefs =
+			bms_add_member(ghjs->outer_attrefs,
+						   vtrans->srcresno -
+						   FirstLowInvalidHeapAttributeNumber);
+	}
+	if (ghjs->outer_bulkload)
+		pgstrom_gpuscan_bulk_attrefs(outerPlanState(ghjs),
+									 ghjs->outer_attrefs,
+									 NIL);
+
 	/* construction of kernel parameter buffer */
 	ghjs->kparams = pgstrom_create_kern_parambuf(ghjoin->used_params,
 												 ghjs->cps.ps.ps_ExprContext);
@@ -2428,6 +2452,14 @@ gpuhashjoin_begin(CustomPlan *node, EState *estate, int eflags)
 	ghjs->mqueue = pgstrom_create_queue();
 	pgstrom_track_object(&ghjs->mqueue->sobj, 0);
 
+	/* kick the build prior to the inner hash-table being loaded */
+	if ((eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0)
+	{
+		ghjs->prebuild = pgstrom_prebuild_devprog(ghjs->dprog_key);
+		if (ghjs->prebuild)
+			pgstrom_track_object(&ghjs->prebuild->sobj, 0);
+	}
+
 	/* Is perfmon needed? */
 	ghjs->pfm.enabled = pgstrom_perfmon_enabled;
 
@@ -2666,6 +2698,8 @@ retry:
 		}
 		if (pds)
 		{
+			pgstrom_data_store_columnize(pds, tupdesc, ghjs->outer_attrefs);
+
 			memset(&bulkdata, 0, sizeof(pgstrom_bulkslot));
 			bulkdata.pds = pds;
 			bulkdata.nvalids = -1;	/* all valid */
@@ -2778,26 +2812,39 @@ pgstrom_fetch_gpuhashjoin(GpuHashJoinState *ghjs,
 	pgstrom_message	   *msg;
 	pgstrom_gpuhashjoin *ghjoin;
 	dlist_node			*dnode;
+	pgstrom_message	   *pending[MQUEUE_BATCH_SIZE];
+	int					npending = 0;
 
 	/*
 	 * Keep number of asynchronous hashjoin request a particular level,
 	 * unless it does not exceed pgstrom_max_async_chunks and any new
 	 * response is not replied during the loading.
+	 * Pipeline depth shrinks under memory pressure.
+	 * Chunks are enqueued in a batch to save wakeups of the server, but
+	 * sent immediately if server has nothing to do.
 	 */
 	while (!ghjs->outer_done &&
-		   ghjs->num_running <= pgstrom_max_async_chunks)
+		   ghjs->num_running <= ghjs->max_async_chunks)
 	{
-		pgstrom_gpuhashjoin *ghjoin
-			= gpuhashjoin_load_next_chunk(ghjs, result_format);
-		if (!ghjoin)
-			break;	/* outer scan reached to end of the relation */
+		pgstrom_gpuhashjoin *ghjoin;
 
-		if (!pgstrom_enqueue_message(&ghjoin->msg))
+		if (!pgstrom_reserve_async_chunk(&ghjs->max_async_chunks,
+										 ghjs->num_running > 0 ||
+										 !dlist_is_empty(&ghjs->ready_pscans)))
+			break;	/* wait for the chunks in-progress */
+
+		ghjoin = gpuhashjoin_load_next_chunk(ghjs, result_format);
+		if (!ghjoin)
 		{
-			pgstrom_put_message(&ghjoin->msg);
-			elog(ERROR, "failed to enqueue pgstrom_gpuhashjoin message");
+			pgstrom_release_async_chunk();
+			break;	/* outer scan reached to end of the relation */
 		}
+		pgstrom_charge_async_chunk(ghjoin->pds);
+
+		pending[npending++] = &ghjoin->msg;
 		ghjs->num_running++;
+		if (ghjs->num_running == npending || npending == MQUEUE_BATCH_SIZE)
+			pgstrom_flush_messages(pending, &npending);
 
 		msg = pgstrom_try_dequeue_message(ghjs->mqueue);
 		if (msg)
@@ -2807,6 +2854,7 @@ pgstrom_fetch_gpuhashjoin(GpuHashJoinState *ghjs,
 			break;
 		}
 	}
+	pgstrom_flush_messages(pending, &npending);
 
 	/*
 	 * wait for server's response if no available chunks were replied
@@ -2955,7 +3003,8 @@ gpuhashjoin_exec_multi(CustomPlanState *node)
 		pds = ghjoin->pds;
 		pds_dest = ghjoin->pds_dest;
 		Assert(pds->kds->format == KDS_FORMAT_ROW ||
-			   pds->kds->format == KDS_FORMAT_ROW_FLAT);
+			   pds->kds->format == KDS_FORMAT_ROW_FLAT ||
+			   pds->kds->format == KDS_FORMAT_COLUMN);
 		Assert(pds_dest->kds->format == KDS_FORMAT_ROW_FLAT);
 
 		/* update perfmon info */
@@ -3064,6 +3113,12 @@ gpuhashjoin_end(CustomPlanState *node)
 	pgstrom_untrack_object((StromObject *)ghjs->dprog_key);
 	pgstrom_put_devprog_key(ghjs->dprog_key);
 
+	if (ghjs->prebuild)
+	{
+		pgstrom_untrack_object(&ghjs->prebuild->sobj);
+		pgstrom_put_message(ghjs->prebuild);
+	}
+
 	Assert(ghjs->mqueue);
 	pgstrom_untrack_object(&ghjs->mqueue->sobj);
 	pgstrom_close_queue(ghjs->mqueue);
@@ -3228,7 +3283,10 @@ gpuhashjoin_explain(CustomPlanState *node, List *ancestors, ExplainState *es)
 	show_device_kernel(ghjs->dprog_key, es);
 
 	if (es->analyze && ghjs->pfm.enabled)
+	{
+		pgstrom_perfmon_prebuild(&ghjs->pfm, ghjs->prebuild);
 		pgstrom_perfmon_explain(&ghjs->pfm, es);
+	}
 }
 
 static Bitmapset *
@@ -3573,30 +3631,37 @@ static bool
 expand_multihash_tables(MultiHashState *mhs,
 						pgstrom_multihash_tables **p_mhtables, Size consumed)
 {
-
 	pgstrom_multihash_tables *mhtables_old = *p_mhtables;
 	pgstrom_multihash_tables *mhtables_new;
 	Size	length_old = mhtables_old->length;
 	Size	allocated;
 
-	mhtables_new = pgstrom_shmem_alloc_alap(2 * length_old, &allocated);
+	/*
+	 * The hash table is still private during preload, so we can hand it
+	 * to pgstrom_shmem_realloc() that tries to grow the block in place
+	 * by merging the following free buddies, without copying the whole
+	 * table each time it doubles.
+	 */
+	Assert(mhtables_old->refcnt == 1 && mhtables_old->n_kernel == 0);
+	pgstrom_untrack_object(&mhtables_old->sobj);
+	mhtables_new = pgstrom_shmem_realloc(mhtables_old,
+										 offsetof(pgstrom_multihash_tables,
+												  kern) + 2 * length_old);
 	if (!mhtables_new)
+	{
+		pgstrom_track_object(&mhtables_old->sobj, 0);
 		return false;	/* out of shmem, or too large to allocate */
-	memcpy(mhtables_new, mhtables_old,
-		   offsetof(pgstrom_multihash_tables, kern) +
-		   mhtables_old->usage + consumed);
+	}
+	pgstrom_track_object(&mhtables_new->sobj, 0);
 
+	allocated = pgstrom_shmem_getsize(mhtables_new);
 	mhtables_new->length =
 		allocated - offsetof(pgstrom_multihash_tables, kern);
 	mhtables_new->kern.hostptr = (hostptr_t)&mhtables_new->kern.hostptr;
-	Assert(mhtables_new->length > mhtables_old->length);
-	elog(INFO, "pgstrom_multihash_tables was expanded %zu (%p) => %zu (%p)",
-		 mhtables_old->length, mhtables_old,
+	Assert(mhtables_new->length > length_old);
+	elog(DEBUG1, "pgstrom_multihash_tables was expanded %zu (%p) => %zu (%p)",
+		 length_old, mhtables_old,
 		 mhtables_new->length, mhtables_new);
-	pgstrom_track_object(&mhtables_new->sobj, 0);
-
-	pgstrom_untrack_object(&mhtables_old->sobj);
-	multihash_put_tables(mhtables_old);
 
 	/* update hashtable_size of MultiHashState */
 	do {
@@ -3702,6 +3767,7 @@ multihash_preload_khashtable(MultiHashState *mhs,
 		khtable->colmeta[i].attlen = attr->attlen;
 		khtable->colmeta[i].attnum = attr->attnum;
 		khtable->colmeta[i].attcacheoff = attcacheoff;
+		khtable->colmeta[i].cs_offset = 0;	/* never used */
 		if (attcacheoff >= 0)
 			attcacheoff += attr->attlen;
 	}
@@ -4291,15 +4357,15 @@ clserv_respond_hashjoin(cl_event event, cl_int ev_status, void *private)
 	while (clghj->ev_index > 1)
 		clReleaseEvent(clghj->events[--clghj->ev_index]);
 	if (clghj->m_kresult)
-		clReleaseMemObject(clghj->m_kresult);
+		clserv_release_buffer(clghj->dindex, clghj->m_kresult);
 	if (clghj->m_rowmap)
-		clReleaseMemObject(clghj->m_rowmap);
+		clserv_release_buffer(clghj->dindex, clghj->m_rowmap);
 	if (clghj->m_ktoast)
-		clReleaseMemObject(clghj->m_ktoast);
+		clserv_release_buffer(clghj->dindex, clghj->m_ktoast);
 	if (clghj->m_dstore)
-		clReleaseMemObject(clghj->m_dstore);
+		clserv_release_buffer(clghj->dindex, clghj->m_dstore);
 	if (clghj->m_join)
-		clReleaseMemObject(clghj->m_join);
+		clserv_release_buffer(clghj->dindex, clghj->m_join);
 	if (clghj->kern_main)
 		clReleaseKernel(clghj->kern_main);
 	if (clghj->kern_proj)
@@ -4442,9 +4508,11 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 	size_t				nitems;
 	size_t				gwork_sz;
 	size_t				lwork_sz;
+	clserv_wgtune		wgtune;
 	Size				offset;
 	Size				length;
 	void			   *dmaptr;
+	const char		   *kern_proj_name;
 	cl_int				rc;
 
 	Assert(StromTagIs(gpuhashjoin, GpuHashJoin));
@@ -4502,7 +4570,9 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 
 		Assert(!mhtables->m_hash && !mhtables->ev_hash);
 
-		dindex = pgstrom_opencl_device_schedule(&gpuhashjoin->msg);
+		dindex = pgstrom_opencl_device_schedule(&gpuhashjoin->msg,
+												mhtables->length +
+												kds->length);
 		mhtables->dindex = dindex;
 		clghj->dindex = dindex;
 		clghj->kcmdq = opencl_cmdq[dindex];
@@ -4550,6 +4620,8 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 
 		clghj->dindex = mhtables->dindex;
 		clghj->kcmdq = opencl_cmdq[clghj->dindex];
+		pgstrom_opencl_device_dispatch(&gpuhashjoin->msg,
+									   clghj->dindex, kds->length);
 		clghj->m_hash = mhtables->m_hash;
 		clghj->events[clghj->ev_index++] = mhtables->ev_hash;
 	}
@@ -4564,9 +4636,9 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 	 *                        __global kern_data_store *ktoast,
 	 *                        KERN_DYNAMIC_LOCAL_WORKMEM_ARG)
 	 */
-	clghj->kern_main = clCreateKernel(clghj->program,
-									  "kern_gpuhashjoin_main",
-									  &rc);
+	clghj->kern_main = clserv_lookup_device_kernel(gpuhashjoin->dprog_key,
+												   "kern_gpuhashjoin_main",
+												   &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
@@ -4583,18 +4655,17 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 	 *                             KERN_DYNAMIC_LOCAL_WORKMEM_ARG)
 	 */
 	if (pds_dest->kds->format == KDS_FORMAT_TUPSLOT)
-		clghj->kern_proj = clCreateKernel(clghj->program,
-										  "kern_gpuhashjoin_projection_slot",
-										  &rc);
+		kern_proj_name = "kern_gpuhashjoin_projection_slot";
 	else if (pds_dest->kds->format == KDS_FORMAT_ROW_FLAT)
-		clghj->kern_proj = clCreateKernel(clghj->program,
-										  "kern_gpuhashjoin_projection_row",
-										  &rc);
+		kern_proj_name = "kern_gpuhashjoin_projection_row";
 	else
 	{
 		clserv_log("pds_dest has unexpected format");
 		goto error;
 	}
+	clghj->kern_proj = clserv_lookup_device_kernel(gpuhashjoin->dprog_key,
+												   kern_proj_name,
+												   &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
@@ -4605,11 +4676,10 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 	length = (KERN_HASHJOIN_PARAMBUF_LENGTH(&gpuhashjoin->khashjoin) +
 			  KERN_HASHJOIN_RESULTBUF_LENGTH(&gpuhashjoin->khashjoin) +
 			  sizeof(cl_int) * kresults->nrels * kresults->nrooms);
-	clghj->m_join = clCreateBuffer(opencl_context,
-								   CL_MEM_READ_WRITE,
-								   length,
-								   NULL,
-								   &rc);
+	clghj->m_join = clserv_create_buffer(clghj->dindex,
+										 length,
+										 &gpuhashjoin->msg.pfm,
+										 &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -4617,11 +4687,10 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 	}
 
 	/* buffer object of __global kern_data_store *kds */
-	clghj->m_dstore = clCreateBuffer(opencl_context,
-									 CL_MEM_READ_WRITE,
-									 KERN_DATA_STORE_LENGTH(kds),
-									 NULL,
-									 &rc);
+	clghj->m_dstore = clserv_create_buffer(clghj->dindex,
+										   KERN_DATA_STORE_LENGTH(kds),
+										   &gpuhashjoin->msg.pfm,
+										   &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -4635,11 +4704,10 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 	{
 		pgstrom_data_store *ktoast = pds->ktoast;
 
-		clghj->m_ktoast = clCreateBuffer(opencl_context,
-										 CL_MEM_READ_WRITE,
-										 KERN_DATA_STORE_LENGTH(ktoast->kds),
-										 NULL,
-										 &rc);
+		clghj->m_ktoast = clserv_create_buffer(clghj->dindex,
+											   KERN_DATA_STORE_LENGTH(ktoast->kds),
+											   &gpuhashjoin->msg.pfm,
+											   &rc);
 		if (rc != CL_SUCCESS)
 		{
 			clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -4654,11 +4722,10 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 	{
 		length = STROMALIGN(offsetof(kern_row_map,
 									 rindex[krowmap->nvalids]));
-		clghj->m_rowmap = clCreateBuffer(opencl_context,
-                                         CL_MEM_READ_WRITE,
-										 length,
-										 NULL,
-										 &rc);
+		clghj->m_rowmap = clserv_create_buffer(clghj->dindex,
+											   length,
+											   &gpuhashjoin->msg.pfm,
+											   &rc);
 		if (rc != CL_SUCCESS)
 		{
 			clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -4667,11 +4734,10 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 	}
 
 	/* buffer object of __global kern_data_store *kds_dest */
-	clghj->m_kresult = clCreateBuffer(opencl_context,
-									  CL_MEM_READ_WRITE,
-									  STROMALIGN(kds_dest->length),
-									  NULL,
-									  &rc);
+	clghj->m_kresult = clserv_create_buffer(clghj->dindex,
+											STROMALIGN(kds_dest->length),
+											&gpuhashjoin->msg.pfm,
+											&rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -4786,7 +4852,9 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 									   clghj->dindex,
 									   true,	/* larger is better? */
 									   nitems,
-									   sizeof(cl_uint)))
+									   sizeof(cl_uint),
+									   gpuhashjoin->dprog_key,
+									   &wgtune))
 		goto error;
 
 	rc = clSetKernelArg(clghj->kern_main,
@@ -4865,6 +4933,9 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 		clserv_log("gwork_sz=%zu lwork_sz=%zu", gwork_sz, lwork_sz);
 		goto error;
 	}
+	clserv_wgtune_feedback(&wgtune,
+						   clghj->events[clghj->ev_index],
+						   clghj->events[clghj->ev_index]);
 	clghj->ev_kern_main = clghj->ev_index;
 	clghj->ev_index++;
 	gpuhashjoin->msg.pfm.num_kern_exec++;
@@ -4885,7 +4956,9 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 									   clghj->dindex,
 									   false,   /* smaller is better */
 									   kds_dest->nrooms,
-									   sizeof(cl_uint)))
+									   sizeof(cl_uint),
+									   gpuhashjoin->dprog_key,
+									   &wgtune))
 		goto error;
 
 	rc = clSetKernelArg(clghj->kern_proj,
@@ -4963,6 +5036,9 @@ clserv_process_gpuhashjoin(pgstrom_message *message)
 				   opencl_strerror(rc));
 		goto error;
 	}
+	clserv_wgtune_feedback(&wgtune,
+						   clghj->events[clghj->ev_index],
+						   clghj->events[clghj->ev_index]);
 	clghj->ev_kern_proj = clghj->ev_index;
 	clghj->ev_index++;
 	gpuhashjoin->msg.pfm.num_kern_proj++;
@@ -5040,13 +5116,15 @@ error:
 				clReleaseEvent(clghj->events[--clghj->ev_index]);
 		}
 		if (clghj->m_kresult)
-			clReleaseMemObject(clghj->m_kresult);
+			clserv_release_buffer(clghj->dindex, clghj->m_kresult);
+		if (clghj->m_rowmap)
+			clserv_release_buffer(clghj->dindex, clghj->m_rowmap);
 		if (clghj->m_ktoast)
-			clReleaseMemObject(clghj->m_ktoast);
+			clserv_release_buffer(clghj->dindex, clghj->m_ktoast);
 		if (clghj->m_dstore)
-			clReleaseMemObject(clghj->m_dstore);
+			clserv_release_buffer(clghj->dindex, clghj->m_dstore);
 		if (clghj->m_join)
-			clReleaseMemObject(clghj->m_join);
+			clserv_release_buffer(clghj->dindex, clghj->m_join);
 		if (clghj->m_hash)
 		{
 			SpinLockAcquire(&mhtables->lock);
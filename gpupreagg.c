@@ -77,9 +77,11 @@ typedef struct
 	bool			outer_done;
 	bool			outer_bulkload;
 	TupleTableSlot *outer_overflow;
+	Bitmapset	   *outer_attrefs;	/* outer columns referenced by device */
 
 	pgstrom_queue  *mqueue;
 	Datum			dprog_key;
+	pgstrom_message *prebuild;	/* speculative build, if any */
 	kern_parambuf  *kparams;
 	bool			needs_grouping;
 
@@ -90,6 +92,7 @@ typedef struct
 	bool			curr_recheck;
 	cl_uint			num_rechecks;
 	cl_uint			num_running;
+	int				max_async_chunks;	/* current pipeline depth */
 	dlist_head		ready_chunks;
 
 	pgstrom_perfmon	pfm;		/* performance counter */
@@ -2225,8 +2228,12 @@ gpupreagg_begin(CustomPlan *node, EState *estate, int eflags)
 	gpas->scan_slot = ExecAllocTableSlot(&estate->es_tupleTable);
 	ExecSetSlotDescriptor(gpas->scan_slot, gpas->scan_desc);
 	gpas->outer_bulkload = gpreagg->outer_bulkload;
+	pull_varattnos((Node *)node->plan.targetlist,
+				   OUTER_VAR,
+				   &gpas->outer_attrefs);
 	gpas->outer_done = false;
 	gpas->outer_overflow = NULL;
+	gpas->max_async_chunks = pgstrom_max_async_chunks;
 
 	outer_width = outerPlanState(gpas)->plan->plan_width;
 	gpas->num_groups = gpreagg->num_groups;
@@ -2255,9 +2262,14 @@ gpupreagg_begin(CustomPlan *node, EState *estate, int eflags)
 	if (gpas->outer_bulkload)
 	{
 		if (pgstrom_plan_is_gpuscan(outerPlan(gpreagg)))
+		{
 			pgstrom_gpuscan_setup_bulkslot(outerPlanState(gpas),
 										   &gpas->bulk_proj,
 										   &gpas->bulk_slot);
+			pgstrom_gpuscan_bulk_attrefs(outerPlanState(gpas),
+										 gpas->outer_attrefs,
+										 gpreagg->outer_quals);
+		}
 		else if (pgstrom_plan_is_gpuhashjoin(outerPlan(gpreagg)))
 			pgstrom_gpuhashjoin_setup_bulkslot(outerPlanState(gpas),
 											   &gpas->bulk_proj,
@@ -2288,6 +2300,14 @@ gpupreagg_begin(CustomPlan *node, EState *estate, int eflags)
 	gpas->mqueue = pgstrom_create_queue();
 	pgstrom_track_object(&gpas->mqueue->sobj, 0);
 
+	/* kick the build prior to the first chunk being loaded */
+	if ((eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0)
+	{
+		gpas->prebuild = pgstrom_prebuild_devprog(gpas->dprog_key);
+		if (gpas->prebuild)
+			pgstrom_track_object(&gpas->prebuild->sobj, 0);
+	}
+
 	/*
 	 * init misc stuff
 	 */
@@ -2473,6 +2493,9 @@ gpupreagg_load_next_outer(GpuPreAggState *gpas)
 
 		if (pds)
 		{
+			pgstrom_data_store_columnize(pds, tupdesc,
+										 gpas->outer_attrefs);
+
 			memset(&bulkdata, 0, sizeof(pgstrom_bulkslot));
 			bulkdata.pds = pds;
 			bulkdata.nvalids = -1;	/* all valid */
@@ -2673,6 +2696,8 @@ gpupreagg_exec(CustomPlanState *node)
 	{
 		pgstrom_message	   *msg;
 		dlist_node		   *dnode;
+		pgstrom_message	   *pending[MQUEUE_BATCH_SIZE];
+		int					npending = 0;
 
 		/* release current gpupreagg chunk being already fetched */
 		if (gpas->curr_chunk)
@@ -2692,20 +2717,31 @@ gpupreagg_exec(CustomPlanState *node)
 		 * Keep number of asynchronous partial aggregate request a particular
 		 * level unless it does not exceed pgstrom_max_async_chunks and any
 		 * new response is not replied during the loading.
+		 * Pipeline depth shrinks under memory pressure.
+		 * Chunks are enqueued in a batch to save wakeups of the server,
+		 * but sent immediately if server has nothing to do.
 		 */
 		while (!gpas->outer_done &&
-			   gpas->num_running <= pgstrom_max_async_chunks)
+			   gpas->num_running <= gpas->max_async_chunks)
 		{
+			if (!pgstrom_reserve_async_chunk(&gpas->max_async_chunks,
+											 gpas->num_running > 0 ||
+											 !dlist_is_empty(&gpas->ready_chunks)))
+				break;	/* wait for the chunks in-progress */
+
 			gpreagg = gpupreagg_load_next_outer(gpas);
 			if (!gpreagg)
-				break;	/* outer scan reached to end of the relation */
-
-			if (!pgstrom_enqueue_message(&gpreagg->msg))
 			{
-				pgstrom_put_message(&gpreagg->msg);
-				elog(ERROR, "failed to enqueue pgstrom_gpuhashjoin message");
+				pgstrom_release_async_chunk();
+				break;	/* outer scan reached to end of the relation */
 			}
-            gpas->num_running++;
+			pgstrom_charge_async_chunk(gpreagg->pds);
+
+			pending[npending++] = &gpreagg->msg;
+			gpas->num_running++;
+			if (gpas->num_running == npending ||
+				npending == MQUEUE_BATCH_SIZE)
+				pgstrom_flush_messages(pending, &npending);
 
 			msg = pgstrom_try_dequeue_message(gpas->mqueue);
 			if (msg)
@@ -2715,6 +2751,7 @@ gpupreagg_exec(CustomPlanState *node)
 				break;
 			}
 		}
+		pgstrom_flush_messages(pending, &npending);
 
 		/*
 		 * wait for server's response if no available chunks were replied
@@ -2808,6 +2845,11 @@ gpupreagg_end(CustomPlanState *node)
 
 	pgstrom_untrack_object((StromObject *)gpas->dprog_key);
 	pgstrom_put_devprog_key(gpas->dprog_key);
+	if (gpas->prebuild)
+	{
+		pgstrom_untrack_object(&gpas->prebuild->sobj);
+		pgstrom_put_message(gpas->prebuild);
+	}
 	pgstrom_untrack_object(&gpas->mqueue->sobj);
 	pgstrom_close_queue(gpas->mqueue);
 
@@ -2873,7 +2915,10 @@ gpupreagg_explain(CustomPlanState *node, List *ancestors, ExplainState *es)
                                    2, &gpas->cps.ps, es);
 	}
 	if (es->analyze && gpas->pfm.enabled)
+	{
+		pgstrom_perfmon_prebuild(&gpas->pfm, gpas->prebuild);
 		pgstrom_perfmon_explain(&gpas->pfm, es);
+	}
 }
 
 static Bitmapset *
@@ -3003,6 +3048,7 @@ typedef struct
 	cl_uint				ev_kern_prep;	/* event index of kern_prep */
 	cl_uint				ev_kern_pagg;	/* event index of kern_pagg */
 	cl_uint				ev_index;
+	clserv_wgtune		wgtune_sort;	/* autotune ticket of bitonic sort */
 	cl_event			events[FLEXIBLE_ARRAY_MEMBER];
 } clstate_gpupreagg;
 
@@ -3165,13 +3211,13 @@ clserv_respond_gpupreagg(cl_event event, cl_int ev_status, void *private)
 	while (clgpa->ev_index > 0)
 		clReleaseEvent(clgpa->events[--clgpa->ev_index]);	
 	if (clgpa->m_gpreagg)
-		clReleaseMemObject(clgpa->m_gpreagg);
+		clserv_release_buffer(clgpa->dindex, clgpa->m_gpreagg);
 	if (clgpa->m_kds_in)
-		clReleaseMemObject(clgpa->m_kds_in);
+		clserv_release_buffer(clgpa->dindex, clgpa->m_kds_in);
 	if (clgpa->m_kds_src)
-		clReleaseMemObject(clgpa->m_kds_src);
+		clserv_release_buffer(clgpa->dindex, clgpa->m_kds_src);
 	if (clgpa->m_kds_dst)
-		clReleaseMemObject(clgpa->m_kds_dst);
+		clserv_release_buffer(clgpa->dindex, clgpa->m_kds_dst);
 	if (clgpa->kern_prep)
 		clReleaseKernel(clgpa->kern_prep);
 	if (clgpa->kern_set_rindex)
@@ -3199,6 +3245,7 @@ clserv_launch_preagg_preparation(clstate_gpupreagg *clgpa, cl_uint nitems)
 	cl_int		rc;
 	size_t		gwork_sz;
 	size_t		lwork_sz;
+	clserv_wgtune	wgtune;
 
 	/* __kernel void
 	 * gpupreagg_preparation(__global kern_gpupreagg *kgpreagg,
@@ -3207,9 +3254,9 @@ clserv_launch_preagg_preparation(clstate_gpupreagg *clgpa, cl_uint nitems)
 	 *                       __global kern_data_store *ktoast,
 	 *                       __local void *local_memory)
 	 */
-	clgpa->kern_prep = clCreateKernel(clgpa->program,
-									  "gpupreagg_preparation",
-									  &rc);
+	clgpa->kern_prep = clserv_lookup_device_kernel(clgpa->gpreagg->dprog_key,
+												   "gpupreagg_preparation",
+												   &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
@@ -3222,7 +3269,9 @@ clserv_launch_preagg_preparation(clstate_gpupreagg *clgpa, cl_uint nitems)
 									   clgpa->dindex,
 									   true,
 									   nitems,
-									   sizeof(cl_uint)))
+									   sizeof(cl_uint),
+									   clgpa->gpreagg->dprog_key,
+									   &wgtune))
 	{
 		clserv_log("failed to compute optimal gwork_sz/lwork_sz");
 		return StromError_OpenCLInternal;
@@ -3286,6 +3335,9 @@ clserv_launch_preagg_preparation(clstate_gpupreagg *clgpa, cl_uint nitems)
 				   opencl_strerror(rc));
 		return rc;
 	}
+	clserv_wgtune_feedback(&wgtune,
+						   clgpa->events[clgpa->ev_index],
+						   clgpa->events[clgpa->ev_index]);
 	clgpa->ev_kern_prep = clgpa->ev_index++;
 	clgpa->gpreagg->msg.pfm.num_kern_prep++;
 
@@ -3298,6 +3350,7 @@ clserv_launch_set_rindex(clstate_gpupreagg *clgpa, cl_uint nvalids)
 	cl_int		rc;
 	size_t		gwork_sz;
 	size_t		lwork_sz;
+	clserv_wgtune	wgtune;
 
 
 	/* Return without dispatch the kernel function if no data in the chunk.
@@ -3310,9 +3363,9 @@ clserv_launch_set_rindex(clstate_gpupreagg *clgpa, cl_uint nvalids)
 	 *                      __global kern_data_store *kds,
 	 *                      __local void *local_memory)
 	 */
-	clgpa->kern_set_rindex = clCreateKernel(clgpa->program,
-											"gpupreagg_set_rindex",
-											&rc);
+	clgpa->kern_set_rindex = clserv_lookup_device_kernel(clgpa->gpreagg->dprog_key,
+														 "gpupreagg_set_rindex",
+														 &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
@@ -3327,7 +3380,9 @@ clserv_launch_set_rindex(clstate_gpupreagg *clgpa, cl_uint nvalids)
 									   clgpa->dindex,
 									   true,
 									   nvalids,
-									   sizeof(cl_uint)))
+									   sizeof(cl_uint),
+									   clgpa->gpreagg->dprog_key,
+									   &wgtune))
 	{
 		clserv_log("failed to compute optimal gwork_sz/lwork_sz");
 		return StromError_OpenCLInternal;
@@ -3378,6 +3433,9 @@ clserv_launch_set_rindex(clstate_gpupreagg *clgpa, cl_uint nvalids)
 				   opencl_strerror(rc));
 		return rc;
 	}
+	clserv_wgtune_feedback(&wgtune,
+						   clgpa->events[clgpa->ev_index],
+						   clgpa->events[clgpa->ev_index]);
 	clgpa->ev_index++;
 	clgpa->gpreagg->msg.pfm.num_kern_sort++;
 
@@ -3397,9 +3455,9 @@ clserv_launch_bitonic_local(clstate_gpupreagg *clgpa,
 	 *                         __global kern_data_store *ktoast,
 	 *                         __local void *local_memory)
 	 */
-	kernel = clCreateKernel(clgpa->program,
-							"gpupreagg_bitonic_local",
-							&rc);
+	kernel = clserv_lookup_device_kernel(clgpa->gpreagg->dprog_key,
+										 "gpupreagg_bitonic_local",
+										 &rc);
 	if (rc != CL_SUCCESS)
     {
         clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
@@ -3476,6 +3534,7 @@ clserv_launch_bitonic_step(clstate_gpupreagg *clgpa,
 	cl_int		rc;
 	size_t		gwork_sz;
 	size_t		lwork_sz;
+	clserv_wgtune	wgtune;
 
 	/*
 	 * __kernel void
@@ -3485,9 +3544,9 @@ clserv_launch_bitonic_step(clstate_gpupreagg *clgpa,
 	 *                        __global kern_data_store *ktoast,
 	 *                        __local void *local_memory)
 	 */
-	kernel = clCreateKernel(clgpa->program,
-							"gpupreagg_bitonic_step",
-							&rc);
+	kernel = clserv_lookup_device_kernel(clgpa->gpreagg->dprog_key,
+										 "gpupreagg_bitonic_step",
+										 &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
@@ -3500,7 +3559,9 @@ clserv_launch_bitonic_step(clstate_gpupreagg *clgpa,
 									   clgpa->dindex,
 									   false,
 									   work_sz,
-									   sizeof(int)))
+									   sizeof(int),
+									   clgpa->gpreagg->dprog_key,
+									   &wgtune))
 	{
 		clserv_log("failed to compute optimal gwork_sz/lwork_sz");
 		return StromError_OpenCLInternal;
@@ -3579,6 +3640,9 @@ clserv_launch_bitonic_step(clstate_gpupreagg *clgpa,
 				   opencl_strerror(rc));
 		return rc;
 	}
+	clserv_wgtune_feedback(&wgtune,
+						   clgpa->events[clgpa->ev_index],
+						   clgpa->events[clgpa->ev_index]);
 	clgpa->ev_index++;
 	clgpa->gpreagg->msg.pfm.num_kern_sort++;
 
@@ -3598,9 +3662,9 @@ clserv_launch_bitonic_merge(clstate_gpupreagg *clgpa,
 	 *                         __global kern_data_store *ktoast,
 	 *                         __local void *local_memory)
 	 */
-	kernel = clCreateKernel(clgpa->program,
-							"gpupreagg_bitonic_merge",
-							&rc);
+	kernel = clserv_lookup_device_kernel(clgpa->gpreagg->dprog_key,
+										 "gpupreagg_bitonic_merge",
+										 &rc);
 	if (rc != CL_SUCCESS)
     {
         clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
@@ -3674,6 +3738,7 @@ clserv_launch_preagg_reduction(clstate_gpupreagg *clgpa, cl_uint nvalids)
 	cl_int		rc;
 	size_t		gwork_sz;
 	size_t		lwork_sz;
+	clserv_wgtune	wgtune;
 
 	/* __kernel void
 	 * gpupreagg_reduction(__global kern_gpupreagg *kgpreagg,
@@ -3682,9 +3747,9 @@ clserv_launch_preagg_reduction(clstate_gpupreagg *clgpa, cl_uint nvalids)
 	 *                     __global kern_data_store *ktoast,
 	 *                     __local void *local_memory)
 	 */
-	clgpa->kern_pagg = clCreateKernel(clgpa->program,
-									  "gpupreagg_reduction",
-									  &rc);
+	clgpa->kern_pagg = clserv_lookup_device_kernel(clgpa->gpreagg->dprog_key,
+												   "gpupreagg_reduction",
+												   &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateKernel: %s", opencl_strerror(rc));
@@ -3700,7 +3765,9 @@ clserv_launch_preagg_reduction(clstate_gpupreagg *clgpa, cl_uint nvalids)
 									   clgpa->dindex,
 									   true,
 									   nvalids,
-									   sizeof(pagg_datum)))
+									   sizeof(pagg_datum),
+									   clgpa->gpreagg->dprog_key,
+									   &wgtune))
 	{
 		clserv_log("failed to compute optimal gwork_sz/lwork_sz");
 		return StromError_OpenCLInternal;
@@ -3771,6 +3838,9 @@ clserv_launch_preagg_reduction(clstate_gpupreagg *clgpa, cl_uint nvalids)
 				   opencl_strerror(rc));
 		return rc;
 	}
+	clserv_wgtune_feedback(&wgtune,
+						   clgpa->events[clgpa->ev_index],
+						   clgpa->events[clgpa->ev_index]);
 	clgpa->ev_kern_pagg = clgpa->ev_index++;
 	clgpa->gpreagg->msg.pfm.num_kern_exec++;
 
@@ -3823,7 +3893,8 @@ bitonic_compute_workgroup_size(clstate_gpupreagg *clgpa,
 										  clgpa->dindex,
 										  true,
 										  nhalf,
-										  kern_calls[i].kern_lmem))
+										  kern_calls[i].kern_lmem,
+										  0, NULL))
 		{
 			clserv_log("failed on clserv_compute_workgroup_size");
 			clReleaseKernel(kernel);
@@ -3838,6 +3909,21 @@ bitonic_compute_workgroup_size(clstate_gpupreagg *clgpa,
 	 * equal to the least one of expected kernels.
 	 */
 	lwork_sz = 1UL << (get_next_log2(least_sz + 1) - 1);
+	/*
+	 * NOTE: local and merge kernels have to share an identical 2^N unit
+	 * size, so we tune it as if a pseudo kernel, and feedback the time of
+	 * whole the sorting stuff.
+	 */
+	lwork_sz = clserv_wgtune_choose(&clgpa->wgtune_sort,
+									clgpa->gpreagg->dprog_key,
+									NULL,
+									"gpupreagg_bitonic_local",
+									clgpa->dindex,
+									Min(lwork_sz,
+										sizeof(cl_uint) * BITS_PER_BYTE),
+									lwork_sz,
+									lwork_sz,
+									nhalf);
 	gwork_sz = ((nhalf + lwork_sz - 1) / lwork_sz) * lwork_sz;
 
 	*p_lwork_sz = lwork_sz;
@@ -3865,7 +3951,8 @@ clserv_process_gpupreagg(pgstrom_message *message)
 
 	Assert(StromTagIs(gpreagg, GpuPreAgg));
 	Assert(kds->format == KDS_FORMAT_ROW ||
-		   kds->format == KDS_FORMAT_ROW_FLAT);
+		   kds->format == KDS_FORMAT_ROW_FLAT ||
+		   kds->format == KDS_FORMAT_COLUMN);
 	Assert(kds_dest->format == KDS_FORMAT_TUPSLOT);
 
 	/*
@@ -3911,7 +3998,8 @@ clserv_process_gpupreagg(pgstrom_message *message)
 	/*
 	 * choose a device to run
 	 */
-	clgpa->dindex = pgstrom_opencl_device_schedule(&gpreagg->msg);
+	clgpa->dindex = pgstrom_opencl_device_schedule(&gpreagg->msg,
+												   kds->length);
 	clgpa->kcmdq = opencl_cmdq[clgpa->dindex];
 
 	/*
@@ -3927,11 +4015,10 @@ clserv_process_gpupreagg(pgstrom_message *message)
 
 	/* allocation of m_gpreagg */
 	length = KERN_GPUPREAGG_BUFFER_SIZE(&gpreagg->kern);
-	clgpa->m_gpreagg = clCreateBuffer(opencl_context,
-									  CL_MEM_READ_WRITE,
-									  length,
-									  NULL,
-									  &rc);
+	clgpa->m_gpreagg = clserv_create_buffer(clgpa->dindex,
+											length,
+											&gpreagg->msg.pfm,
+											&rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -3939,33 +4026,30 @@ clserv_process_gpupreagg(pgstrom_message *message)
 	}
 
 	/* allocation of kds_in */
-	clgpa->m_kds_in = clCreateBuffer(opencl_context,
-									 CL_MEM_READ_WRITE,
-									 KERN_DATA_STORE_LENGTH(kds),
-									 NULL,
-									 &rc);
+	clgpa->m_kds_in = clserv_create_buffer(clgpa->dindex,
+										   KERN_DATA_STORE_LENGTH(kds),
+										   &gpreagg->msg.pfm,
+										   &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
 		goto error;
 	}
 	/* allocation of kds_src */
-	clgpa->m_kds_src = clCreateBuffer(opencl_context,
-									  CL_MEM_READ_WRITE,
-									  KERN_DATA_STORE_LENGTH(kds_dest),
-									  NULL,
-									  &rc);
+	clgpa->m_kds_src = clserv_create_buffer(clgpa->dindex,
+											KERN_DATA_STORE_LENGTH(kds_dest),
+											&gpreagg->msg.pfm,
+											&rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
 		goto error;
 	}
 	/* allocation of kds_dst */
-	clgpa->m_kds_dst = clCreateBuffer(opencl_context,
-									  CL_MEM_READ_WRITE,
-									  KERN_DATA_STORE_LENGTH(kds_dest),
-									  NULL,
-									  &rc);
+	clgpa->m_kds_dst = clserv_create_buffer(clgpa->dindex,
+											KERN_DATA_STORE_LENGTH(kds_dest),
+											&gpreagg->msg.pfm,
+											&rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -4088,6 +4172,7 @@ clserv_process_gpupreagg(pgstrom_message *message)
 		size_t		nsteps;
 		size_t		launches;
 		size_t		i, j;
+		cl_uint		ev_sort_begin;
 
 		rc = bitonic_compute_workgroup_size(clgpa, nhalf,
 											&gwork_sz,
@@ -4116,6 +4201,7 @@ clserv_process_gpupreagg(pgstrom_message *message)
 		}
 
 		/* Sort key in each local work group */
+		ev_sort_begin = clgpa->ev_index;
         rc = clserv_launch_bitonic_local(clgpa, gwork_sz, lwork_sz);
 		if (rc != CL_SUCCESS)
 			goto error;
@@ -4139,6 +4225,9 @@ clserv_process_gpupreagg(pgstrom_message *message)
 			if (rc != CL_SUCCESS)
 				goto error;
 		}
+		clserv_wgtune_feedback(&clgpa->wgtune_sort,
+							   clgpa->events[ev_sort_begin],
+							   clgpa->events[clgpa->ev_index - 1]);
 	}
 
 	/* kick, gpupreagg_reduction() */
@@ -4214,13 +4303,13 @@ error:
 		}
 	
 		if (clgpa->m_gpreagg)
-			clReleaseMemObject(clgpa->m_gpreagg);
+			clserv_release_buffer(clgpa->dindex, clgpa->m_gpreagg);
 		if (clgpa->m_kds_in)
-			clReleaseMemObject(clgpa->m_kds_in);
+			clserv_release_buffer(clgpa->dindex, clgpa->m_kds_in);
 		if (clgpa->m_kds_src)
-			clReleaseMemObject(clgpa->m_kds_src);
+			clserv_release_buffer(clgpa->dindex, clgpa->m_kds_src);
 		if (clgpa->m_kds_dst)
-			clReleaseMemObject(clgpa->m_kds_dst);
+			clserv_release_buffer(clgpa->dindex, clgpa->m_kds_dst);
 		if (clgpa->kern_prep)
 			clReleaseKernel(clgpa->kern_prep);
 		if (clgpa->kern_set_rindex)
@@ -20,6 +20,7 @@
 #include "catalog/pg_type.h"
 #include "catalog/pg_namespace.h"
 #include "commands/explain.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
 #include "nodes/bitmapset.h"
 #include "nodes/execnodes.h"
@@ -51,6 +52,7 @@ static add_scan_path_hook_type	add_scan_path_next;
 static CustomPathMethods		gpuscan_path_methods;
 static CustomPlanMethods		gpuscan_plan_methods;
 static bool						enable_gpuscan;
+static bool						pgstrom_direct_read;
 
 typedef struct {
 	CustomPath	cpath;
@@ -75,16 +77,22 @@ typedef struct {
 	HeapTupleData		scan_tuple;
 	BlockNumber			curr_blknum;
 	BlockNumber			last_blknum;
+	BlockNumber			prefetch_blknum;	/* next block to be prefetched */
+	BufferAccessStrategy strategy;	/* ring-buffer for bulk-read, if any */
+	pgstrom_direct_reader *dreader;	/* direct relation reader, if any */
 	cl_uint				tuple_width;
 	List			   *dev_quals;
+	Bitmapset		   *column_attrefs;	/* columns to be loaded, if any */
 
 	pgstrom_queue	   *mqueue;
 	Datum				dprog_key;
+	pgstrom_message	   *prebuild;	/* speculative build, if any */
 	kern_parambuf	   *kparams;
 
 	pgstrom_gpuscan	   *curr_chunk;
 	uint32				curr_index;
 	int					num_running;
+	int					max_async_chunks;	/* current pipeline depth */
 	dlist_head			ready_chunks;
 
 	pgstrom_perfmon		pfm;	/* sum of performance counter */
@@ -751,6 +759,46 @@ pgstrom_gpuscan_setup_bulkslot(PlanState *outer_ps,
 	*p_bulk_slot = gss->scan_slot;
 }
 
+/*
+ * pgstrom_gpuscan_bulk_attrefs
+ *
+ * It informs GpuScan which columns are referenced by the device kernel of
+ * the parent node on bulk-loading, so GpuScan can construct column-format
+ * data-store that also contains them at once.
+ * attr_refs is a bitmap of resource numbers on the target-list of GpuScan,
+ * offset by FirstLowInvalidHeapAttributeNumber. upper_quals is the device
+ * qualifiers pulled-up by gpuscan_try_replace_seqscan_plan(), if any, that
+ * reference the scan relation directly.
+ */
+void
+pgstrom_gpuscan_bulk_attrefs(PlanState *outer_ps,
+							 Bitmapset *attr_refs,
+							 List *upper_quals)
+{
+	GpuScanState   *gss = (GpuScanState *) outer_ps;
+	GpuScanPlan	   *gsplan = (GpuScanPlan *) gss->cps.ps.plan;
+	ListCell	   *lc;
+
+	if (!IsA(gss, CustomPlanState) ||
+		gss->cps.methods != &gpuscan_plan_methods)
+		elog(ERROR, "Bug? PlanState node is not GpuScan");
+
+	foreach (lc, gsplan->cplan.plan.targetlist)
+	{
+		TargetEntry	   *tle = lfirst(lc);
+		int				x = tle->resno - FirstLowInvalidHeapAttributeNumber;
+
+		if (!bms_is_member(x, attr_refs))
+			continue;
+		pull_varattnos((Node *)tle->expr,
+					   gsplan->scanrelid,
+					   &gss->column_attrefs);
+	}
+	pull_varattnos((Node *)upper_quals,
+				   gsplan->scanrelid,
+				   &gss->column_attrefs);
+}
+
 static  CustomPlanState *
 gpuscan_begin(CustomPlan *node, EState *estate, int eflags)
 {
@@ -821,10 +869,38 @@ gpuscan_begin(CustomPlan *node, EState *estate, int eflags)
 	 */
 	gss->curr_blknum = 0;
 	gss->last_blknum = RelationGetNumberOfBlocks(gss->scan_rel);
+	gss->prefetch_blknum = 0;
 	estimate_rel_size(gss->scan_rel, NULL,
 					  &relpages, &reltuples, &allvisfrac);
 	gss->tuple_width = (Size)((double)BLCKSZ * (double)relpages / reltuples);
 
+	/*
+	 * Like initscan() doing, large relation is loaded via the ring-buffer
+	 * of bulk-read strategy, not to thrash the shared buffer pool.
+	 * Ring size of BAS_BULKREAD is fixed, so buffers pinned by in-flight
+	 * chunks are replaced by the fresh ones; however, buffers loaded via
+	 * the strategy never have usage_count more than 1, so they are the
+	 * first victim of clock-sweep once the chunk gets released. Thus,
+	 * footprint of GpuScan on the shared buffer is bounded by the number
+	 * of blocks being in-flight.
+	 */
+	if (gss->last_blknum > NBuffers / 4)
+		gss->strategy = GetAccessStrategy(BAS_BULKREAD);
+	else
+		gss->strategy = NULL;
+
+	/*
+	 * On the scan far larger than shared buffer, blocks not cached are
+	 * loaded from the relation segment files directly, if available.
+	 */
+	if (pgstrom_direct_read &&
+		(eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0 &&
+		gss->last_blknum > NBuffers)
+		gss->dreader = pgstrom_begin_direct_read(gss->scan_rel,
+												 estate->es_snapshot);
+	else
+		gss->dreader = NULL;
+
 	/*
 	 * Setting up kernel program, if needed
 	 */
@@ -834,9 +910,22 @@ gpuscan_begin(CustomPlan *node, EState *estate, int eflags)
 												 gsplan->extra_flags);
 		pgstrom_track_object((StromObject *)gss->dprog_key, 0);
 
+		/* columns to be loaded on column-format data-store */
+		pull_varattnos((Node *)gsplan->used_vars,
+					   scanrelid,
+					   &gss->column_attrefs);
+
 		/* also, message queue */
 		gss->mqueue = pgstrom_create_queue();
 		pgstrom_track_object(&gss->mqueue->sobj, 0);
+
+		/* kick the build prior to the first chunk being loaded */
+		if ((eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0)
+		{
+			gss->prebuild = pgstrom_prebuild_devprog(gss->dprog_key);
+			if (gss->prebuild)
+				pgstrom_track_object(&gss->prebuild->sobj, 0);
+		}
 	}
 	gss->kparams = pgstrom_create_kern_parambuf(gsplan->used_params,
 												gss->cps.ps.ps_ExprContext);
@@ -844,6 +933,7 @@ gpuscan_begin(CustomPlan *node, EState *estate, int eflags)
 	gss->curr_chunk = NULL;
 	gss->curr_index = 0;
 	gss->num_running = 0;
+	gss->max_async_chunks = pgstrom_max_async_chunks;
 	dlist_init(&gss->ready_chunks);
 
 	/* Is perfmon needed? */
@@ -930,6 +1020,62 @@ pgstrom_create_gpuscan(GpuScanState *gss, pgstrom_data_store *pds)
 	return gpuscan;
 }
 
+/*
+ * gpuscan_prefetch_blocks
+ *
+ * Read-ahead, like bitmap heap scan doing; it keeps prefetch requests
+ * up to target_prefetch_pages (derived from effective_io_concurrency)
+ * ahead of the block being loaded. It supplements the read-ahead of the
+ * whole chunk by gpuscan_prefetch_next_chunk().
+ */
+static inline void
+gpuscan_prefetch_blocks(GpuScanState *gss)
+{
+	BlockNumber	prefetch_limit;
+
+	if (target_prefetch_pages <= 0)
+		return;
+
+	prefetch_limit = Min(gss->curr_blknum + 1 + target_prefetch_pages,
+						 gss->last_blknum);
+	if (gss->prefetch_blknum <= gss->curr_blknum)
+		gss->prefetch_blknum = gss->curr_blknum + 1;
+	while (gss->prefetch_blknum < prefetch_limit)
+		PrefetchBuffer(gss->scan_rel, MAIN_FORKNUM, gss->prefetch_blknum++);
+}
+
+/*
+ * gpuscan_prefetch_next_chunk
+ *
+ * Read-ahead of the next chunk; once a chunk is enqueued, we issue prefetch
+ * requests for the block range of the next chunk, so the storage system
+ * reads them while the device is working on the chunks in-progress.
+ * The window is the expected number of blocks per chunk, but capped by
+ * GPUSCAN_PREFETCH_BLOCKS_PER_IO blocks per concurrent I/O being allowed
+ * by effective_io_concurrency.
+ */
+#define GPUSCAN_PREFETCH_BLOCKS_PER_IO		64
+
+static void
+gpuscan_prefetch_next_chunk(GpuScanState *gss)
+{
+	BlockNumber	chunk_nblocks = (pgstrom_chunk_size << 20) / BLCKSZ;
+	BlockNumber	prefetch_limit;
+
+	if (target_prefetch_pages <= 0)
+		return;
+
+	chunk_nblocks = Min(chunk_nblocks,
+						(BlockNumber) target_prefetch_pages *
+						GPUSCAN_PREFETCH_BLOCKS_PER_IO);
+	prefetch_limit = Min(gss->curr_blknum + chunk_nblocks,
+						 gss->last_blknum);
+	if (gss->prefetch_blknum < gss->curr_blknum)
+		gss->prefetch_blknum = gss->curr_blknum;
+	while (gss->prefetch_blknum < prefetch_limit)
+		PrefetchBuffer(gss->scan_rel, MAIN_FORKNUM, gss->prefetch_blknum++);
+}
+
 static pgstrom_gpuscan *
 pgstrom_load_gpuscan(GpuScanState *gss)
 {
@@ -939,6 +1085,7 @@ pgstrom_load_gpuscan(GpuScanState *gss)
 	Snapshot			snapshot = gss->cps.ps.state->es_snapshot;
 	Size				length;
 	pgstrom_data_store *pds;
+	instr_time			io_time;
 	struct timeval tv1, tv2;
 
 	/* no more blocks to read */
@@ -946,21 +1093,49 @@ pgstrom_load_gpuscan(GpuScanState *gss)
 		return NULL;
 
 	if (gss->pfm.enabled)
+	{
 		gettimeofday(&tv1, NULL);
+		io_time = pgBufferUsage.blk_read_time;
+	}
 
 retry:
 	length = (pgstrom_chunk_size << 20);
+
 	pds = pgstrom_create_data_store_row(tupdesc, length, gss->tuple_width);
 	PG_TRY();
 	{
-		while (gss->curr_blknum < gss->last_blknum &&
-			   pgstrom_data_store_insert_block(pds, rel,
+		if (gss->dreader)
+			gss->curr_blknum =
+				pgstrom_data_store_direct_read(pds, gss->dreader,
 											   gss->curr_blknum,
-											   snapshot, true) >= 0)
-			gss->curr_blknum++;
+											   gss->last_blknum,
+											   snapshot,
+											   gss->strategy);
+		else
+		{
+			while (gss->curr_blknum < gss->last_blknum)
+			{
+				gpuscan_prefetch_blocks(gss);
+				if (pgstrom_data_store_insert_block(pds, rel,
+													gss->curr_blknum,
+													snapshot, true,
+													gss->strategy) < 0)
+					break;
+				gss->curr_blknum++;
+			}
+		}
 
 		if (pds->kds->nitems > 0)
+		{
+			/*
+			 * Device kernel (ours or parent's one on bulk-loading) takes
+			 * only the referenced columns, if any.
+			 */
+			if (gss->column_attrefs)
+				pgstrom_data_store_columnize(pds, tupdesc,
+											 gss->column_attrefs);
 			gpuscan = pgstrom_create_gpuscan(gss, pds);
+		}
 		else
 		{
 			pgstrom_put_data_store(pds);
@@ -987,11 +1162,24 @@ retry:
 	/* track local object */
 	if (gpuscan)
 		pgstrom_track_object(&gpuscan->msg.sobj, 0);
-	/* update perfmon statistics */
+	/*
+	 * update perfmon statistics; time blocked on I/O is tracked only when
+	 * track_io_timing is enabled, and excluded from time_outer_load.
+	 */
 	if (gss->pfm.enabled)
 	{
+		instr_time	io_time_end = pgBufferUsage.blk_read_time;
+		cl_ulong	time_load;
+		cl_ulong	time_io_wait;
+
 		gettimeofday(&tv2, NULL);
-		gss->pfm.time_outer_load += timeval_diff(&tv1, &tv2);
+		INSTR_TIME_SUBTRACT(io_time_end, io_time);
+		time_load = timeval_diff(&tv1, &tv2);
+		time_io_wait = INSTR_TIME_GET_MICROSEC(io_time_end);
+		if (time_io_wait > time_load)
+			time_io_wait = time_load;
+		gss->pfm.time_io_wait += time_io_wait;
+		gss->pfm.time_outer_load += time_load - time_io_wait;
 	}
 	return gpuscan;
 }
@@ -1067,6 +1255,8 @@ pgstrom_fetch_gpuscan(GpuScanState *gss)
 {
 	pgstrom_message	   *msg;
 	pgstrom_gpuscan	   *gpuscan;
+	pgstrom_message	   *pending[MQUEUE_BATCH_SIZE];
+	int					npending = 0;
 
 	/*
 	 * In case when no device code will be executed, we don't need to have
@@ -1083,20 +1273,31 @@ pgstrom_fetch_gpuscan(GpuScanState *gss)
 	 * Try to keep number of gpuscan chunks being asynchronously executed
 	 * larger than minimum multiplicity, unless it does not exceed
 	 * maximum one and OpenCL server does not return a new response.
+	 * Pipeline depth shrinks under memory pressure.
+	 * Chunks are enqueued in a batch to save wakeups of the server, but
+	 * sent immediately if server has nothing to do.
 	 */
-	while (gss->num_running <= pgstrom_max_async_chunks)
+	while (gss->num_running <= gss->max_async_chunks)
 	{
-		pgstrom_gpuscan	*gpuscan = pgstrom_load_gpuscan(gss);
+		pgstrom_gpuscan	*gpuscan;
 
-		if (!gpuscan)
-			break;	/* scan reached end of the relation */
+		if (!pgstrom_reserve_async_chunk(&gss->max_async_chunks,
+										 gss->num_running > 0 ||
+										 !dlist_is_empty(&gss->ready_chunks)))
+			break;	/* wait for the chunks in-progress */
 
-		if (!pgstrom_enqueue_message(&gpuscan->msg))
+		gpuscan = pgstrom_load_gpuscan(gss);
+		if (!gpuscan)
 		{
-			pgstrom_put_message(&gpuscan->msg);
-			elog(ERROR, "failed to enqueue pgstrom_gpuscan message");
+			pgstrom_release_async_chunk();
+			break;	/* scan reached end of the relation */
 		}
+		pgstrom_charge_async_chunk(gpuscan->pds);
+
+		pending[npending++] = &gpuscan->msg;
 		gss->num_running++;
+		if (gss->num_running == npending || npending == MQUEUE_BATCH_SIZE)
+			pgstrom_flush_messages(pending, &npending);
 
 		if (gss->num_running > pgstrom_min_async_chunks &&
 			(msg = pgstrom_try_dequeue_message(gss->mqueue)) != NULL)
@@ -1106,6 +1307,11 @@ pgstrom_fetch_gpuscan(GpuScanState *gss)
 			break;
 		}
 	}
+	pgstrom_flush_messages(pending, &npending);
+
+	/* blocks of the next chunk are read during device execution */
+	if (gss->num_running > 0)
+		gpuscan_prefetch_next_chunk(gss);
 
 	/*
 	 * Wait for server's response if no available chunks were replied.
@@ -1476,6 +1682,12 @@ gpuscan_end(CustomPlanState *node)
 		pgstrom_put_devprog_key(gss->dprog_key);
 	}
 
+	if (gss->prebuild)
+	{
+		pgstrom_untrack_object(&gss->prebuild->sobj);
+		pgstrom_put_message(gss->prebuild);
+	}
+
 	if (gss->mqueue)
 	{
 		pgstrom_untrack_object(&gss->mqueue->sobj);
@@ -1494,8 +1706,12 @@ gpuscan_end(CustomPlanState *node)
 	ExecClearTuple(gss->scan_slot);
 
 	/*
-	 * close heap scan and relation
+	 * release the ring-buffer, and close the relation
 	 */
+	if (gss->strategy)
+		FreeAccessStrategy(gss->strategy);
+	if (gss->dreader)
+		pgstrom_end_direct_read(gss->dreader);
 	heap_close(gss->scan_rel, NoLock);
 }
 
@@ -1571,6 +1787,7 @@ gpuscan_rescan(CustomPlanState *node)
 	 * OK, asynchronous jobs were cleared. revert scan state to the head.
 	 */
 	gss->curr_blknum = 0;
+	gss->prefetch_blknum = 0;
 }
 
 static void
@@ -1641,7 +1858,10 @@ gpuscan_explain(CustomPlanState *node, List *ancestors, ExplainState *es)
 	show_device_kernel(gss->dprog_key, es);
 
 	if (es->analyze && gss->pfm.enabled)
+	{
+		pgstrom_perfmon_prebuild(&gss->pfm, gss->prebuild);
 		pgstrom_perfmon_explain(&gss->pfm, es);
+	}
 }
 
 static Bitmapset *
@@ -1710,6 +1930,15 @@ pgstrom_init_gpuscan(void)
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
 
+	DefineCustomBoolVariable("pg_strom.direct_read",
+							 "Enables direct read of relation using io_uring on large GpuScan",
+							 NULL,
+							 &pgstrom_direct_read,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
 	/* setup path methods */
 	gpuscan_path_methods.CustomName			= "GpuScan";
 	gpuscan_path_methods.CreateCustomPlan	= gpuscan_create_plan;
@@ -1753,6 +1982,7 @@ typedef struct
 	cl_mem			m_gpuscan;
 	cl_mem			m_dstore;
 	cl_mem			m_ktoast;
+	cl_int			dindex;
 	cl_uint			ev_index;
 	cl_event		events[20];
 } clstate_gpuscan;
@@ -1876,9 +2106,9 @@ clserv_respond_gpuscan(cl_event event, cl_int ev_status, void *private)
 	while (clgss->ev_index > 0)
 		clReleaseEvent(clgss->events[--clgss->ev_index]);
 	if (clgss->m_ktoast)
-		clReleaseMemObject(clgss->m_ktoast);
-	clReleaseMemObject(clgss->m_dstore);
-	clReleaseMemObject(clgss->m_gpuscan);
+		clserv_release_buffer(clgss->dindex, clgss->m_ktoast);
+	clserv_release_buffer(clgss->dindex, clgss->m_dstore);
+	clserv_release_buffer(clgss->dindex, clgss->m_gpuscan);
 	clReleaseKernel(clgss->kernel);
 	clReleaseProgram(clgss->program);
 	free(clgss);
@@ -1909,10 +2139,12 @@ clserv_process_gpuscan(pgstrom_message *msg)
 	size_t				offset;
 	size_t				gwork_sz;
 	size_t				lwork_sz;
+	clserv_wgtune		wgtune;
 
 	/* sanity checks */
 	Assert(StromTagIs(gpuscan, GpuScan));
-	Assert(kds->format == KDS_FORMAT_ROW);
+	Assert(kds->format == KDS_FORMAT_ROW ||
+		   kds->format == KDS_FORMAT_COLUMN);
 	Assert(kresults->nrels == 1);
 	if (kds->nitems == 0)
 	{
@@ -1962,7 +2194,9 @@ clserv_process_gpuscan(pgstrom_message *msg)
 	/*
 	 * lookup kernel function for gpuscan
 	 */
-	clgss->kernel = clCreateKernel(clgss->program, "gpuscan_qual", &rc);
+	clgss->kernel = clserv_lookup_device_kernel(gpuscan->dprog_key,
+												"gpuscan_qual",
+												&rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -1973,20 +2207,21 @@ clserv_process_gpuscan(pgstrom_message *msg)
 	 * choose a device to execute this kernel, and compute an optimal
 	 * workgroup-size of this kernel
 	 */
-	dindex = pgstrom_opencl_device_schedule(&gpuscan->msg);
+	dindex = pgstrom_opencl_device_schedule(&gpuscan->msg, kds->length);
+	clgss->dindex = dindex;
 	kcmdq = opencl_cmdq[dindex];	
 	if (!clserv_compute_workgroup_size(&gwork_sz, &lwork_sz,
 									   clgss->kernel, dindex,
 									   false,	/* smaller WG-sz is better */
-									   kds->nitems, sizeof(cl_uint)))
+									   kds->nitems, sizeof(cl_uint),
+									   gpuscan->dprog_key, &wgtune))
 		goto error;
 
 	/* allocation of device memory for kern_gpuscan argument */
-	clgss->m_gpuscan = clCreateBuffer(opencl_context,
-									  CL_MEM_READ_WRITE,
-									  KERN_GPUSCAN_LENGTH(&gpuscan->kern),
-									  NULL,
-									  &rc);
+	clgss->m_gpuscan = clserv_create_buffer(clgss->dindex,
+											KERN_GPUSCAN_LENGTH(&gpuscan->kern),
+											&gpuscan->msg.pfm,
+											&rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -1994,11 +2229,10 @@ clserv_process_gpuscan(pgstrom_message *msg)
 	}
 
 	/* allocation of device memory for kern_data_store argument */
-	clgss->m_dstore = clCreateBuffer(opencl_context,
-									 CL_MEM_READ_WRITE,
-									 KERN_DATA_STORE_LENGTH(kds),
-									 NULL,
-									 &rc);
+	clgss->m_dstore = clserv_create_buffer(clgss->dindex,
+										   KERN_DATA_STORE_LENGTH(kds),
+										   &gpuscan->msg.pfm,
+										   &rc);
 	if (rc != CL_SUCCESS)
 	{
 		clserv_log("failed on clCreateBuffer: %s", opencl_strerror(rc));
@@ -2120,6 +2354,9 @@ clserv_process_gpuscan(pgstrom_message *msg)
 				   opencl_strerror(rc));
 		goto error;
 	}
+	clserv_wgtune_feedback(&wgtune,
+						   clgss->events[clgss->ev_index],
+						   clgss->events[clgss->ev_index]);
 	clgss->ev_index++;
 	pfm->num_kern_exec++;
 
@@ -2166,11 +2403,11 @@ error:
 		if (clgss->ev_index > 0)
 			clWaitForEvents(clgss->ev_index, clgss->events);
 		if (clgss->m_ktoast)
-			clReleaseMemObject(clgss->m_ktoast);
+			clserv_release_buffer(clgss->dindex, clgss->m_ktoast);
 		if (clgss->m_dstore)
-			clReleaseMemObject(clgss->m_dstore);
+			clserv_release_buffer(clgss->dindex, clgss->m_dstore);
 		if (clgss->m_gpuscan)
-			clReleaseMemObject(clgss->m_gpuscan);
+			clserv_release_buffer(clgss->dindex, clgss->m_gpuscan);
 		if (clgss->kernel)
 			clReleaseKernel(clgss->kernel);
 		if (clgss->program)
@@ -38,6 +38,7 @@ static bool guc_pgstrom_enabled_global;
 bool	pgstrom_perfmon_enabled;
 bool	pgstrom_show_device_kernel;
 int		pgstrom_chunk_size;
+bool	pgstrom_column_format;
 int		pgstrom_max_async_chunks;
 int		pgstrom_min_async_chunks;
 
@@ -139,6 +140,14 @@ pgstrom_init_misc_guc(void)
 							PGC_USERSET,
 							GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
+	DefineCustomBoolVariable("pg_strom.column_format",
+							 "Enables column-format data store for device kernels",
+							 NULL,
+							 &pgstrom_column_format,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 	DefineCustomIntVariable("pg_strom.min_async_chunks",
 							"least number of chunks to be run asynchronously",
 							NULL,
@@ -438,6 +447,77 @@ show_device_kernel(Datum dprog_key, ExplainState *es)
 	pfree(str.data);
 }
 
+/*
+ * pgstrom_reserve_async_chunk
+ *
+ * It reserves a budget of shared memory for a chunk to be executed
+ * asynchronously, in bytes of pg_strom.chunk_size as an estimation.
+ * Once the chunk is loaded, the caller hands over the budget to the
+ * data-store using pgstrom_charge_async_chunk(), or releases it using
+ * pgstrom_release_async_chunk() if nothing was loaded.
+ * If the budget is not available right now, it shrinks
+ * the pipeline depth (*p_max_async) and returns false, to wait for the
+ * chunks in-progress, instead of out-of-memory error. Only if no chunks
+ * are pending, it waits for the budget up to pg_strom.shmem_reserve_timeout.
+ * Once the budget gets available, pipeline depth is recovered gradually.
+ */
+bool
+pgstrom_reserve_async_chunk(int *p_max_async, bool has_pending)
+{
+	Size	unitsz = ((Size)pgstrom_chunk_size) << 20;
+
+	if (pgstrom_shmem_reserve(unitsz, false))
+	{
+		if (*p_max_async < pgstrom_max_async_chunks)
+			(*p_max_async)++;
+		return true;
+	}
+	*p_max_async = Max(pgstrom_min_async_chunks, *p_max_async / 2);
+
+	if (has_pending)
+		return false;
+	if (!pgstrom_shmem_reserve(unitsz, true))
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("PG-Strom: timeout on shared memory reservation")));
+	return true;
+}
+
+void
+pgstrom_release_async_chunk(void)
+{
+	pgstrom_shmem_unreserve(((Size)pgstrom_chunk_size) << 20);
+}
+
+/*
+ * pgstrom_charge_async_chunk
+ *
+ * It charges the budget being reserved on the data-store, with adjustment
+ * to the actual length of shared memory. The budget is kept until the
+ * data-store is released, thus it bounds the memory in-flight, not only
+ * number of chunks waiting for the response.
+ * If the data-store is already charged (e.g, a chunk handed over from
+ * the underlying GpuScan), the estimation is simply released.
+ */
+void
+pgstrom_charge_async_chunk(pgstrom_data_store *pds)
+{
+	Size	unitsz = ((Size)pgstrom_chunk_size) << 20;
+	Size	length;
+
+	if (pds->reserved > 0)
+	{
+		pgstrom_shmem_unreserve(unitsz);
+		return;
+	}
+	length = pgstrom_data_store_shmem_length(pds);
+	if (length > unitsz)
+		pgstrom_shmem_reserve_force(length - unitsz);
+	else if (length < unitsz)
+		pgstrom_shmem_unreserve(unitsz - length);
+	pds->reserved = length;
+}
+
 void
 pgstrom_perfmon_add(pgstrom_perfmon *pfm_sum, pgstrom_perfmon *pfm_item)
 {
@@ -447,13 +527,22 @@ pgstrom_perfmon_add(pgstrom_perfmon *pfm_sum, pgstrom_perfmon *pfm_item)
 	pfm_sum->num_samples++;
 	pfm_sum->time_inner_load	+= pfm_item->time_inner_load;
 	pfm_sum->time_outer_load	+= pfm_item->time_outer_load;
+	pfm_sum->time_io_wait		+= pfm_item->time_io_wait;
 	pfm_sum->time_materialize	+= pfm_item->time_materialize;
 	pfm_sum->time_in_sendq		+= pfm_item->time_in_sendq;
 	pfm_sum->time_in_recvq		+= pfm_item->time_in_recvq;
 	pfm_sum->time_kern_build = Max(pfm_sum->time_kern_build,
 								   pfm_item->time_kern_build);
+	pfm_sum->num_recv_spin_hit	+= pfm_item->num_recv_spin_hit;
+	pfm_sum->num_recv_spin_miss	+= pfm_item->num_recv_spin_miss;
+	pfm_sum->num_recv_block		+= pfm_item->num_recv_block;
+	pfm_sum->time_recv_spin		+= pfm_item->time_recv_spin;
+	pfm_sum->num_bufpool_hit	+= pfm_item->num_bufpool_hit;
+	pfm_sum->num_bufpool_miss	+= pfm_item->num_bufpool_miss;
 	pfm_sum->num_dma_send		+= pfm_item->num_dma_send;
 	pfm_sum->num_dma_recv		+= pfm_item->num_dma_recv;
+	pfm_sum->num_dma_saved		+= pfm_item->num_dma_saved;
+	pfm_sum->bytes_dma_staged	+= pfm_item->bytes_dma_staged;
 	pfm_sum->bytes_dma_send		+= pfm_item->bytes_dma_send;
 	pfm_sum->bytes_dma_recv		+= pfm_item->bytes_dma_recv;
 	pfm_sum->time_dma_send		+= pfm_item->time_dma_send;
@@ -530,6 +619,13 @@ pgstrom_perfmon_explain(pgstrom_perfmon *pfm, ExplainState *es)
 		ExplainPropertyText("total time to load", buf, es);
 	}
 
+	if (pfm->time_io_wait > 0)
+	{
+		snprintf(buf, sizeof(buf), "%s",
+				 usecond_unitary_format((double)pfm->time_io_wait));
+		ExplainPropertyText("total time for I/O wait", buf, es);
+	}
+
 	if (pfm->time_materialize > 0)
 	{
 		snprintf(buf, sizeof(buf), "%s",
@@ -551,6 +647,25 @@ pgstrom_perfmon_explain(pgstrom_perfmon *pfm, ExplainState *es)
 		ExplainPropertyText("average time in recv-mq", buf, es);
 	}
 
+	if (pfm->num_recv_spin_hit + pfm->num_recv_spin_miss > 0)
+	{
+		cl_uint	num_spins = pfm->num_recv_spin_hit + pfm->num_recv_spin_miss;
+
+		snprintf(buf, sizeof(buf),
+				 "spin-then-block, hit: %.1f%% (%u of %u), "
+				 "spin: %s, block: %u",
+				 100.0 * (double)pfm->num_recv_spin_hit / (double)num_spins,
+				 pfm->num_recv_spin_hit, num_spins,
+				 usecond_unitary_format((double)pfm->time_recv_spin),
+				 pfm->num_recv_spin_miss + pfm->num_recv_block);
+		ExplainPropertyText("recv-mq wait", buf, es);
+	}
+	else if (pfm->num_recv_block > 0)
+	{
+		snprintf(buf, sizeof(buf), "block, count: %u", pfm->num_recv_block);
+		ExplainPropertyText("recv-mq wait", buf, es);
+	}
+
 	if (pfm->time_kern_build > 0)
 	{
 		snprintf(buf, sizeof(buf), "%s",
@@ -558,6 +673,25 @@ pgstrom_perfmon_explain(pgstrom_perfmon *pfm, ExplainState *es)
 		ExplainPropertyText("max time to build kernel", buf, es);
 	}
 
+	if (pfm->time_kern_prebuild > 0)
+	{
+		snprintf(buf, sizeof(buf), "%s",
+				 usecond_unitary_format((double)pfm->time_kern_prebuild));
+		ExplainPropertyText("kernel build hidden by prebuild", buf, es);
+	}
+
+	if (pfm->num_bufpool_hit + pfm->num_bufpool_miss > 0)
+	{
+		cl_uint	num_bufs = pfm->num_bufpool_hit + pfm->num_bufpool_miss;
+
+		snprintf(buf, sizeof(buf),
+				 "hit: %.1f%% (%u of %u), miss: %u",
+				 100.0 * (double)pfm->num_bufpool_hit / (double)num_bufs,
+				 pfm->num_bufpool_hit, num_bufs,
+				 pfm->num_bufpool_miss);
+		ExplainPropertyText("device buffer pool", buf, es);
+	}
+
 	if (pfm->num_dma_send > 0)
 	{
 		double	band = (((double)pfm->bytes_dma_send * 1000000.0)
@@ -568,7 +702,16 @@ pgstrom_perfmon_explain(pgstrom_perfmon *pfm, ExplainState *es)
 				 bytesz_unitary_format((double)pfm->bytes_dma_send),
 				 usecond_unitary_format((double)pfm->time_dma_send),
 				 pfm->num_dma_send);
+		if (pfm->num_dma_saved > 0)
+			snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
+					 " (%u saved by coalescing)", pfm->num_dma_saved);
 		ExplainPropertyText("DMA send", buf, es);
+
+		if (pfm->bytes_dma_staged > 0)
+			ExplainPropertyText("DMA staging",
+								bytesz_unitary_format((double)
+													  pfm->bytes_dma_staged),
+								es);
 	}
 
 	if (pfm->num_dma_recv > 0)
@@ -19,18 +19,80 @@
 #include "catalog/pg_type.h"
 #include "funcapi.h"
 #include "miscadmin.h"
+#include "storage/barrier.h"
 #include "storage/ipc.h"
 #include "storage/shmem.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
+#include <float.h>
 #include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <unistd.h>
 #include "pg_strom.h"
 
 static pthread_mutexattr_t	mutex_attr;
 static pthread_rwlockattr_t	rwlock_attr;
 static pthread_condattr_t	cond_attr;
 static int		pgstrom_mqueue_timeout;
+static int		pgstrom_mqueue_ring_size;
+static int		pgstrom_mqueue_priority;
+static int		pgstrom_mqueue_spin_limit;
+
+/*
+ * mqueue_ring
+ *
+ * A bounded lock-free ring buffer that carries requests towards the
+ * OpenCL server; multiple backends (and server threads) enqueue items
+ * and multiple server threads dequeue them concurrently, without any
+ * shared lock. Each cell has its own sequence number that tells whether
+ * it is ready to be written or to be read at the current lap.
+ * Consumers sleep on deq_futex only when the ring is empty, and producers
+ * wake them up only when someone is actually sleeping.
+ *
+ * Messages towards the server are not put on the ring directly. Each
+ * message is chained to the send queue of its response queue, then the
+ * response queue itself is put on the ring as a scheduling token, up to
+ * its weight (pg_strom.mqueue_priority) at most. A server thread that
+ * picked up a token fetches a message from the send queue, then puts
+ * the token back to the tail of the ring if the send queue still has
+ * messages. It performs round-robin across the response queues, so
+ * a query that enqueued many chunks never starves short queries.
+ * In case when the ring is full, tokens are chained to the qhead of
+ * the server mqueue, under its mutex, as a fallback.
+ *
+ * Once OpenCL server set up the devices, each device has its own ring
+ * and a set of server threads. A response queue is bound to a device
+ * when it gets active (no pending messages), according to the number of
+ * pending messages of the devices and NUMA node of the message, and its
+ * tokens are put on the ring of the device. Server threads fetch tokens
+ * from the ring of its own device first, then steal tokens from the other
+ * devices if its own device has nothing to do. All the rings share the
+ * futex of the base ring to sleep on.
+ */
+#define MQUEUE_CACHELINE_SIZE	64
+
+typedef struct
+{
+	volatile cl_ulong	sequence;
+	void			   *item;
+} mqueue_ring_cell;
+
+typedef struct
+{
+	volatile cl_ulong	enqueue_pos;
+	char				__pad1[MQUEUE_CACHELINE_SIZE - sizeof(cl_ulong)];
+	volatile cl_ulong	dequeue_pos;
+	char				__pad2[MQUEUE_CACHELINE_SIZE - sizeof(cl_ulong)];
+	volatile int		deq_futex;		/* bumped to wake up consumers */
+	volatile int		deq_sleepers;	/* number of sleeping consumers */
+	volatile int		num_producers;	/* number of in-progress enqueue */
+	volatile uint32		num_overflow;	/* number of tokens in qhead */
+	cl_ulong			mask;			/* number of cells - 1 */
+	mqueue_ring_cell	cells[FLEXIBLE_ARRAY_MEMBER];
+} mqueue_ring;
 
 /* variables related to shared memory segment */
 static shmem_startup_hook_type shmem_startup_hook_next;
@@ -41,13 +103,184 @@ static struct {
 	uint32			num_free;
 	uint32			num_active;
 	pgstrom_queue	serv_mqueue;	/* queue to OpenCL server */
+	mqueue_ring	   *serv_ring;		/* lock-free ring of serv_mqueue */
+	/* per-device rings; set up by OpenCL server */
+	volatile int	num_dev_rings;
+	mqueue_ring	   *dev_rings[MAX_NUM_DEVICES];
+	volatile int	dev_depth[MAX_NUM_DEVICES];	/* num of pending messages */
+	volatile uint64	dev_steals[MAX_NUM_DEVICES];/* num of stolen tokens */
 } *mqueue_shm_values;
 
+/* penalty of the device on remote NUMA node, in number of messages */
+#define MQUEUE_NUMA_REMOTE_PENALTY	4
+/* same, but ratio to the expected time to drain the backlog */
+#define MQUEUE_NUMA_REMOTE_RATIO	1.25
+
+/* device to be processed by the current server thread, if any */
+static __thread int		serv_thread_dindex = -1;
+
+#define POOLING_INTERVAL	200000000	/* 200msec */
+
+/*
+ * Replies by server threads are deferred to be sent in a batch, until
+ * the server thread runs out of messages to be processed.
+ */
+static __thread pgstrom_message *reply_pending[MQUEUE_BATCH_SIZE];
+static __thread int		reply_npending = 0;
+static __thread int		reply_nskips = 0;
+static __thread bool	reply_deferrable = false;
+/* flushes the deferred replies on any exit path of the server threads */
+static pthread_key_t	reply_pending_key;
+static pthread_once_t	reply_pending_once = PTHREAD_ONCE_INIT;
+static bool				reply_pending_key_valid = false;
+
 /* number of message queues per block */
 #define MQUEUES_PER_BLOCK								\
 	((SHMEM_BLOCKSZ - SHMEM_ALLOC_COST					\
 	  - sizeof(dlist_node))	/ sizeof(pgstrom_queue))
 
+/*
+ * mqueue_ring_init
+ *
+ * It initializes a ring buffer with the supplied number of cells; that
+ * has to be power of 2.
+ */
+static void
+mqueue_ring_init(mqueue_ring *ring, cl_ulong nitems)
+{
+	cl_ulong	i;
+
+	Assert((nitems & (nitems - 1)) == 0);
+	memset(ring, 0, offsetof(mqueue_ring, cells[0]));
+	ring->mask = nitems - 1;
+	for (i=0; i < nitems; i++)
+	{
+		ring->cells[i].sequence = i;
+		ring->cells[i].item = NULL;
+	}
+}
+
+/*
+ * mqueue_ring_push
+ *
+ * It puts an item on the ring buffer, or returns false if the ring is full.
+ */
+static bool
+mqueue_ring_push(mqueue_ring *ring, void *item)
+{
+	mqueue_ring_cell *cell;
+	cl_ulong	pos = ring->enqueue_pos;
+	long		diff;
+
+	for (;;)
+	{
+		cell = &ring->cells[pos & ring->mask];
+		diff = (long)(cell->sequence - pos);
+		if (diff == 0)
+		{
+			if (__sync_bool_compare_and_swap(&ring->enqueue_pos, pos, pos + 1))
+				break;
+			pos = ring->enqueue_pos;
+		}
+		else if (diff < 0)
+			return false;	/* ring is full */
+		else
+			pos = ring->enqueue_pos;
+	}
+	cell->item = item;
+	pg_write_barrier();
+	cell->sequence = pos + 1;
+
+	return true;
+}
+
+/*
+ * mqueue_ring_pop
+ *
+ * It fetches an item from the ring buffer, or returns NULL if empty.
+ */
+static void *
+mqueue_ring_pop(mqueue_ring *ring)
+{
+	mqueue_ring_cell *cell;
+	cl_ulong	pos = ring->dequeue_pos;
+	long		diff;
+	void	   *item;
+
+	for (;;)
+	{
+		cell = &ring->cells[pos & ring->mask];
+		diff = (long)(cell->sequence - (pos + 1));
+		if (diff == 0)
+		{
+			if (__sync_bool_compare_and_swap(&ring->dequeue_pos, pos, pos + 1))
+				break;
+			pos = ring->dequeue_pos;
+		}
+		else if (diff < 0)
+			return NULL;	/* ring is empty */
+		else
+			pos = ring->dequeue_pos;
+	}
+	item = cell->item;
+	pg_memory_barrier();
+	cell->sequence = pos + ring->mask + 1;
+
+	return item;
+}
+
+/*
+ * mqueue_ring_wakeup
+ *
+ * It wakes up consumers sleeping on the ring buffer. Caller has to push
+ * an item prior to this call; we touch the futex word only when someone
+ * is sleeping, to avoid cache-line bouncing on the hot path.
+ */
+static void
+mqueue_ring_wakeup(mqueue_ring *ring, int nwakeup)
+{
+	pg_memory_barrier();
+	if (ring->deq_sleepers > 0 || nwakeup == INT_MAX)
+	{
+		__sync_fetch_and_add(&ring->deq_futex, 1);
+		syscall(SYS_futex, &ring->deq_futex, FUTEX_WAKE,
+				nwakeup, NULL, NULL, 0);
+	}
+}
+
+/*
+ * mqueue_ring_prepare_sleep / mqueue_ring_sleep / mqueue_ring_cancel_sleep
+ *
+ * Consumer has to call mqueue_ring_prepare_sleep() first, then check the
+ * ring buffer again prior to mqueue_ring_sleep(), to avoid lost wakeup;
+ * producer's wakeup after the re-check changes the futex word, so
+ * FUTEX_WAIT returns immediately.
+ */
+static int
+mqueue_ring_prepare_sleep(mqueue_ring *ring)
+{
+	__sync_fetch_and_add(&ring->deq_sleepers, 1);
+	return ring->deq_futex;
+}
+
+static void
+mqueue_ring_cancel_sleep(mqueue_ring *ring)
+{
+	__sync_fetch_and_sub(&ring->deq_sleepers, 1);
+}
+
+static void
+mqueue_ring_sleep(mqueue_ring *ring, int futex_val, long timeout_ns)
+{
+	struct timespec	timeout;
+
+	timeout.tv_sec = timeout_ns / 1000000000L;
+	timeout.tv_nsec = timeout_ns % 1000000000L;
+	syscall(SYS_futex, &ring->deq_futex, FUTEX_WAIT,
+			futex_val, &timeout, NULL, 0);
+	__sync_fetch_and_sub(&ring->deq_sleepers, 1);
+}
+
 /*
  * pgstrom_create_queue
  *
@@ -127,149 +360,548 @@ pgstrom_create_queue(void)
 	mqueue->refcnt = 1;
 	dlist_init(&mqueue->qhead);
 	mqueue->closed = false;
+	memset(&mqueue->sched_chain, 0, sizeof(dlist_node));
+	dlist_init(&mqueue->sendq);
+	mqueue->send_depth = 0;
+	mqueue->send_tokens = 0;
+	mqueue->send_overflow = 0;
+	mqueue->send_dindex = -1;
+	mqueue->send_weight = pgstrom_mqueue_priority;
+	mqueue->send_nitems = 0;
+	mqueue->send_wait = 0;
+	/* optimistic initial value, to try spinning at the beginning */
+	mqueue->recv_wait_avg = pgstrom_mqueue_spin_limit / 2;
 	SpinLockRelease(&mqueue_shm_values->lock);
 
 	return mqueue;
 }
 
 /*
- * pgstrom_enqueue_message
+ * mqueue_sched_select_device
  *
- * It enqueues a message towardss OpenCL intermediation server.
+ * It chooses a device to process the messages of an idle response queue.
+ * We prefer the device that is expected to drain its backlog earliest,
+ * according to the throughput being observed by the OpenCL server. Until
+ * all the devices have its estimation, we prefer the device that has the
+ * least pending messages instead. In both cases, remote devices from the
+ * NUMA node where the message lives get a penalty.
+ * It returns -1 if OpenCL server does not set up the devices yet.
  */
-bool
-pgstrom_enqueue_message(pgstrom_message *message)
+static int
+mqueue_sched_select_device(pgstrom_message *message)
+{
+	static int	hint = 0;
+	int			num_devs = mqueue_shm_values->num_dev_rings;
+	int			numa_node;
+	int			i, k, dindex = -1;
+	double		backlog[MAX_NUM_DEVICES];
+	bool		use_backlog = true;
+	double		cost, best = DBL_MAX;
+
+	if (num_devs == 0)
+		return -1;
+	pg_read_barrier();
+
+	for (i=0; i < num_devs; i++)
+	{
+		backlog[i] = pgstrom_opencl_device_backlog(i, mqueue_shm_values->
+												   dev_depth[i]);
+		if (backlog[i] < 0.0)
+			use_backlog = false;
+	}
+
+	numa_node = pgstrom_numa_node_of_address(message);
+	/* rotate the starting point to distribute the tie */
+	hint++;
+	for (k=0; k < num_devs; k++)
+	{
+		i = (hint + k) % num_devs;
+		if (use_backlog)
+		{
+			cost = backlog[i];
+			if (numa_node >= 0 &&
+				pgstrom_get_device_info(i)->dev_numa_node != numa_node)
+				cost *= MQUEUE_NUMA_REMOTE_RATIO;
+		}
+		else
+		{
+			cost = mqueue_shm_values->dev_depth[i];
+			if (numa_node >= 0 &&
+				pgstrom_get_device_info(i)->dev_numa_node != numa_node)
+				cost += MQUEUE_NUMA_REMOTE_PENALTY;
+		}
+		if (cost < best)
+		{
+			best = cost;
+			dindex = i;
+		}
+	}
+	return dindex;
+}
+
+/*
+ * mqueue_sched_push_token
+ *
+ * It puts a scheduling token of the supplied response queue on the ring
+ * buffer of the device being bound, or the fallback list if the ring is
+ * full.
+ * Caller must hold respq->lock, and increment send_tokens.
+ */
+static void
+mqueue_sched_push_token(pgstrom_queue *respq)
 {
 	pgstrom_queue  *mqueue = &mqueue_shm_values->serv_mqueue;
-	int		rc;
+	mqueue_ring	   *ring = mqueue_shm_values->serv_ring;
 
-	pthread_mutex_lock(&mqueue->lock);
-	if (mqueue->closed)
+	if (respq->send_dindex >= 0)
+		ring = mqueue_shm_values->dev_rings[respq->send_dindex];
+	if (!mqueue_ring_push(ring, respq))
 	{
+		/*
+		 * The fallback list is shared by all the rings, so overflow is
+		 * always counted on the server ring; dequeue side checks it.
+		 */
+		pthread_mutex_lock(&mqueue->lock);
+		if (respq->send_overflow++ == 0)
+			dlist_push_tail(&mqueue->qhead, &respq->sched_chain);
+		mqueue_shm_values->serv_ring->num_overflow++;
 		pthread_mutex_unlock(&mqueue->lock);
-		return false;
 	}
+}
 
-	/* performance monitoring */
-	if (message->pfm.enabled)
-		gettimeofday(&message->pfm.tv, NULL);
+/*
+ * pgstrom_enqueue_messages
+ *
+ * It enqueues a set of messages towards OpenCL intermediation server at
+ * once, then wakes up the server threads being sleeping only once.
+ * If server queue is already closed, none of the messages are enqueued.
+ */
+bool
+pgstrom_enqueue_messages(pgstrom_message **msgs, int nmsgs)
+{
+	pgstrom_queue  *mqueue = &mqueue_shm_values->serv_mqueue;
+	mqueue_ring	   *ring = mqueue_shm_values->serv_ring;
+	pgstrom_queue  *respq = NULL;
+	struct timeval	tv;
+	int		i, nwakeup = 0;
 
 	/*
-	 * We assume the message being enqueued in the server message-queue is
-	 * already acquired by the server process, not only backend process.
-	 * So, we ensure the messages shall not be released during server jobs.
-	 * Increment of reference counter prevent unexpected resource free by
-	 * elog(ERROR, ...).
-	 * 
-	 * Please note that the server process may enqueue messages again.
-	 * In this case, we don't need to increment reference counter of the
-	 * message again (because server process already acquires this message!).
-	 * So, it shall be increment only when backend process tries to enqueue
-	 * a message.
+	 * num_producers informs pgstrom_close_server_queue() that someone is
+	 * in progress to enqueue, so it never drains the queue until all the
+	 * concurrent producers that didn't see the closed flag finished.
 	 */
-	SpinLockAcquire(&message->lock);
-	Assert(message->refcnt > 0);
-	if (!pgstrom_i_am_clserv)
-		message->refcnt++;
-	dlist_push_tail(&mqueue->qhead, &message->chain);
-	SpinLockRelease(&message->lock);
+	__sync_fetch_and_add(&ring->num_producers, 1);
+	if (mqueue->closed)
+	{
+		__sync_fetch_and_sub(&ring->num_producers, 1);
+		return false;
+	}
 
-	/* notification to waiter */
-	rc = pthread_cond_signal(&mqueue->cond);
-	Assert(rc == 0);
-	pthread_mutex_unlock(&mqueue->lock);
+	gettimeofday(&tv, NULL);
+	for (i=0; i < nmsgs; i++)
+	{
+		pgstrom_message *message = msgs[i];
+
+		/* performance monitoring */
+		if (message->pfm.enabled)
+			message->pfm.tv = tv;
+		message->tv_enqueue = tv;
+
+		/*
+		 * We assume the message being enqueued in the server message-queue
+		 * is already acquired by the server process, not only backend
+		 * process. So, we ensure the messages shall not be released during
+		 * server jobs. Increment of reference counter prevent unexpected
+		 * resource free by elog(ERROR, ...).
+		 *
+		 * Please note that the server process may enqueue messages again.
+		 * In this case, we don't need to increment reference counter of
+		 * the message again (because server process already acquires this
+		 * message!). So, it shall be increment only when backend process
+		 * tries to enqueue a message.
+		 */
+		SpinLockAcquire(&message->lock);
+		Assert(message->refcnt > 0);
+		if (!pgstrom_i_am_clserv)
+			message->refcnt++;
+		SpinLockRelease(&message->lock);
+
+		/*
+		 * Chain the message on the send queue of its response queue.
+		 * Consecutive messages usually belong to the same response queue,
+		 * so we keep the lock until the response queue changes.
+		 */
+		Assert(message->respq != NULL);
+		if (message->respq != respq)
+		{
+			if (respq)
+				pthread_mutex_unlock(&respq->lock);
+			respq = message->respq;
+			pthread_mutex_lock(&respq->lock);
+		}
+		/* an idle response queue can be bound to another device */
+		if (respq->send_depth == 0)
+			respq->send_dindex = mqueue_sched_select_device(message);
+		if (respq->send_dindex >= 0)
+			__sync_fetch_and_add(&mqueue_shm_values->
+								 dev_depth[respq->send_dindex], 1);
+		dlist_push_tail(&respq->sendq, &message->chain);
+		respq->send_depth++;
+		if (respq->send_tokens < Min(respq->send_weight, respq->send_depth))
+		{
+			respq->send_tokens++;
+			mqueue_sched_push_token(respq);
+			nwakeup++;
+		}
+	}
+	if (respq)
+		pthread_mutex_unlock(&respq->lock);
+	__sync_fetch_and_sub(&ring->num_producers, 1);
+
+	/* notification to waiters */
+	if (nwakeup > 0)
+		mqueue_ring_wakeup(ring, nwakeup);
 
 	return true;
 }
 
 /*
- * pgstrom_reply_message
+ * pgstrom_enqueue_message
  *
- * It allows OpenCL intermediation server to enqueue a response message
- * towards the backend process, shouldn't be called by backend itself.
+ * It enqueues a message towardss OpenCL intermediation server.
+ */
+bool
+pgstrom_enqueue_message(pgstrom_message *message)
+{
+	return pgstrom_enqueue_messages(&message, 1);
+}
+
+/*
+ * pgstrom_flush_messages
+ *
+ * A utility routine for backends that accumulate messages to be sent at
+ * once. It enqueues the pending messages, and reset *p_nmsgs, or raises
+ * an error after release of the messages if server queue is not available.
  */
 void
-pgstrom_reply_message(pgstrom_message *message)
+pgstrom_flush_messages(pgstrom_message **msgs, int *p_nmsgs)
 {
-	pgstrom_queue  *respq = message->respq;
-	int		rc;
+	int		i, nmsgs = *p_nmsgs;
 
-	Assert(pgstrom_i_am_clserv);
-	Assert(respq != &mqueue_shm_values->serv_mqueue);
-	pthread_mutex_lock(&respq->lock);
-	if (respq->closed)
+	if (nmsgs == 0)
+		return;
+	*p_nmsgs = 0;
+	if (!pgstrom_enqueue_messages(msgs, nmsgs))
 	{
-		pthread_mutex_unlock(&respq->lock);
+		const char *label = StromTagGetLabel(&msgs[0]->sobj);
 
-		/*
-		 * In case when response queue is closed, it means nobody waits for
-		 * response message, and reference counter of message might be
-		 * already decremented by error handler. If current context is the
-		 * last one who put this message, we have to release messages.
-		 */
-		pgstrom_put_message(message);
+		for (i=0; i < nmsgs; i++)
+			pgstrom_put_message(msgs[i]);
+		elog(ERROR, "failed to enqueue %s message", label);
 	}
-	else
-	{
-		/* performance monitoring */
-		if (message->pfm.enabled)
-			gettimeofday(&message->pfm.tv, NULL);
+}
 
-		SpinLockAcquire(&message->lock);
-		if (message->refcnt > 1)
+/*
+ * __pgstrom_reply_messages
+ *
+ * It enqueues a set of response messages towards the backend processes.
+ * Messages are grouped by the response queue, so we acquire the lock and
+ * signal the waiter only once per response queue.
+ * Note that msgs[] is consumed by this routine.
+ */
+static void
+__pgstrom_reply_messages(pgstrom_message **msgs, int nmsgs)
+{
+	pgstrom_queue  *respq;
+	dlist_head		put_list;
+	dlist_head		release_list;
+	dlist_mutable_iter iter;
+	bool	do_signal;
+	int		i, j, rc;
+
+	for (i=0; i < nmsgs; i++)
+	{
+		if (!msgs[i])
+			continue;	/* already replied */
+		respq = msgs[i]->respq;
+		Assert(respq != &mqueue_shm_values->serv_mqueue);
+		dlist_init(&put_list);
+		dlist_init(&release_list);
+		do_signal = false;
+
+		pthread_mutex_lock(&respq->lock);
+		for (j=i; j < nmsgs; j++)
 		{
-			message->refcnt--;	/* we never call on_release handler here */
-			dlist_push_tail(&respq->qhead, &message->chain);
-			SpinLockRelease(&message->lock);
+			pgstrom_message *message = msgs[j];
+
+			if (!message || message->respq != respq)
+				continue;
+			msgs[j] = NULL;
+
+			/*
+			 * In case when response queue is closed, it means nobody waits
+			 * for response message, and reference counter of message might
+			 * be already decremented by error handler. If current context
+			 * is the last one who put this message, we have to release
+			 * messages.
+			 */
+			if (respq->closed)
+			{
+				dlist_push_tail(&put_list, &message->chain);
+				continue;
+			}
 
-			/* notification towards the waiter process */
+			SpinLockAcquire(&message->lock);
+			if (message->refcnt > 1)
+			{
+				message->refcnt--;	/* we never call on_release handler here */
+				dlist_push_tail(&respq->qhead, &message->chain);
+				do_signal = true;
+			}
+			else
+			{
+				message->refcnt--;
+				Assert(message->refcnt == 0);
+				dlist_push_tail(&release_list, &message->chain);
+			}
+			SpinLockRelease(&message->lock);
+		}
+		/* notification towards the waiter process */
+		if (do_signal)
+		{
 			rc = pthread_cond_signal(&respq->cond);
 			Assert(rc == 0);
-			pthread_mutex_unlock(&respq->lock);
 		}
-		else
+		pthread_mutex_unlock(&respq->lock);
+
+		/*
+		 * Usually, release handler of message object will detach
+		 * a response message queue also. It needs to acquire a lock
+		 * on the message queue to touch reference counter, so we
+		 * have to release the lock prior to invocation of release
+		 * handler.
+		 */
+		dlist_foreach_modify(iter, &put_list)
 		{
-			message->refcnt--;
-			Assert(message->refcnt == 0);
-			SpinLockRelease(&message->lock);
+			pgstrom_message *message
+				= dlist_container(pgstrom_message, chain, iter.cur);
 
-			pthread_mutex_unlock(&respq->lock);
-			/*
-			 * Usually, release handler of message object will detach
-			 * a response message queue also. It needs to acquire a lock
-			 * on the message queue to touch reference counter, so we
-			 * have to release the lock prior to invocation of release
-			 * handler.
-			 */
+			dlist_delete(&message->chain);
+			pgstrom_put_message(message);
+		}
+		dlist_foreach_modify(iter, &release_list)
+		{
+			pgstrom_message *message
+				= dlist_container(pgstrom_message, chain, iter.cur);
+
+			dlist_delete(&message->chain);
 			Assert(message->cb_release != NULL);
 			(*message->cb_release)(message);
 		}
 	}
 }
 
+/*
+ * pgstrom_reply_messages
+ *
+ * It allows OpenCL intermediation server to enqueue a set of response
+ * messages towards the backend processes at once.
+ */
+void
+pgstrom_reply_messages(pgstrom_message **msgs, int nmsgs)
+{
+	struct timeval	tv;
+	int		i;
+
+	Assert(pgstrom_i_am_clserv);
+	tv.tv_sec = 0;
+	for (i=0; i < nmsgs; i++)
+	{
+		/* release the workload being accounted on the device */
+		pgstrom_opencl_device_complete(msgs[i]);
+		/* performance monitoring */
+		if (msgs[i]->pfm.enabled)
+		{
+			if (tv.tv_sec == 0)
+				gettimeofday(&tv, NULL);
+			msgs[i]->pfm.tv = tv;
+		}
+	}
+	__pgstrom_reply_messages(msgs, nmsgs);
+}
+
+/*
+ * pgstrom_reply_message
+ *
+ * It allows OpenCL intermediation server to enqueue a response message
+ * towards the backend process, shouldn't be called by backend itself.
+ * If caller is a server thread that processes messages in the server
+ * queue, reply is deferred until it runs out of messages to be processed,
+ * or the pending replies reached MQUEUE_BATCH_SIZE.
+ */
+void
+pgstrom_reply_message(pgstrom_message *message)
+{
+	Assert(pgstrom_i_am_clserv);
+	Assert(message->respq != &mqueue_shm_values->serv_mqueue);
+
+	/* release the workload being accounted on the device */
+	pgstrom_opencl_device_complete(message);
+
+	/* performance monitoring */
+	if (message->pfm.enabled)
+		gettimeofday(&message->pfm.tv, NULL);
+
+	if (!reply_deferrable)
+		__pgstrom_reply_messages(&message, 1);
+	else
+	{
+		reply_pending[reply_npending++] = message;
+		if (reply_npending == MQUEUE_BATCH_SIZE)
+			pgstrom_flush_reply_messages();
+	}
+}
+
+/*
+ * pgstrom_flush_reply_messages
+ *
+ * It sends the response messages being deferred by the current thread.
+ */
+void
+pgstrom_flush_reply_messages(void)
+{
+	int		nmsgs = reply_npending;
+
+	reply_nskips = 0;
+	if (nmsgs > 0)
+	{
+		reply_npending = 0;
+		__pgstrom_reply_messages(reply_pending, nmsgs);
+	}
+}
+
+/*
+ * reply_pending_thread_exit
+ *
+ * Destructor of reply_pending_key; it runs on termination of every server
+ * thread that has ever deferred replies, regardless of its exit path, so
+ * no replies are left in the per-thread array once the thread has gone.
+ */
+static void
+reply_pending_thread_exit(void *arg)
+{
+	reply_deferrable = false;
+	pgstrom_flush_reply_messages();
+}
+
+static void
+reply_pending_key_init(void)
+{
+	if (pthread_key_create(&reply_pending_key,
+						   reply_pending_thread_exit) != 0)
+		clserv_log("failed on pthread_key_create, replies are not deferred");
+	else
+		reply_pending_key_valid = true;
+}
+
 /*
  * pgstrom_sync_dequeue_message
  *
- * It fetches a message from the message queue. If empty, it waits for new
- * messages will come, or returns NULL if it exceeds timeout or it got
- * a signal being pending.
+ * It fetches a message from the message queue. If empty, it spins on the
+ * head of the queue for a while, then waits for new messages will come,
+ * or returns NULL if it exceeds timeout or it got a signal being pending.
+ * Spin limit is learned from the recent waiting time on this queue; we
+ * spin twice of the average waiting time (up to pg_strom.mqueue_spin_limit)
+ * because response of short kernels comes earlier than the latency of
+ * sleep and wakeup. Elsewhere, we block without spinning.
+ * How the message was fetched is informed via *p_wait_mode, and time
+ * consumed by spinning is informed via *p_spin_time.
  */
+#define MQUEUE_WAIT_NONE	0	/* message was already in the queue */
+#define MQUEUE_WAIT_SPIN	1	/* message was fetched during spinning */
+#define MQUEUE_WAIT_BLOCK	2	/* message was fetched after sleep */
+
 static pgstrom_message *
-pgstrom_sync_dequeue_message(pgstrom_queue *mqueue)
+pgstrom_sync_dequeue_message(pgstrom_queue *mqueue,
+							 int *p_wait_mode, cl_ulong *p_spin_time)
 {
-#define POOLING_INTERVAL	200000000	/* 200msec */
 	pgstrom_message *result = NULL;
 	struct timeval	basetv;
+	struct timeval	tv;
 	struct timespec	timeout;
 	ulong	timeleft = ((ulong)pgstrom_mqueue_timeout) * 1000000UL;
+	long	spin_limit;
+	long	wait_time;
+	int		count;
 	int		rc;
 
+	*p_wait_mode = MQUEUE_WAIT_NONE;
+	*p_spin_time = 0;
+
 	rc = gettimeofday(&basetv, NULL);
 	Assert(rc == 0);
 	timeout.tv_sec = basetv.tv_sec;
 	timeout.tv_nsec = basetv.tv_usec * 1000UL;
 
 	pthread_mutex_lock(&mqueue->lock);
+	if (!dlist_is_empty(&mqueue->qhead))
+	{
+		dlist_node *dnode = dlist_pop_head_node(&mqueue->qhead);
+
+		pthread_mutex_unlock(&mqueue->lock);
+		return dlist_container(pgstrom_message, chain, dnode);
+	}
+
+	/*
+	 * Spin on the head of the queue without lock, if recent waiting time
+	 * is short enough.
+	 */
+	if (pgstrom_mqueue_spin_limit > 0 &&
+		mqueue->recv_wait_avg <= pgstrom_mqueue_spin_limit)
+	{
+		spin_limit = Min(2 * mqueue->recv_wait_avg + 1,
+						 pgstrom_mqueue_spin_limit);
+		pthread_mutex_unlock(&mqueue->lock);
+		for (count=1; ; count++)
+		{
+			pg_read_barrier();
+			if (!dlist_is_empty(&mqueue->qhead))
+			{
+				pthread_mutex_lock(&mqueue->lock);
+				if (!dlist_is_empty(&mqueue->qhead))
+				{
+					dlist_node *dnode
+						= dlist_pop_head_node(&mqueue->qhead);
+
+					result = dlist_container(pgstrom_message, chain, dnode);
+				}
+				pthread_mutex_unlock(&mqueue->lock);
+				if (result)
+					break;
+			}
+			SPIN_DELAY();
+			/* check elapsed time for each 64 iterations */
+			if ((count & 63) == 0)
+			{
+				gettimeofday(&tv, NULL);
+				if (timeval_diff(&basetv, &tv) >= spin_limit)
+					break;
+			}
+		}
+		gettimeofday(&tv, NULL);
+		wait_time = timeval_diff(&basetv, &tv);
+		*p_spin_time = wait_time;
+		if (result)
+		{
+			*p_wait_mode = MQUEUE_WAIT_SPIN;
+			mqueue->recv_wait_avg = (7 * mqueue->recv_wait_avg
+									 + wait_time) / 8;
+			return result;
+		}
+		pthread_mutex_lock(&mqueue->lock);
+	}
+	*p_wait_mode = MQUEUE_WAIT_BLOCK;
+
 	for (;;)
 	{
 		/* dequeue a message from the message queue */
@@ -320,6 +952,149 @@ pgstrom_sync_dequeue_message(pgstrom_queue *mqueue)
 				timeleft = 0;
 		}
 	}
+	/* learn the waiting time, to determine whether we spin next time */
+	if (result)
+	{
+		gettimeofday(&tv, NULL);
+		wait_time = timeval_diff(&basetv, &tv);
+		mqueue->recv_wait_avg = (7 * mqueue->recv_wait_avg + wait_time) / 8;
+	}
+	return result;
+}
+
+/*
+ * pgstrom_try_dequeue_server_message
+ *
+ * It picks up a scheduling token from the server ring buffer, or the
+ * fallback list if the ring buffer was overflowed, then fetches a message
+ * from the send queue of the response queue. It never blocks.
+ * Note that a response queue is never released while its token is on the
+ * server queue, because send_tokens is always less than or equal to the
+ * number of pending messages; each of them holds the response queue.
+ */
+static pgstrom_message *
+pgstrom_try_dequeue_server_message(void)
+{
+	pgstrom_queue  *mqueue = &mqueue_shm_values->serv_mqueue;
+	mqueue_ring	   *ring = mqueue_shm_values->serv_ring;
+	pgstrom_queue  *respq = NULL;
+	pgstrom_message *result;
+	dlist_node	   *dnode;
+	struct timeval	tv;
+	int				num_devs = mqueue_shm_values->num_dev_rings;
+	int				i, base;
+
+	/*
+	 * Fetch a token from the ring of the device of the current thread,
+	 * then steal one from the other devices if nothing to do.
+	 */
+	if (num_devs > 0)
+	{
+		pg_read_barrier();
+		base = Max(serv_thread_dindex, 0);
+		for (i=0; i < num_devs && !respq; i++)
+		{
+			int		dindex = (base + i) % num_devs;
+
+			respq = mqueue_ring_pop(mqueue_shm_values->dev_rings[dindex]);
+			if (respq && i > 0 && serv_thread_dindex >= 0)
+				__sync_fetch_and_add(&mqueue_shm_values->dev_steals[dindex],
+									 1);
+		}
+	}
+	/* tokens being enqueued prior to the device set up */
+	if (!respq)
+		respq = mqueue_ring_pop(ring);
+	if (!respq && ring->num_overflow > 0)
+	{
+		pthread_mutex_lock(&mqueue->lock);
+		if (!dlist_is_empty(&mqueue->qhead))
+		{
+			dnode = dlist_head_node(&mqueue->qhead);
+			respq = dlist_container(pgstrom_queue, sched_chain, dnode);
+			Assert(respq->send_overflow > 0);
+			dlist_delete(&respq->sched_chain);
+			if (--respq->send_overflow > 0)
+				dlist_push_tail(&mqueue->qhead, &respq->sched_chain);
+			ring->num_overflow--;
+		}
+		pthread_mutex_unlock(&mqueue->lock);
+	}
+	if (!respq)
+		return NULL;
+
+	pthread_mutex_lock(&respq->lock);
+	Assert(respq->send_tokens > 0 && !dlist_is_empty(&respq->sendq));
+	respq->send_tokens--;
+	dnode = dlist_pop_head_node(&respq->sendq);
+	result = dlist_container(pgstrom_message, chain, dnode);
+	respq->send_depth--;
+	if (respq->send_dindex >= 0)
+		__sync_fetch_and_sub(&mqueue_shm_values->
+							 dev_depth[respq->send_dindex], 1);
+	/* the current thread processes the message on its own device */
+	result->dindex = (num_devs > 0 ? serv_thread_dindex : -1);
+
+	gettimeofday(&tv, NULL);
+	respq->send_nitems++;
+	respq->send_wait += timeval_diff(&result->tv_enqueue, &tv);
+
+	/* put the token back to the tail, if send queue is not empty yet */
+	if (respq->send_tokens < Min(respq->send_weight, respq->send_depth))
+	{
+		respq->send_tokens++;
+		mqueue_sched_push_token(respq);
+	}
+	pthread_mutex_unlock(&respq->lock);
+
+	return result;
+}
+
+/*
+ * pgstrom_sync_dequeue_server_message
+ *
+ * It fetches a message from the server queue. If empty, it sleeps on the
+ * futex of the ring buffer until new messages come, or returns NULL if
+ * it exceeds timeout or server is going to exit.
+ */
+static pgstrom_message *
+pgstrom_sync_dequeue_server_message(void)
+{
+	mqueue_ring	   *ring = mqueue_shm_values->serv_ring;
+	pgstrom_message *result;
+	struct timeval	tv1, tv2;
+	long	timeout = ((long)pgstrom_mqueue_timeout) * 1000000L;
+	long	elapsed;
+	int		futex_val;
+
+	gettimeofday(&tv1, NULL);
+	for (;;)
+	{
+		result = pgstrom_try_dequeue_server_message();
+		if (result)
+			break;
+
+		/* no more messages to be processed, so send replies first */
+		pgstrom_flush_reply_messages();
+		if (timeout <= 0)
+			break;
+
+		futex_val = mqueue_ring_prepare_sleep(ring);
+		result = pgstrom_try_dequeue_server_message();
+		if (result)
+		{
+			mqueue_ring_cancel_sleep(ring);
+			break;
+		}
+		mqueue_ring_sleep(ring, futex_val, Min(timeout, POOLING_INTERVAL));
+
+		gettimeofday(&tv2, NULL);
+		elapsed = timeval_diff(&tv1, &tv2) * 1000L;
+		tv1 = tv2;
+		timeout -= elapsed;
+		if (pgstrom_clserv_exit_pending)
+			timeout = 0;
+	}
 	return result;
 }
 
@@ -333,13 +1108,25 @@ pgstrom_dequeue_message(pgstrom_queue *mqueue)
 {
 	pgstrom_message	   *msg;
 	struct timeval		tv;
+	int					wait_mode;
+	cl_ulong			spin_time;
 
 	Assert(!pgstrom_i_am_clserv);
-	msg = pgstrom_sync_dequeue_message(mqueue);
+	msg = pgstrom_sync_dequeue_message(mqueue, &wait_mode, &spin_time);
 	if (msg && msg->pfm.enabled)
 	{
 		gettimeofday(&tv, NULL);
 		msg->pfm.time_in_recvq += timeval_diff(&msg->pfm.tv, &tv);
+		if (wait_mode == MQUEUE_WAIT_SPIN)
+			msg->pfm.num_recv_spin_hit++;
+		else if (wait_mode == MQUEUE_WAIT_BLOCK)
+		{
+			if (spin_time > 0)
+				msg->pfm.num_recv_spin_miss++;
+			else
+				msg->pfm.num_recv_block++;
+		}
+		msg->pfm.time_recv_spin += spin_time;
 	}
 	return msg;
 }
@@ -356,7 +1143,18 @@ pgstrom_dequeue_server_message(void)
 	struct timeval		tv;
 
 	Assert(pgstrom_i_am_clserv);
-	msg = pgstrom_sync_dequeue_message(&mqueue_shm_values->serv_mqueue);
+	if (!reply_deferrable)
+	{
+		/* arm the destructor prior to the first deferred reply */
+		pthread_once(&reply_pending_once, reply_pending_key_init);
+		if (reply_pending_key_valid &&
+			pthread_setspecific(reply_pending_key, &reply_deferrable) == 0)
+			reply_deferrable = true;
+	}
+	msg = pgstrom_sync_dequeue_server_message();
+	/* don't keep replies too long even if server is busy */
+	if (reply_npending > 0 && ++reply_nskips >= MQUEUE_BATCH_SIZE)
+		pgstrom_flush_reply_messages();
 	if (msg && msg->pfm.enabled)
 	{
 		gettimeofday(&tv, NULL);
@@ -365,6 +1163,110 @@ pgstrom_dequeue_server_message(void)
 	return msg;
 }
 
+/*
+ * pgstrom_setup_mqueue_devices
+ *
+ * It allocates a ring buffer for each device. OpenCL server calls this
+ * routine once the devices are set up, prior to launch server threads.
+ * If OpenCL server was restarted, rings being allocated by the previous
+ * server are reinitialized, because tokens and counters on them are no
+ * longer valid.
+ * Backends may enqueue messages concurrently, so the response queues are
+ * unbound from the devices first, then tokens on the previous rings are
+ * moved to the server ring, prior to reinitialization. The new rings are
+ * published only after they get ready.
+ */
+void
+pgstrom_setup_mqueue_devices(int num_devices)
+{
+	Size	length = offsetof(mqueue_ring, cells[pgstrom_mqueue_ring_size]);
+	int		num_rings = mqueue_shm_values->num_dev_rings;
+	dlist_iter	iter;
+	pgstrom_queue *respq;
+	int		i;
+
+	Assert(pgstrom_i_am_clserv);
+	Assert(num_devices <= MAX_NUM_DEVICES);
+
+	/*
+	 * No response queue gets bound to a device any more, because
+	 * mqueue_sched_select_device() returns -1 during reinitialization.
+	 */
+	mqueue_shm_values->num_dev_rings = 0;
+	pg_memory_barrier();
+
+	/*
+	 * Unbind the response queues being bound to a device. Tokens are
+	 * pushed under the lock of response queue, so nobody pushes a token
+	 * onto the device rings once we released the lock.
+	 */
+	SpinLockAcquire(&mqueue_shm_values->lock);
+	dlist_foreach(iter, &mqueue_shm_values->blocks_list)
+	{
+		pgstrom_queue  *mqueues = (pgstrom_queue *)(iter.cur + 1);
+
+		for (i=0; i < MQUEUES_PER_BLOCK; i++)
+		{
+			pthread_mutex_lock(&mqueues[i].lock);
+			mqueues[i].send_dindex = -1;
+			pthread_mutex_unlock(&mqueues[i].lock);
+		}
+	}
+	SpinLockRelease(&mqueue_shm_values->lock);
+
+	/* move the tokens on the previous rings to the server ring */
+	for (i=0; i < num_rings; i++)
+	{
+		if (!mqueue_shm_values->dev_rings[i])
+			continue;
+		while ((respq = mqueue_ring_pop(mqueue_shm_values->
+										dev_rings[i])) != NULL)
+		{
+			pthread_mutex_lock(&respq->lock);
+			mqueue_sched_push_token(respq);
+			pthread_mutex_unlock(&respq->lock);
+		}
+	}
+
+	for (i=0; i < num_devices; i++)
+	{
+		mqueue_ring	   *ring = NULL;
+
+		if (i < num_rings)
+			ring = mqueue_shm_values->dev_rings[i];
+		if (!ring)
+		{
+			ring = pgstrom_shmem_alloc(length);
+			if (!ring)
+				elog(ERROR, "out of shared memory");
+		}
+		mqueue_ring_init(ring, pgstrom_mqueue_ring_size);
+		mqueue_shm_values->dev_rings[i] = ring;
+		mqueue_shm_values->dev_depth[i] = 0;
+		mqueue_shm_values->dev_steals[i] = 0;
+	}
+	for (i=num_devices; i < num_rings; i++)
+	{
+		if (mqueue_shm_values->dev_rings[i])
+			pgstrom_shmem_free(mqueue_shm_values->dev_rings[i]);
+		mqueue_shm_values->dev_rings[i] = NULL;
+	}
+	pg_write_barrier();
+	mqueue_shm_values->num_dev_rings = num_devices;
+}
+
+/*
+ * pgstrom_bind_server_thread
+ *
+ * It binds the current server thread to the supplied device.
+ */
+void
+pgstrom_bind_server_thread(int dindex)
+{
+	Assert(pgstrom_i_am_clserv);
+	serv_thread_dindex = dindex;
+}
+
 /*
  * pgstrom_try_dequeue_message
  *
@@ -398,9 +1300,7 @@ pgstrom_try_dequeue_message(pgstrom_queue *mqueue)
 void
 pgstrom_cancel_server_loop(void)
 {
-	pgstrom_queue  *mqueue = &mqueue_shm_values->serv_mqueue;
-
-	pthread_cond_broadcast(&mqueue->cond);
+	mqueue_ring_wakeup(mqueue_shm_values->serv_ring, INT_MAX);
 }
 
 /*
@@ -418,15 +1318,24 @@ pgstrom_close_server_queue(void)
 	Assert(pgstrom_i_am_clserv);
 
 	pgstrom_close_queue(svqueue);
+
+	/* wait for completion of concurrent producers */
+	pg_memory_barrier();
+	while (mqueue_shm_values->serv_ring->num_producers > 0)
+		sched_yield();
+
 	/*
 	 * Once server message queue is closed, messages being already queued
 	 * are immediately replied to the backend with error code.
 	 */
-	while ((msg = pgstrom_try_dequeue_message(svqueue)) != NULL)
+	while ((msg = pgstrom_try_dequeue_server_message()) != NULL)
 	{
 		msg->errcode = StromError_ServerNotReady;
 		pgstrom_reply_message(msg);
 	}
+	/* server threads are already terminated; no more deferral */
+	pgstrom_flush_reply_messages();
+	reply_deferrable = false;
 }
 
 /*
@@ -574,6 +1483,8 @@ pgstrom_init_message(pgstrom_message *message,
 		message->respq = pgstrom_get_queue(respq);
 	message->cb_process = cb_process;
 	message->cb_release = cb_release;
+	message->dindex = -1;
+	message->sched_length = 0;
 	message->pfm.enabled = perfmon_enabled;
 }
 
@@ -587,6 +1498,10 @@ typedef struct {
 	pid_t		owner;
 	char		state;	/* 'a' = active, 'c' = closed, 'f' = free*/
 	int			refcnt;
+	int			weight;
+	int			depth;
+	double		wait_avg;	/* average wait time in msec */
+	double		wait_max;	/* wait time of the oldest message in msec */
 } mqueue_info;
 
 Datum
@@ -595,8 +1510,8 @@ pgstrom_mqueue_info(PG_FUNCTION_ARGS)
 	FuncCallContext *fncxt;
 	mqueue_info	   *mq_info;
 	HeapTuple		tuple;
-	Datum			values[4];
-	bool			isnull[4];
+	Datum			values[8];
+	bool			isnull[8];
 	char			buf[256];
 	int				i;
 
@@ -606,11 +1521,13 @@ pgstrom_mqueue_info(PG_FUNCTION_ARGS)
 		MemoryContext	oldcxt;
 		dlist_iter		iter;
 		List		   *mq_list = NIL;
+		mqueue_ring	   *ring = mqueue_shm_values->serv_ring;
+		struct timeval	tv;
 
 		fncxt = SRF_FIRSTCALL_INIT();
 		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
 
-		tupdesc = CreateTemplateTupleDesc(4, false);
+		tupdesc = CreateTemplateTupleDesc(8, false);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "mqueue",
 						   TEXTOID, -1, 0);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "owner",
@@ -619,8 +1536,18 @@ pgstrom_mqueue_info(PG_FUNCTION_ARGS)
 						   TEXTOID, -1, 0);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 4, "refcnt",
 						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 5, "weight",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 6, "depth",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 7, "wait_avg",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 8, "wait_max",
+						   FLOAT8OID, -1, 0);
 		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
 
+		gettimeofday(&tv, NULL);
+
 		SpinLockAcquire(&mqueue_shm_values->lock);
 		PG_TRY();
 		{
@@ -630,6 +1557,12 @@ pgstrom_mqueue_info(PG_FUNCTION_ARGS)
 			mq_info->owner = mqueue_shm_values->serv_mqueue.owner;
 			mq_info->state = mqueue_shm_values->serv_mqueue.closed ? 'c' : 'a';
 			mq_info->refcnt = mqueue_shm_values->serv_mqueue.refcnt;
+			/* number of scheduling tokens in the server queue */
+			mq_info->weight = -1;
+			mq_info->depth = (int)(ring->enqueue_pos - ring->dequeue_pos)
+				+ ring->num_overflow;
+			mq_info->wait_avg = -1.0;
+			mq_info->wait_max = -1.0;
 			mq_list = lappend(mq_list, mq_info);
 
 			/* backend mqueues */
@@ -649,6 +1582,25 @@ pgstrom_mqueue_info(PG_FUNCTION_ARGS)
 
 					pthread_mutex_lock(&mqueues[i].lock);
 					mq_info->refcnt = mqueues[i].refcnt;
+					mq_info->weight = mqueues[i].send_weight;
+					mq_info->depth = mqueues[i].send_depth;
+					if (mqueues[i].send_nitems > 0)
+						mq_info->wait_avg =
+							((double) mqueues[i].send_wait /
+							 (double) mqueues[i].send_nitems) / 1000.0;
+					else
+						mq_info->wait_avg = 0.0;
+					if (!dlist_is_empty(&mqueues[i].sendq))
+					{
+						pgstrom_message *msg
+							= dlist_container(pgstrom_message, chain,
+									dlist_head_node(&mqueues[i].sendq));
+						mq_info->wait_max =
+							(double) timeval_diff(&msg->tv_enqueue,
+												  &tv) / 1000.0;
+					}
+					else
+						mq_info->wait_max = 0.0;
 					pthread_mutex_unlock(&mqueues[i].lock);
 
 					mq_list = lappend(mq_list, mq_info);
@@ -685,6 +1637,19 @@ pgstrom_mqueue_info(PG_FUNCTION_ARGS)
 			   (mq_info->state == 'f' ? "free" : "unknown"))));
 	values[2] = CStringGetTextDatum(buf);
 	values[3] = Int32GetDatum(mq_info->refcnt);
+	if (mq_info->weight < 0)
+		isnull[4] = true;
+	else
+		values[4] = Int32GetDatum(mq_info->weight);
+	values[5] = Int32GetDatum(mq_info->depth);
+	if (mq_info->wait_avg < 0.0)
+		isnull[6] = true;
+	else
+		values[6] = Float8GetDatum(mq_info->wait_avg);
+	if (mq_info->wait_max < 0.0)
+		isnull[7] = true;
+	else
+		values[7] = Float8GetDatum(mq_info->wait_max);
 
 	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
 
@@ -692,6 +1657,120 @@ pgstrom_mqueue_info(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_mqueue_info);
 
+/*
+ * pgstrom_mqueue_ring_bench
+ *
+ * A stress benchmark of the lock-free ring buffer. It launches N producer
+ * and M consumer threads on a private ring, then returns the number of
+ * messages transferred per second. See bench/pg_strom_bench.sql.
+ */
+typedef struct {
+	mqueue_ring	   *ring;
+	cl_ulong		nitems;		/* number of items per producer */
+	volatile cl_ulong nconsumed;/* total number of consumed items */
+	cl_ulong		nremains;	/* total number of items to be consumed */
+} mqueue_bench_state;
+
+static void *
+mqueue_bench_producer(void *arg)
+{
+	mqueue_bench_state *mbs = arg;
+	cl_ulong	i;
+
+	for (i=0; i < mbs->nitems; i++)
+	{
+		/* NULL is not a valid item, so we put (i+1) instead */
+		while (!mqueue_ring_push(mbs->ring, (void *)(uintptr_t)(i + 1)))
+			sched_yield();
+		mqueue_ring_wakeup(mbs->ring, 1);
+	}
+	return NULL;
+}
+
+static void *
+mqueue_bench_consumer(void *arg)
+{
+	mqueue_bench_state *mbs = arg;
+	void	   *item;
+	int			futex_val;
+
+	while (mbs->nconsumed < mbs->nremains)
+	{
+		item = mqueue_ring_pop(mbs->ring);
+		if (!item)
+		{
+			futex_val = mqueue_ring_prepare_sleep(mbs->ring);
+			item = mqueue_ring_pop(mbs->ring);
+			if (item)
+				mqueue_ring_cancel_sleep(mbs->ring);
+			else if (mbs->nconsumed < mbs->nremains)
+				mqueue_ring_sleep(mbs->ring, futex_val, POOLING_INTERVAL);
+			else
+				mqueue_ring_cancel_sleep(mbs->ring);
+		}
+		if (item &&
+			__sync_add_and_fetch(&mbs->nconsumed, 1) == mbs->nremains)
+			mqueue_ring_wakeup(mbs->ring, INT_MAX);
+	}
+	return NULL;
+}
+
+Datum
+pgstrom_mqueue_ring_bench(PG_FUNCTION_ARGS)
+{
+	int32		nproducers = PG_GETARG_INT32(0);
+	int32		nconsumers = PG_GETARG_INT32(1);
+	int64		nmessages = PG_GETARG_INT64(2);
+	mqueue_bench_state mbs;
+	pthread_t  *threads;
+	struct timeval tv1, tv2;
+	int			i, nthreads;
+
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("only superuser can run the benchmark")));
+	if (nproducers < 1 || nconsumers < 1 || nmessages < 1)
+		elog(ERROR, "number of producers, consumers and messages must be positive");
+
+	mbs.ring = palloc(offsetof(mqueue_ring, cells[pgstrom_mqueue_ring_size]));
+	mqueue_ring_init(mbs.ring, pgstrom_mqueue_ring_size);
+	mbs.nitems = (nmessages + nproducers - 1) / nproducers;
+	mbs.nconsumed = 0;
+	mbs.nremains = mbs.nitems * nproducers;
+
+	threads = palloc(sizeof(pthread_t) * (nproducers + nconsumers));
+	gettimeofday(&tv1, NULL);
+	for (nthreads=0; nthreads < nproducers + nconsumers; nthreads++)
+	{
+		if (pthread_create(&threads[nthreads], NULL,
+						   nthreads < nconsumers
+						   ? mqueue_bench_consumer
+						   : mqueue_bench_producer,
+						   &mbs) != 0)
+			break;
+	}
+	if (nthreads < nproducers + nconsumers)
+	{
+		/* consume the items by the running producers, then raise error */
+		mbs.nremains = mbs.nitems * Max(nthreads - nconsumers, 0);
+		mqueue_ring_wakeup(mbs.ring, INT_MAX);
+		for (i=0; i < nthreads; i++)
+			pthread_join(threads[i], NULL);
+		elog(ERROR, "failed on pthread_create: %m");
+	}
+	for (i=0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	gettimeofday(&tv2, NULL);
+
+	pfree(threads);
+	pfree(mbs.ring);
+
+	PG_RETURN_FLOAT8((double) mbs.nremains * 1000000.0 /
+					 (double) Max(timeval_diff(&tv1, &tv2), 1));
+}
+PG_FUNCTION_INFO_V1(pgstrom_mqueue_ring_bench);
+
 /*
  * pgstrom_startup_mqueue
  *
@@ -714,6 +1793,15 @@ pgstrom_startup_mqueue(void)
 	SpinLockInit(&mqueue_shm_values->lock);
 	dlist_init(&mqueue_shm_values->free_queue_list);
 
+	mqueue_shm_values->serv_ring =
+		ShmemInitStruct("mqueue_serv_ring",
+						MAXALIGN(offsetof(mqueue_ring,
+										  cells[pgstrom_mqueue_ring_size])),
+						&found);
+	Assert(!found);
+	mqueue_ring_init(mqueue_shm_values->serv_ring,
+					 pgstrom_mqueue_ring_size);
+
 	mqueue = &mqueue_shm_values->serv_mqueue;
 	memset(mqueue, 0, sizeof(pgstrom_queue));
 	mqueue->sobj.stag = StromTag_MsgQueue;
@@ -748,6 +1836,46 @@ pgstrom_init_mqueue(void)
 							GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
 
+	/* number of cells in the server message queue */
+	DefineCustomIntVariable("pg_strom.mqueue_ring_size",
+							"number of slots of the server message queue",
+							NULL,
+							&pgstrom_mqueue_ring_size,
+							8192,
+							256,
+							1048576,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	/* round up to power of 2 for cheap index calculation */
+	pgstrom_mqueue_ring_size = 1 << get_next_log2(pgstrom_mqueue_ring_size);
+
+	/* upper limit of spinning prior to sleep on the response queue */
+	DefineCustomIntVariable("pg_strom.mqueue_spin_limit",
+							"max time to spin on response queue in usec",
+							"0 disables spinning, so backend always sleeps"
+							" until the response comes.",
+							&pgstrom_mqueue_spin_limit,
+							100,
+							0,
+							10000,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
+	/* weight of the message queues in round-robin scheduling */
+	DefineCustomIntVariable("pg_strom.mqueue_priority",
+							"scheduling weight of message queues of the session",
+							"Message queues with larger weight can get more"
+							" share of the OpenCL server.",
+							&pgstrom_mqueue_priority,
+							1,
+							1,
+							64,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
 	/* initialization of mutex_attr */
 	rc = pthread_mutexattr_init(&mutex_attr);
 	if (rc != 0)
@@ -780,6 +1908,8 @@ pgstrom_init_mqueue(void)
 
 	/* aquires shared memory region */
 	RequestAddinShmemSpace(MAXALIGN(sizeof(*mqueue_shm_values)));
+	RequestAddinShmemSpace(MAXALIGN(offsetof(mqueue_ring,
+									cells[pgstrom_mqueue_ring_size])));
 	shmem_startup_hook_next = shmem_startup_hook;
 	shmem_startup_hook = pgstrom_startup_mqueue;
 }
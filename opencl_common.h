@@ -33,6 +33,24 @@
 #define NULL	((__global void *) 0UL)
 #endif
 
+/*
+ * Storage class of the functions in the supplemental libraries that can be
+ * compiled separately. OPENCL_DEVICE_LIBRARY is defined when the library is
+ * compiled alone as a library object, so the functions need external
+ * linkage. Elsewhere, they are built together with the program source.
+ * OPENCL_DEVICE_PROTOTYPE is defined when the program source is compiled
+ * to be linked with the library objects, so the libraries provide only
+ * the type definitions and prototypes; they have to be declared with
+ * external linkage to be resolved by the linker.
+ */
+#if defined(OPENCL_DEVICE_LIBRARY)
+#define STROMCL_LIBFUNC
+#elif defined(OPENCL_DEVICE_PROTOTYPE)
+#define STROMCL_LIBFUNC			extern
+#else
+#define STROMCL_LIBFUNC			static
+#endif
+
 /* Misc definitions */
 #define FLEXIBLE_ARRAY_MEMBER	0
 #define offsetof(TYPE, FIELD)   ((uintptr_t) &((TYPE *)0)->FIELD)
@@ -331,6 +349,33 @@ typedef struct {
  * | pd_linep[]     |  tuple[0]       | | values[M-1]  |
  * |      :         |  <contents>     | |   :          |
  * +----------------+-----------------+-+--------------+
+ *
+ * Column-format is constructed on the host side from a row-format store.
+ * It keeps blkitems[] and rowitems[] of the source as is, because host
+ * code still needs to reference the original tuples (and the pinned
+ * shared buffers). Its body contains only the columns being referenced
+ * by the device kernel; colmeta[].cs_offset points the head of the
+ * column-array, or zero if not loaded. Each column-array consists of
+ * values (or cl_uint offset to the varlena arena in case of variable-
+ * length fields), followed by the null bitmap. The arena of varlena
+ * values is put on the tail.
+ * Only the header and the region from KERN_DATA_STORE_COLUMN_BASE() are
+ * sent to the device, so neither blkitems[], rowitems[] nor the heap
+ * pages consume DMA bandwidth.
+ *
+ * +----------------+
+ * | blkitems[]     |  <-- host only
+ * | rowitems[]     |  <-- host only
+ * +----------------+  <-- KERN_DATA_STORE_COLUMN_BASE()
+ * | values of      |
+ * |  column-X      |
+ * | nullmap of     |
+ * |  column-X      |
+ * +----------------+
+ * |      :         |
+ * +----------------+
+ * | varlena arena  |
+ * +----------------+  <-- usage
  */
 typedef struct {
 	/* true, if column is held by value. Elsewhere, a reference */
@@ -343,6 +388,8 @@ typedef struct {
 	cl_short		attnum;
 	/* offset of attribute location, if deterministic */
 	cl_short		attcacheoff;
+	/* offset of column-array from the head, if column-format */
+	cl_uint			cs_offset;
 } kern_colmeta;
 
 /*
@@ -371,6 +418,7 @@ typedef struct {
 #define KDS_FORMAT_ROW			1
 #define KDS_FORMAT_ROW_FLAT		2
 #define KDS_FORMAT_TUPSLOT		3
+#define KDS_FORMAT_COLUMN		4
 
 typedef struct {
 	hostptr_t		hostptr;	/* address of kds on the host */
@@ -426,6 +474,23 @@ typedef struct {
 	((__global cl_char *)									\
 	 (KERN_DATA_STORE_VALUES((kds),(row_index)) + (kds)->ncols))
 
+/* access macro for column format */
+#define KERN_DATA_STORE_COLUMN_BASE(kds)							\
+	(STROMALIGN(offsetof(kern_data_store, colmeta[(kds)->ncols])) +	\
+	 STROMALIGN(sizeof(kern_blkitem) * (kds)->maxblocks) +			\
+	 STROMALIGN(sizeof(kern_rowitem) * (kds)->nrooms))
+#define KERN_DATA_STORE_COLUMN_UNITSZ(cmeta)		\
+	((cmeta).attlen > 0 ?							\
+	 TYPEALIGN((cmeta).attalign, (cmeta).attlen) :	\
+	 sizeof(cl_uint))
+#define KERN_DATA_STORE_COLUMN_VALUES(kds,colidx)					\
+	((__global cl_char *)(kds) + (kds)->colmeta[(colidx)].cs_offset)
+#define KERN_DATA_STORE_COLUMN_NULLMAP(kds,colidx)					\
+	((__global cl_uchar *)											\
+	 (KERN_DATA_STORE_COLUMN_VALUES((kds),(colidx)) +				\
+	  STROMALIGN(KERN_DATA_STORE_COLUMN_UNITSZ((kds)->colmeta[(colidx)]) * \
+				 (kds)->nrooms)))
+
 /* length of kern_data_store */
 #define KERN_DATA_STORE_LENGTH(kds)										\
 	((kds)->format == KDS_FORMAT_ROW ?									\
@@ -962,6 +1027,27 @@ kern_get_datum_tupslot(__global kern_data_store *kds,
 	return (__global char *)ktoast + values[colidx];
 }
 
+static inline __global void *
+kern_get_datum_column(__global kern_data_store *kds,
+					  cl_uint colidx, cl_uint rowidx)
+{
+	kern_colmeta		cmeta = kds->colmeta[colidx];
+	__global cl_char   *values;
+	cl_uint				vl_offset;
+
+	if (cmeta.cs_offset == 0)
+		return NULL;	/* likely a BUG; column is not loaded */
+	if (att_isnull(rowidx, KERN_DATA_STORE_COLUMN_NULLMAP(kds, colidx)))
+		return NULL;
+	values = KERN_DATA_STORE_COLUMN_VALUES(kds, colidx);
+	if (cmeta.attlen > 0)
+		return values + KERN_DATA_STORE_COLUMN_UNITSZ(cmeta) * rowidx;
+	vl_offset = ((__global cl_uint *) values)[rowidx];
+	if (vl_offset >= kds->usage)
+		return NULL;	/* likely a BUG */
+	return (__global char *)kds + vl_offset;
+}
+
 static inline __global void *
 kern_get_datum(__global kern_data_store *kds,
 			   __global kern_data_store *ktoast,
@@ -976,6 +1062,8 @@ kern_get_datum(__global kern_data_store *kds,
 		return kern_get_datum_rsflat(kds, colidx, rowidx);
 	if (kds->format == KDS_FORMAT_TUPSLOT)
 		return kern_get_datum_tupslot(kds,ktoast,colidx,rowidx);
+	if (kds->format == KDS_FORMAT_COLUMN)
+		return kern_get_datum_column(kds, colidx, rowidx);
 	/* TODO: put StromError_DataStoreCorruption error here */
 	return NULL;
 }
@@ -995,11 +1083,12 @@ pg_common_vstore(__global kern_data_store *kds,
 	__global cl_char   *slot_isnull;
 	/*
 	 * Only tuple-slot is acceptable destination format.
-	 * Only row- and row-flat are acceptable source format.
+	 * Only row-, row-flat and column are acceptable source format.
 	 */
 	if (kds->format != KDS_FORMAT_TUPSLOT ||
 		(ktoast->format != KDS_FORMAT_ROW &&
-		 ktoast->format != KDS_FORMAT_ROW_FLAT))
+		 ktoast->format != KDS_FORMAT_ROW_FLAT &&
+		 ktoast->format != KDS_FORMAT_COLUMN))
 	{
 		STROM_SET_ERROR(errcode, StromError_SanityCheckViolation);
 		return NULL;
@@ -1079,7 +1168,8 @@ pg_fixup_tupslot_varlena(__private int *errcode,
 			STROM_SET_ERROR(errcode, StromError_DataStoreCorruption);
 		}
 	}
-	else if (ktoast->format == KDS_FORMAT_ROW_FLAT)
+	else if (ktoast->format == KDS_FORMAT_ROW_FLAT ||
+			 ktoast->format == KDS_FORMAT_COLUMN)
 	{
 		hostptr_t	offset = values[colidx];
 
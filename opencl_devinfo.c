@@ -32,8 +32,6 @@
 static int opencl_platform_index;
 
 /* OpenCL resources for quick reference */
-#define MAX_NUM_DEVICES		128
-
 #define OPENCL_DEVINFO_SHM_LENGTH	(64 * 1024)	/* usually sufficient */
 static struct {
 	cl_uint			num_devices;
@@ -284,6 +282,86 @@ out_clean:
 	return NULL;
 }
 
+/*
+ * lookup_device_numa_node
+ *
+ * It looks up the NUMA node where the supplied device is attached, using
+ * vendor extensions to get PCI location of the device. If NUMA topology
+ * is simulated, devices are assigned to the nodes in round-robin.
+ * It returns -1 if unknown.
+ */
+#ifndef CL_DEVICE_PCI_BUS_ID_NV
+#define CL_DEVICE_PCI_BUS_ID_NV		0x4008
+#endif
+#ifndef CL_DEVICE_PCI_SLOT_ID_NV
+#define CL_DEVICE_PCI_SLOT_ID_NV	0x4009
+#endif
+#ifndef CL_DEVICE_TOPOLOGY_AMD
+#define CL_DEVICE_TOPOLOGY_AMD		0x4037
+#endif
+
+static cl_int
+lookup_device_numa_node(pgstrom_device_info *dev_info, cl_device_id device_id)
+{
+	cl_uint		pci_bus;
+	cl_uint		pci_slot;
+	cl_uint		pci_func = 0;
+	char		path[MAXPGPATH];
+	FILE	   *filp;
+	int			node;
+
+	if (pgstrom_numa_is_simulated())
+		return dev_info->dev_index % pgstrom_numa_num_nodes();
+	if (pgstrom_numa_num_nodes() < 2)
+		return 0;
+
+	if (strstr(dev_info->dev_device_extensions, "cl_nv_device_attribute_query"))
+	{
+		if (clGetDeviceInfo(device_id, CL_DEVICE_PCI_BUS_ID_NV,
+							sizeof(cl_uint), &pci_bus, NULL) != CL_SUCCESS ||
+			clGetDeviceInfo(device_id, CL_DEVICE_PCI_SLOT_ID_NV,
+							sizeof(cl_uint), &pci_slot, NULL) != CL_SUCCESS)
+			return -1;
+		pci_func = (pci_slot & 0x07);
+		pci_slot >>= 3;
+	}
+	else if (strstr(dev_info->dev_device_extensions,
+					"cl_amd_device_attribute_query"))
+	{
+		/* see the definition of cl_device_topology_amd */
+		struct {
+			cl_uint		type;
+			char		unused[17];
+			char		bus;
+			char		device;
+			char		function;
+		} topology;
+
+		if (clGetDeviceInfo(device_id, CL_DEVICE_TOPOLOGY_AMD,
+							sizeof(topology), &topology,
+							NULL) != CL_SUCCESS ||
+			topology.type != 1)		/* CL_DEVICE_TOPOLOGY_TYPE_PCIE_AMD */
+			return -1;
+		pci_bus = (unsigned char) topology.bus;
+		pci_slot = (unsigned char) topology.device;
+		pci_func = (unsigned char) topology.function;
+	}
+	else
+		return -1;
+
+	snprintf(path, sizeof(path),
+			 "/sys/bus/pci/devices/0000:%02x:%02x.%x/numa_node",
+			 pci_bus, pci_slot, pci_func);
+	filp = fopen(path, "r");
+	if (!filp)
+		return -1;
+	if (fscanf(filp, "%d", &node) != 1 || node < 0)
+		node = -1;
+	fclose(filp);
+
+	return node;
+}
+
 static pgstrom_platform_info *
 collect_opencl_platform_info(cl_platform_id platform_id)
 {
@@ -450,8 +528,8 @@ pgstrom_opencl_device_info(PG_FUNCTION_ARGS)
 	}
 	fncxt = SRF_PERCALL_SETUP();
 
-	dindex = fncxt->call_cntr / 55;
-	pindex = fncxt->call_cntr % 55;
+	dindex = fncxt->call_cntr / 56;
+	pindex = fncxt->call_cntr % 56;
 
 	if (dindex == opencl_devinfo_shm_values->num_devices)
 		SRF_RETURN_DONE(fncxt);
@@ -731,6 +809,10 @@ pgstrom_opencl_device_info(PG_FUNCTION_ARGS)
 			key = "driver version";
 			value = dinfo->driver_version;
 			break;
+		case 55:
+			key = "numa node";
+			value = psprintf("%d", dinfo->dev_numa_node);
+			break;
 		default:
 			elog(ERROR, "unexpected property index");
 			break;
@@ -929,6 +1011,8 @@ construct_opencl_device_info(void)
 			dev_info = collect_opencl_device_info(devices[j]);
 			dev_info->pl_info = pl_info;
 			dev_info->dev_index = k;
+			dev_info->dev_numa_node =
+				lookup_device_numa_node(dev_info, devices[j]);
 
 			elog(LOG, "PG-Strom: (%d:%d) Device %s (%uMHz x %uunits, %luMB)",
 				 i, j,
@@ -1119,6 +1203,10 @@ pgstrom_init_opencl_devinfo(void)
  * memory is consumed by this kernel. In case when we want to apply
  * same global/local workgroup size for multiple kernels (see gpupreagg.c),
  * it enables to reduce number of workgroup size estimation.
+ * If caller gives a ticket of autotuner (wgtune), the local workgroup size
+ * is chosen by the autotuner from power of two values between the two
+ * policies above. Caller shall feedback the execution time of the kernel
+ * using clserv_wgtune_feedback() after the kernel launch.
  */
 #define MINIMUM_LOCALMEM_CONSUMPTION	1024
 #define MINIMUM_WORKGROUP_UNITSZ			(sizeof(cl_uint) * BITS_PER_BYTE)
@@ -1130,7 +1218,9 @@ clserv_compute_workgroup_size(size_t *p_gwork_sz,
 							  int dev_index,
 							  bool larger_is_better,
 							  size_t num_threads,
-							  size_t local_memsz_per_thread)
+							  size_t local_memsz_per_thread,
+							  Datum dprog_key,
+							  clserv_wgtune *wgtune)
 {
 	const pgstrom_device_info *devinfo;
 	cl_device_id kdevice;
@@ -1221,12 +1311,22 @@ clserv_compute_workgroup_size(size_t *p_gwork_sz,
 		lwork_sz = Min(unitsz, max_workgroup_sz);
 	Assert((lwork_sz & (lwork_sz - 1)) == 0);
 
+	/*
+	 * Optimal workgroup size depends on the device model and data, so
+	 * autotuner samples the candidates on the first executions.
+	 */
+	if (wgtune)
+		lwork_sz = clserv_wgtune_choose(wgtune,
+										dprog_key,
+										kernel,
+										NULL,
+										dev_index,
+										Min(unitsz, max_workgroup_sz),
+										max_workgroup_sz,
+										lwork_sz,
+										num_threads);
 	*p_lwork_sz = lwork_sz;
 	*p_gwork_sz = TYPEALIGN(lwork_sz, num_threads);
 
-	/*
-	 * TODO: needs to put optimal workgroup size for each
-	 * GPU models. Kernel execution time is affected so much.
-	 */
 	return true;
 }
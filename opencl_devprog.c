@@ -18,6 +18,8 @@
 #include "postgres.h"
 #include "catalog/pg_type.h"
 #include "funcapi.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
 #include "storage/barrier.h"
 #include "storage/ipc.h"
 #include "storage/shmem.h"
@@ -25,7 +27,12 @@
 #include "utils/builtins.h"
 #include "utils/guc.h"
 #include "utils/pg_crc.h"
+#include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
 #include "pg_strom.h"
 
 static shmem_startup_hook_type shmem_startup_hook_next;
@@ -34,28 +41,140 @@ static int	itemid_offset_shift;
 static int	itemid_flags_shift;
 static int	itemid_length_shift;
 bool		devprog_enable_optimize;
+static bool	devprog_binary_cache;
+static int	devprog_binary_cache_size;
+static bool	devprog_separate_compile;
+static bool	devprog_wgtune_enabled;
+
+/* directory to save the program binaries, relative to $PGDATA */
+#define DEVPROG_BINARY_CACHE_DIR	"pg_strom_cache"
+#define DEVPROG_BINARY_MAGIC		0x50475342		/* "PGSB" */
+#define DEVPROG_WGTUNE_FILE			"pg_strom_cache/wgtune.dat"
+
+/*
+ * header of the program binary file; source of the device program and
+ * binaries for each device follow.
+ */
+typedef struct {
+	cl_uint		magic;			/* DEVPROG_BINARY_MAGIC */
+	pg_crc32	crc;			/* crc of the device program */
+	pg_crc32	bin_crc;		/* crc of the build environment */
+	int32		extra_flags;	/* set of DEVFUNC_NEEDS_* */
+	cl_uint		num_devices;	/* number of binaries */
+	Size		source_len;		/* length of the program source */
+	size_t		binary_sizes[FLEXIBLE_ARRAY_MEMBER];
+} devprog_binary_header;
 
 #define DEVPROG_HASH_SIZE	2048
+#define DEVPROG_NUM_SHARDS	64
+#define DEVPROG_SHARD(crc)	(((crc) % DEVPROG_HASH_SIZE) % DEVPROG_NUM_SHARDS)
+#define DEVPROG_KERNEL_CACHE_SIZE	8
 
-static struct {
+/*
+ * per-thread cache of kernel objects. Kernel arguments are not thread-safe,
+ * so each server thread has its own set of cl_kernel objects. It also keeps
+ * the local workgroup size once autotuner determined it, to skip the tuner
+ * on the later launches.
+ */
+typedef struct {
+	cl_uint		nitems;
+	cl_uint		next_victim;
+	struct {
+		char		kernel_name[NAMEDATALEN];
+		cl_kernel	kernel;
+		cl_int		wgtune_dindex;	/* device of wgtune_lwork_sz */
+		size_t		wgtune_lwork_sz;/* tuned size, or 0 if not yet */
+	} items[DEVPROG_KERNEL_CACHE_SIZE];
+} devprog_kernel_cache;
+
+/*
+ * The hash table of device programs is striped to DEVPROG_NUM_SHARDS;
+ * each shard has its own lock and LRU list, and protects the hash slots
+ * whose index modulo DEVPROG_NUM_SHARDS is identical.
+ */
+typedef struct {
 	slock_t		lock;
-	Size		usage;
 	dlist_head	lru_list;
+} devprog_shard;
+
+/*
+ * Entry of workgroup size autotuner for a particular combination of device
+ * program, kernel and device. Each candidate of local workgroup size is
+ * sampled WGTUNE_NUM_SAMPLES times on the first executions, then the one
+ * with the least time per thread is chosen.
+ */
+#define WGTUNE_NUM_SLOTS		512
+#define WGTUNE_MAX_PROBES		8
+#define WGTUNE_MAX_CANDIDATES	16
+#define WGTUNE_NUM_SAMPLES		3
+
+typedef struct {
+	pg_crc32	crc;			/* crc of the device program */
+	cl_int		dindex;			/* index of the device */
+	cl_uint		generation;		/* incremented on reuse of the slot */
+	char		kernel_name[NAMEDATALEN];	/* empty, if free slot */
+	size_t		lwork_best;		/* chosen size, or 0 if under tuning */
+	cl_uint		num_cands;		/* number of the candidates */
+	struct {
+		size_t		lwork_sz;	/* local workgroup size */
+		cl_uint		nlaunched;	/* number of launches */
+		cl_uint		nsamples;	/* number of samples being collected */
+		double		nsec_per_thread;	/* sum of time per thread */
+	} cands[WGTUNE_MAX_CANDIDATES];
+} wgtune_entry;
+
+static struct {
+	Size		usage;			/* total usage; updated atomically */
+	uint64		num_hits;		/* number of lookups found in the cache */
+	uint64		num_misses;		/* number of lookups not in the cache */
+	uint64		num_evicts;		/* number of entries being reclaimed */
+	uint64		num_link_fallbacks;	/* number of whole-source builds instead
+									 * of the separate compilation */
+	devprog_shard shards[DEVPROG_NUM_SHARDS];
 	dlist_head	slot[DEVPROG_HASH_SIZE];
+	/* workgroup size autotuner */
+	slock_t		wgtune_lock;
+	bool		wgtune_dirty;	/* true, if results are not saved yet */
+	wgtune_entry wgtune[WGTUNE_NUM_SLOTS];
 } *opencl_devprog_shm_values;
 
+/*
+ * Supplemental libraries that can be compiled separately. Library object
+ * is compiled once on the first demand, then shared by all the programs
+ * that need it. These objects are private to OpenCL server process.
+ */
+typedef struct {
+	int32		extra_flag;		/* one of DEVFUNC_NEEDS_* */
+	const char *label;
+	const char **p_source;
+	cl_program	library;		/* library object, or NULL if not built yet */
+	bool		unavailable;	/* true, if library build was failed */
+} devprog_library;
+
+static devprog_library	devprog_libraries[] = {
+	{ DEVFUNC_NEEDS_TIMELIB, "timelib", &pgstrom_opencl_timelib_code },
+	{ DEVFUNC_NEEDS_NUMERIC, "numeric", &pgstrom_opencl_numeric_code },
+};
+#define DEVPROG_LINKABLE_LIBS	(DEVFUNC_NEEDS_TIMELIB | DEVFUNC_NEEDS_NUMERIC)
+static pthread_mutex_t	devprog_libraries_lock = PTHREAD_MUTEX_INITIALIZER;
+
 typedef struct {
 	StromObject	sobj;		/* = StromTag_DevProgram */
 	dlist_node	hash_chain;
 	dlist_node	lru_chain;
+	int			refcnt;		/* reference counter of this device program */
 	/*
-	 * NOTE: above members are protected by opencl_devprog_shm_values->lock.
+	 * NOTE: above members are protected by the lock of the shard.
 	 */
 	slock_t		lock;		/* protection of the fields below */
-	int			refcnt;		/* reference counter of this device program */
 	dlist_head	waitq;		/* wait queue of program build */
 	cl_program	program;	/* valid only OpenCL intermediator */
+	devprog_kernel_cache *kcache;	/* array of per-thread kernel cache;
+									 * valid only OpenCL intermediator */
 	bool		build_running;	/* true, if async build is running */
+	bool		bin_loaded;	/* true, if program is built from binary */
+	uint32		build_gen;	/* incremented on every start of build */
+	pg_crc32	bin_crc;	/* crc of the build environment */
 	char	   *errmsg;		/* error message if build error */
 
 	/* The fields below are read-only once constructed */
@@ -65,19 +184,50 @@ typedef struct {
 	char		source[FLEXIBLE_ARRAY_MEMBER];
 } devprog_entry;
 
+/*
+ * clserv_release_device_kernels
+ *
+ * It releases all the cached kernel objects of the device program.
+ * Caller must ensure nobody references the device program.
+ */
+static void
+clserv_release_device_kernels(devprog_entry *dprog)
+{
+	devprog_kernel_cache *kcache;
+	int		i, j;
+
+	if (!dprog->kcache)
+		return;
+
+	for (i=0; i < opencl_num_threads; i++)
+	{
+		kcache = &dprog->kcache[i];
+		for (j=0; j < kcache->nitems; j++)
+			clReleaseKernel(kcache->items[j].kernel);
+	}
+	free(dprog->kcache);
+	dprog->kcache = NULL;
+}
+
 /*
  * pgstrom_reclaim_devprog
  *
  * It reclaims device program entries being no longer used according to LRU
- * algorism, but never tries to keep the total usage less than
- * reclaim_threshold, just release the least-recently-used one if total
- * usage is larger than the threshold.
+ * algorism, until total usage gets less than reclaim_threshold. The victims
+ * are picked up from the tail of LRU list of each shard in round-robin, so
+ * it is an approximation of the global LRU.
+ * Victims are detached from the hash table under the lock of the shard,
+ * then the objects of OpenCL driver are released without the lock.
  */
 static void
 pgstrom_reclaim_devprog(void)
 {
-	dlist_iter	iter;
-	Size		length;
+	static pthread_mutex_t reclaim_lock = PTHREAD_MUTEX_INITIALIZER;
+	static int		next_shard = 0;
+	dlist_head		victims;
+	dlist_mutable_iter iter;
+	int				nskips = 0;
+	Size			length;
 
 	/*
 	 * this logic may involves clReleaseProgram(), so only OpenCL
@@ -85,37 +235,951 @@ pgstrom_reclaim_devprog(void)
 	 */
 	Assert(pgstrom_i_am_clserv);
 
-	SpinLockAcquire(&opencl_devprog_shm_values->lock);
-	/* concurrent task already reclaimed it? */
-	if (opencl_devprog_shm_values->usage < reclaim_threshold)
+	/* concurrent thread is already working on reclaim? */
+	if (pthread_mutex_trylock(&reclaim_lock) != 0)
+		return;
+
+	dlist_init(&victims);
+	while (opencl_devprog_shm_values->usage >= reclaim_threshold &&
+		   nskips < DEVPROG_NUM_SHARDS)
+	{
+		devprog_shard  *shard = &opencl_devprog_shm_values->shards[next_shard];
+		devprog_entry  *victim = NULL;
+		dlist_reverse_iter riter;
+
+		next_shard = (next_shard + 1) % DEVPROG_NUM_SHARDS;
+
+		SpinLockAcquire(&shard->lock);
+		dlist_reverse_foreach(riter, &shard->lru_list)
+		{
+			devprog_entry  *dprog
+				= dlist_container(devprog_entry, lru_chain, riter.cur);
+			bool			build_running;
+
+			if (dprog->refcnt > 0)
+				continue;
+			/* build callback may still touch the entry */
+			SpinLockAcquire(&dprog->lock);
+			build_running = dprog->build_running;
+			SpinLockRelease(&dprog->lock);
+			if (build_running)
+				continue;
+
+			dlist_delete(&dprog->hash_chain);
+			dlist_delete(&dprog->lru_chain);
+			victim = dprog;
+			break;
+		}
+		SpinLockRelease(&shard->lock);
+
+		if (!victim)
+		{
+			nskips++;
+			continue;
+		}
+		nskips = 0;
+
+		length = offsetof(devprog_entry, source[victim->source_len + 1]);
+		if (victim->errmsg)
+			length += strlen(victim->errmsg);
+		__sync_fetch_and_sub(&opencl_devprog_shm_values->usage, length);
+		__sync_fetch_and_add(&opencl_devprog_shm_values->num_evicts, 1);
+		dlist_push_tail(&victims, &victim->lru_chain);
+	}
+	pthread_mutex_unlock(&reclaim_lock);
+
+	/* release the victims without any locks */
+	dlist_foreach_modify(iter, &victims)
+	{
+		devprog_entry  *dprog
+			= dlist_container(devprog_entry, lru_chain, iter.cur);
+
+		dlist_delete(&dprog->lru_chain);
+		clserv_release_device_kernels(dprog);
+		if (dprog->program && dprog->program != BAD_OPENCL_PROGRAM)
+			clReleaseProgram(dprog->program);
+		if (dprog->errmsg)
+			pgstrom_shmem_free(dprog->errmsg);
+		pgstrom_shmem_free(dprog);
+	}
+}
+
+/*
+ * clserv_devprog_requeue_waiters
+ *
+ * It enqueues the messages being waiting for completion of program build
+ * into the server's message queue again, in batch. If count_build_time,
+ * the time being waited is accounted as time_kern_build.
+ * Caller must hold dprog->lock.
+ */
+static void
+clserv_devprog_requeue_waiters(devprog_entry *dprog, bool count_build_time)
+{
+	pgstrom_message *pending[MQUEUE_BATCH_SIZE];
+	int				npending = 0;
+	dlist_mutable_iter iter;
+	struct timeval	tv;
+
+	if (count_build_time)
+		gettimeofday(&tv, NULL);
+	dlist_foreach_modify(iter, &dprog->waitq)
+	{
+		pgstrom_message	*msg
+			= dlist_container(pgstrom_message, chain, iter.cur);
+
+		dlist_delete(&msg->chain);
+		if (count_build_time && msg->pfm.enabled)
+			msg->pfm.time_kern_build += timeval_diff(&msg->pfm.tv, &tv);
+		pending[npending++] = msg;
+		if (npending == MQUEUE_BATCH_SIZE)
+		{
+			pgstrom_enqueue_messages(pending, npending);
+			npending = 0;
+		}
+	}
+	if (npending > 0)
+		pgstrom_enqueue_messages(pending, npending);
+}
+
+/*
+ * clserv_devprog_sources
+ *
+ * It sets up an array of the source code to build the device program.
+ * The supplemental libraries in 'exclude_flags' are not included, because
+ * they are linked as library objects. It returns number of the sources.
+ */
+static cl_uint
+clserv_devprog_sources(devprog_entry *dprog, int32 exclude_flags,
+					   const char **sources, size_t *lengths)
+{
+	int32			extra_flags = dprog->extra_flags & ~exclude_flags;
+	cl_uint			count = 0;
+	static size_t	common_code_length = 0;
+
+	/* common opencl header */
+	if (!common_code_length)
+		common_code_length = strlen(pgstrom_opencl_common_code);
+	sources[count] = pgstrom_opencl_common_code;
+	lengths[count] = common_code_length;
+	count++;
+
+	/*
+	 * Supplemental OpenCL Libraries
+	 */
+
+	/* opencl mathlib */
+	if (extra_flags & DEVFUNC_NEEDS_MATHLIB)
+	{
+		static size_t	mathlib_code_length = 0;
+
+		if (!mathlib_code_length)
+			mathlib_code_length = strlen(pgstrom_opencl_mathlib_code);
+		sources[count] = pgstrom_opencl_mathlib_code;
+		lengths[count] = mathlib_code_length;
+		count++;
+	}
+
+	/* opencl timelib */
+	if (extra_flags & DEVFUNC_NEEDS_TIMELIB)
+	{
+		static size_t	timelib_code_length = 0;
+
+		if (!timelib_code_length)
+			timelib_code_length = strlen(pgstrom_opencl_timelib_code);
+		sources[count] = pgstrom_opencl_timelib_code;
+		lengths[count] = timelib_code_length;
+		count++;
+	}
+
+	/* opencl textlib */
+	if (extra_flags & DEVFUNC_NEEDS_TEXTLIB)
+	{
+		static size_t	textlib_code_length = 0;
+
+		if (!textlib_code_length)
+			textlib_code_length = strlen(pgstrom_opencl_textlib_code);
+		sources[count] = pgstrom_opencl_textlib_code;
+		lengths[count] = textlib_code_length;
+		count++;
+	}
+
+	/* opencl numeric */
+	if (extra_flags & DEVFUNC_NEEDS_NUMERIC)
+	{
+		static size_t  numeric_code_length = 0;
+
+		if (!numeric_code_length)
+			numeric_code_length = strlen(pgstrom_opencl_numeric_code);
+		sources[count] = pgstrom_opencl_numeric_code;
+		lengths[count] = numeric_code_length;
+		count++;
+	}
+
+	/*
+	 * main logic for each GPU task (scan, sort, join)
+	 */
+
+	/* gpuscan device implementation */
+	if (extra_flags & DEVKERNEL_NEEDS_GPUSCAN)
+	{
+		static size_t	gpuscan_code_length = 0;
+
+		if (!gpuscan_code_length)
+			gpuscan_code_length = strlen(pgstrom_opencl_gpuscan_code);
+		sources[count] = pgstrom_opencl_gpuscan_code;
+		lengths[count] = gpuscan_code_length;
+		count++;
+	}
+	/* hashjoin device implementation */
+	if (extra_flags & DEVKERNEL_NEEDS_HASHJOIN)
+	{
+		static size_t	hashjoin_code_length = 0;
+
+		if (!hashjoin_code_length)
+			hashjoin_code_length = strlen(pgstrom_opencl_hashjoin_code);
+		sources[count] = pgstrom_opencl_hashjoin_code;
+		lengths[count] = hashjoin_code_length;
+		count++;
+	}
+	/* gpupreagg device implementation */
+	if (extra_flags & DEVKERNEL_NEEDS_GPUPREAGG)
+	{
+		static size_t	gpupreagg_code_length = 0;
+
+		if (!gpupreagg_code_length)
+			gpupreagg_code_length = strlen(pgstrom_opencl_gpupreagg_code);
+		sources[count] = pgstrom_opencl_gpupreagg_code;
+		lengths[count] = gpupreagg_code_length;
+		count++;
+	}
+
+	/* source code of this program */
+	sources[count] = dprog->source;
+	lengths[count] = dprog->source_len;
+	count++;
+
+	return count;
+}
+
+/*
+ * clserv_devprog_build_options
+ *
+ * It makes build options of the device program according to extra_flags.
+ */
+static void
+clserv_devprog_build_options(int32 extra_flags, char *build_opts, size_t len)
+{
+	cl_uint		ofs;
+
+	Assert(SIZEOF_VOID_P == 8 || SIZEOF_VOID_P == 4);
+	ofs = snprintf(build_opts, len,
+#ifdef PGSTROM_DEBUG
+				   " -Werror"
+#endif
+				   " -DOPENCL_DEVICE_CODE -DHOSTPTRLEN=%u -DBLCKSZ=%u"
+				   " -DITEMID_OFFSET_SHIFT=%u"
+				   " -DITEMID_FLAGS_SHIFT=%u"
+				   " -DITEMID_LENGTH_SHIFT=%u"
+				   " -DMAXIMUM_ALIGNOF=%u",
+				   SIZEOF_VOID_P, BLCKSZ,
+				   itemid_offset_shift,
+				   itemid_flags_shift,
+				   itemid_length_shift,
+				   MAXIMUM_ALIGNOF);
+	if (extra_flags & DEVKERNEL_DISABLE_OPTIMIZE)
+		ofs += snprintf(build_opts + ofs, len - ofs,
+						" -cl-opt-disable");
+	if (extra_flags & DEVKERNEL_NEEDS_GPUSCAN)
+		ofs += snprintf(build_opts + ofs, len - ofs,
+						" -DKERNEL_IS_GPUSCAN=1");
+	if (extra_flags & DEVKERNEL_NEEDS_HASHJOIN)
+		ofs += snprintf(build_opts + ofs, len - ofs,
+						" -DKERNEL_IS_HASHJOIN=1");
+	if (extra_flags & DEVKERNEL_NEEDS_GPUPREAGG)
+		ofs += snprintf(build_opts + ofs, len - ofs,
+						" -DKERNEL_IS_GPUPREAGG=1");
+}
+
+/*
+ * program binaries being built but not saved yet. Build callback is
+ * invoked on the thread of OpenCL runtime, so it just queues the program,
+ * then server threads save it when they have nothing to do.
+ */
+typedef struct devprog_binary_pending {
+	struct devprog_binary_pending *next;
+	cl_program	program;		/* retained by the queue */
+	pg_crc32	crc;
+	pg_crc32	bin_crc;
+	int32		extra_flags;
+	Size		source_len;
+	char		source[FLEXIBLE_ARRAY_MEMBER];
+} devprog_binary_pending;
+
+static pthread_mutex_t	devprog_binary_pending_lock
+	= PTHREAD_MUTEX_INITIALIZER;
+static devprog_binary_pending *devprog_binary_pending_list = NULL;
+
+/*
+ * clserv_devprog_binary_path
+ *
+ * It makes a path of the program binary file, relative to $PGDATA.
+ */
+static void
+clserv_devprog_binary_path(pg_crc32 crc, pg_crc32 bin_crc,
+						   char *path, size_t len)
+{
+	snprintf(path, len, "%s/%08x_%08x.bin",
+			 DEVPROG_BINARY_CACHE_DIR,
+			 (unsigned int) crc,
+			 (unsigned int) bin_crc);
+}
+
+/*
+ * clserv_devprog_binary_crc
+ *
+ * It computes a crc of the build environment; that includes all the source
+ * code including the supplemental libraries, build options, and properties
+ * of the devices and drivers. Any binary built on a different environment
+ * shall not be used.
+ */
+static pg_crc32
+clserv_devprog_binary_crc(const char **sources, size_t *lengths, cl_uint count,
+						  const char *build_opts)
+{
+	const pgstrom_device_info *dinfo;
+	pg_crc32	crc;
+	cl_uint		i;
+
+	INIT_CRC32(crc);
+	for (i=0; i < count; i++)
+		COMP_CRC32(crc, sources[i], lengths[i]);
+	COMP_CRC32(crc, build_opts, strlen(build_opts));
+	for (i=0; i < opencl_num_devices; i++)
+	{
+		dinfo = pgstrom_get_device_info(i);
+		COMP_CRC32(crc, dinfo->pl_info->pl_version,
+				   strlen(dinfo->pl_info->pl_version));
+		COMP_CRC32(crc, dinfo->dev_name, strlen(dinfo->dev_name));
+		COMP_CRC32(crc, dinfo->dev_version, strlen(dinfo->dev_version));
+		COMP_CRC32(crc, dinfo->driver_version,
+				   strlen(dinfo->driver_version));
+	}
+	FIN_CRC32(crc);
+
+	return crc;
+}
+
+/*
+ * clserv_devprog_load_binary
+ *
+ * It tries to construct a program object from the binary file being saved
+ * on the previous build, and returns NULL if not available.
+ * Broken or mismatched file shall be removed.
+ */
+static cl_program
+clserv_devprog_load_binary(devprog_entry *dprog)
+{
+	devprog_binary_header *bhead;
+	char		path[MAXPGPATH];
+	char	   *buffer = NULL;
+	const unsigned char *binaries[MAX_NUM_DEVICES];
+	cl_int		binary_status[MAX_NUM_DEVICES];
+	cl_program	program = NULL;
+	struct stat	st_buf;
+	Size		offset;
+	ssize_t		nbytes;
+	int			fdesc;
+	cl_uint		i;
+	cl_int		rc;
+
+	clserv_devprog_binary_path(dprog->crc, dprog->bin_crc,
+							   path, sizeof(path));
+	fdesc = open(path, O_RDONLY);
+	if (fdesc < 0)
+	{
+		if (errno != ENOENT)
+			clserv_log("failed to open \"%s\": %m", path);
+		return NULL;
+	}
+	if (fstat(fdesc, &st_buf) != 0)
+	{
+		clserv_log("failed to stat \"%s\": %m", path);
+		goto out_close;
+	}
+	if (st_buf.st_size < offsetof(devprog_binary_header,
+								  binary_sizes[opencl_num_devices]))
+		goto out_broken;
+
+	buffer = malloc(st_buf.st_size);
+	if (!buffer)
+		goto out_close;
+	for (offset = 0; offset < st_buf.st_size; offset += nbytes)
+	{
+		nbytes = read(fdesc, buffer + offset, st_buf.st_size - offset);
+		if (nbytes < 0 && errno == EINTR)
+			nbytes = 0;
+		else if (nbytes <= 0)
+		{
+			clserv_log("failed to read \"%s\": %m", path);
+			goto out_close;
+		}
+	}
+
+	/* sanity checks */
+	bhead = (devprog_binary_header *) buffer;
+	if (bhead->magic != DEVPROG_BINARY_MAGIC ||
+		bhead->crc != dprog->crc ||
+		bhead->bin_crc != dprog->bin_crc ||
+		bhead->extra_flags != dprog->extra_flags ||
+		bhead->num_devices != opencl_num_devices ||
+		bhead->source_len != dprog->source_len)
+		goto out_broken;
+
+	offset = offsetof(devprog_binary_header,
+					  binary_sizes[opencl_num_devices]);
+	if (offset + bhead->source_len > st_buf.st_size ||
+		memcmp(buffer + offset, dprog->source, dprog->source_len) != 0)
+		goto out_broken;
+	offset += bhead->source_len;
+
+	for (i=0; i < opencl_num_devices; i++)
+	{
+		binaries[i] = (const unsigned char *)(buffer + offset);
+		offset += bhead->binary_sizes[i];
+	}
+	if (offset != st_buf.st_size)
+		goto out_broken;
+
+	program = clCreateProgramWithBinary(opencl_context,
+										opencl_num_devices,
+										opencl_devices,
+										bhead->binary_sizes,
+										binaries,
+										binary_status,
+										&rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("clCreateProgramWithBinary failed: %s",
+				   opencl_strerror(rc));
+		program = NULL;
+		goto out_broken;
+	}
+	close(fdesc);
+	free(buffer);
+	/* update mtime, to evict the binaries being used least recently */
+	utimes(path, NULL);
+	return program;
+
+out_broken:
+	clserv_log("program binary \"%s\" is broken or mismatched, removed",
+			   path);
+	unlink(path);
+out_close:
+	close(fdesc);
+	if (buffer)
+		free(buffer);
+	return NULL;
+}
+
+/*
+ * clserv_devprog_save_binary
+ *
+ * It saves binaries of the program object being built from the source,
+ * to skip run-time compile next time. Not a fatal error even if fail.
+ * The file is written to a temporary one then renamed, so concurrent
+ * readers never see a partial file.
+ */
+static void
+clserv_devprog_save_binary(devprog_binary_pending *pending)
+{
+	cl_program	program = pending->program;
+	devprog_binary_header *bhead;
+	static cl_uint	tempfile_id = 0;
+	char		path[MAXPGPATH];
+	char		temp[MAXPGPATH];
+	unsigned char *binaries[MAX_NUM_DEVICES];
+	Size		head_len;
+	Size		total_len = 0;
+	int			fdesc = -1;
+	cl_uint		i;
+	cl_int		rc;
+
+	head_len = offsetof(devprog_binary_header,
+						binary_sizes[opencl_num_devices]);
+	bhead = calloc(1, head_len);
+	if (!bhead)
+		return;
+	memset(binaries, 0, sizeof(binaries));
+
+	rc = clGetProgramInfo(program,
+						  CL_PROGRAM_BINARY_SIZES,
+						  sizeof(size_t) * opencl_num_devices,
+						  bhead->binary_sizes,
+						  NULL);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("clGetProgramInfo failed: %s", opencl_strerror(rc));
+		goto out;
+	}
+	for (i=0; i < opencl_num_devices; i++)
+	{
+		binaries[i] = malloc(bhead->binary_sizes[i]);
+		if (!binaries[i])
+			goto out;
+		total_len += bhead->binary_sizes[i];
+	}
+	rc = clGetProgramInfo(program,
+						  CL_PROGRAM_BINARIES,
+						  sizeof(unsigned char *) * opencl_num_devices,
+						  binaries,
+						  NULL);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("clGetProgramInfo failed: %s", opencl_strerror(rc));
+		goto out;
+	}
+	bhead->magic = DEVPROG_BINARY_MAGIC;
+	bhead->crc = pending->crc;
+	bhead->bin_crc = pending->bin_crc;
+	bhead->extra_flags = pending->extra_flags;
+	bhead->num_devices = opencl_num_devices;
+	bhead->source_len = pending->source_len;
+
+	if (mkdir(DEVPROG_BINARY_CACHE_DIR, S_IRWXU) != 0 && errno != EEXIST)
+	{
+		clserv_log("failed to create directory \"%s\": %m",
+				   DEVPROG_BINARY_CACHE_DIR);
+		goto out;
+	}
+	clserv_devprog_binary_path(pending->crc, pending->bin_crc,
+							   path, sizeof(path));
+	snprintf(temp, sizeof(temp), "%s.%d.%u", path, MyProcPid,
+			 __sync_fetch_and_add(&tempfile_id, 1));
+	fdesc = open(temp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fdesc < 0)
+	{
+		clserv_log("failed to open \"%s\": %m", temp);
+		goto out;
+	}
+	if (write(fdesc, bhead, head_len) != head_len ||
+		write(fdesc, pending->source,
+			  pending->source_len) != pending->source_len)
+		goto out_unlink;
+	for (i=0; i < opencl_num_devices; i++)
+	{
+		if (write(fdesc, binaries[i],
+				  bhead->binary_sizes[i]) != bhead->binary_sizes[i])
+			goto out_unlink;
+	}
+	if (close(fdesc) != 0)
+	{
+		fdesc = -1;
+		goto out_unlink;
+	}
+	fdesc = -1;
+	if (rename(temp, path) != 0)
+		goto out_unlink;
+	goto out;
+
+out_unlink:
+	clserv_log("failed to write \"%s\": %m", temp);
+	unlink(temp);
+out:
+	if (fdesc >= 0)
+		close(fdesc);
+	for (i=0; i < opencl_num_devices; i++)
+	{
+		if (binaries[i])
+			free(binaries[i]);
+	}
+	free(bhead);
+}
+
+/*
+ * clserv_devprog_queue_binary
+ *
+ * It queues the program object being built from the source, to be saved
+ * by clserv_devprog_save_binaries() later.
+ */
+static void
+clserv_devprog_queue_binary(devprog_entry *dprog, cl_program program)
+{
+	devprog_binary_pending *pending;
+
+	pending = malloc(offsetof(devprog_binary_pending,
+							  source[dprog->source_len]));
+	if (!pending)
+		return;
+	if (clRetainProgram(program) != CL_SUCCESS)
+	{
+		free(pending);
+		return;
+	}
+	pending->program = program;
+	pending->crc = dprog->crc;
+	pending->bin_crc = dprog->bin_crc;
+	pending->extra_flags = dprog->extra_flags;
+	pending->source_len = dprog->source_len;
+	memcpy(pending->source, dprog->source, dprog->source_len);
+
+	pthread_mutex_lock(&devprog_binary_pending_lock);
+	pending->next = devprog_binary_pending_list;
+	devprog_binary_pending_list = pending;
+	pthread_mutex_unlock(&devprog_binary_pending_lock);
+}
+
+/*
+ * clserv_devprog_evict_binaries
+ *
+ * It removes the program binaries being used least recently, until total
+ * size of the binary cache gets less than pg_strom.devprog_binary_cache_size.
+ * Loading a binary updates its mtime, so mtime tells the last use.
+ */
+typedef struct {
+	char		name[NAMEDATALEN];
+	off_t		size;
+	time_t		mtime;
+} devprog_binary_file;
+
+static int
+devprog_binary_file_comp(const void *a, const void *b)
+{
+	const devprog_binary_file *fa = a;
+	const devprog_binary_file *fb = b;
+
+	if (fa->mtime < fb->mtime)
+		return -1;
+	if (fa->mtime > fb->mtime)
+		return 1;
+	return 0;
+}
+
+static void
+clserv_devprog_evict_binaries(void)
+{
+	devprog_binary_file *files = NULL;
+	DIR		   *dir;
+	struct dirent *dent;
+	struct stat	st_buf;
+	char		path[MAXPGPATH];
+	uint64		limit = ((uint64) devprog_binary_cache_size) << 10;
+	uint64		total = 0;
+	int			nfiles = 0;
+	int			nrooms = 0;
+	int			i, len;
+
+	if (devprog_binary_cache_size == 0)
+		return;		/* unlimited */
+
+	dir = opendir(DEVPROG_BINARY_CACHE_DIR);
+	if (!dir)
+		return;
+	while ((dent = readdir(dir)) != NULL)
+	{
+		len = strlen(dent->d_name);
+		if (len < 4 || len >= NAMEDATALEN ||
+			strcmp(dent->d_name + len - 4, ".bin") != 0)
+			continue;
+		snprintf(path, sizeof(path), "%s/%s",
+				 DEVPROG_BINARY_CACHE_DIR, dent->d_name);
+		if (stat(path, &st_buf) != 0 || !S_ISREG(st_buf.st_mode))
+			continue;
+		if (nfiles == nrooms)
+		{
+			devprog_binary_file *temp;
+
+			nrooms = Max(2 * nrooms, 64);
+			temp = realloc(files, sizeof(devprog_binary_file) * nrooms);
+			if (!temp)
+				goto out;
+			files = temp;
+		}
+		strcpy(files[nfiles].name, dent->d_name);
+		files[nfiles].size = st_buf.st_size;
+		files[nfiles].mtime = st_buf.st_mtime;
+		total += st_buf.st_size;
+		nfiles++;
+	}
+
+	if (total > limit)
+	{
+		qsort(files, nfiles, sizeof(devprog_binary_file),
+			  devprog_binary_file_comp);
+		for (i=0; i < nfiles && total > limit; i++)
+		{
+			snprintf(path, sizeof(path), "%s/%s",
+					 DEVPROG_BINARY_CACHE_DIR, files[i].name);
+			if (unlink(path) == 0)
+				total -= files[i].size;
+		}
+	}
+out:
+	closedir(dir);
+	if (files)
+		free(files);
+}
+
+/*
+ * clserv_devprog_save_binaries
+ *
+ * It saves the program binaries being queued by the build callback, then
+ * evicts the older ones if binary cache exceeds the limit. Server threads
+ * call it when they have no messages to be processed.
+ */
+void
+clserv_devprog_save_binaries(void)
+{
+	static pthread_mutex_t save_lock = PTHREAD_MUTEX_INITIALIZER;
+	devprog_binary_pending *pending;
+	devprog_binary_pending *next;
+
+	if (!devprog_binary_pending_list)
+		return;
+
+	pthread_mutex_lock(&devprog_binary_pending_lock);
+	pending = devprog_binary_pending_list;
+	devprog_binary_pending_list = NULL;
+	pthread_mutex_unlock(&devprog_binary_pending_lock);
+	if (!pending)
+		return;
+
+	pthread_mutex_lock(&save_lock);
+	for (; pending != NULL; pending = next)
+	{
+		next = pending->next;
+		clserv_devprog_save_binary(pending);
+		clReleaseProgram(pending->program);
+		free(pending);
+	}
+	clserv_devprog_evict_binaries();
+	pthread_mutex_unlock(&save_lock);
+}
+
+/*
+ * clserv_devprog_forget_binary
+ *
+ * It removes the program binary file that was loaded but failed to build,
+ * then the program shall be built from the source on the next lookup.
+ */
+static void
+clserv_devprog_forget_binary(devprog_entry *dprog)
+{
+	char	path[MAXPGPATH];
+
+	clserv_devprog_binary_path(dprog->crc, dprog->bin_crc,
+							   path, sizeof(path));
+	clserv_log("failed to build program from binary \"%s\", removed", path);
+	unlink(path);
+	dprog->bin_loaded = false;
+}
+
+/*
+ * clserv_devprog_log_build_error
+ *
+ * It dumps build log of the program object on compile or link failure.
+ */
+static void
+clserv_devprog_log_build_error(cl_program program, const char *label)
+{
+	char	buffer[16 * 1024];
+	size_t	buflen;
+	int		i;
+
+	for (i=0; i < opencl_num_devices; i++)
+	{
+		if (clGetProgramBuildInfo(program,
+								  opencl_devices[i],
+								  CL_PROGRAM_BUILD_LOG,
+								  sizeof(buffer) - 1,
+								  buffer,
+								  &buflen) == CL_SUCCESS)
+		{
+			buffer[buflen] = '\0';
+			clserv_log("%s build log on device %d:\n%s", label, i, buffer);
+		}
+	}
+}
+
+/*
+ * clserv_devprog_get_library
+ *
+ * It returns a library object being compiled from the common header and
+ * the supplied library source, or NULL if not available.
+ * It is compiled synchronously on the first demand, because it takes
+ * place only once during the server lifetime.
+ */
+static cl_program
+clserv_devprog_get_library(devprog_library *dlib)
+{
+	const char *sources[2];
+	size_t		lengths[2];
+	char		build_opts[1024];
+	cl_program	library;
+	cl_int		rc;
+
+	pthread_mutex_lock(&devprog_libraries_lock);
+	if (!dlib->library && !dlib->unavailable)
+	{
+		sources[0] = pgstrom_opencl_common_code;
+		lengths[0] = strlen(pgstrom_opencl_common_code);
+		sources[1] = *dlib->p_source;
+		lengths[1] = strlen(*dlib->p_source);
+
+		clserv_devprog_build_options(0, build_opts, sizeof(build_opts));
+		strncat(build_opts, " -DOPENCL_DEVICE_LIBRARY",
+				sizeof(build_opts) - strlen(build_opts) - 1);
+
+		library = clCreateProgramWithSource(opencl_context,
+											2, sources, lengths, &rc);
+		if (rc != CL_SUCCESS)
+		{
+			clserv_log("clCreateProgramWithSource failed: %s",
+					   opencl_strerror(rc));
+			dlib->unavailable = true;
+			goto out_unlock;
+		}
+		rc = clCompileProgram(library,
+							  opencl_num_devices,
+							  opencl_devices,
+							  build_opts,
+							  0, NULL, NULL,
+							  NULL, NULL);
+		if (rc != CL_SUCCESS)
+		{
+			clserv_log("clCompileProgram of %s failed: %s",
+					   dlib->label, opencl_strerror(rc));
+			clserv_devprog_log_build_error(library, dlib->label);
+			clReleaseProgram(library);
+			dlib->unavailable = true;
+			goto out_unlock;
+		}
+		dlib->library = library;
+	}
+out_unlock:
+	library = dlib->library;
+	pthread_mutex_unlock(&devprog_libraries_lock);
+
+	return library;
+}
+
+/*
+ * clserv_devprog_link_program
+ *
+ * If the device program needs the libraries that can be compiled separately,
+ * it compiles only the program source, then links it with the library
+ * objects. It returns a linked executable program, or NULL if we cannot
+ * apply separate compilation; caller shall build the whole source then.
+ * Compile and link are done synchronously, but they take much less time
+ * than the whole build.
+ * The fallback to the whole build is counted, if the program needs the
+ * libraries but we could not link them.
+ */
+static cl_program
+clserv_devprog_link_program(devprog_entry *dprog, const char *build_opts)
+{
+	static int	linker_support = -1;
+	const char *sources[32];
+	size_t		lengths[32];
+	cl_program	inputs[lengthof(devprog_libraries) + 1];
+	cl_program	program;
+	cl_program	linked;
+	cl_uint		count;
+	cl_uint		ninputs = 0;
+	char		compile_opts[1024];
+	int			i, major, minor;
+	cl_int		rc;
+
+	if (!devprog_separate_compile ||
+		(dprog->extra_flags & DEVPROG_LINKABLE_LIBS) == 0)
+		return NULL;
+
+	/* all the devices have to support OpenCL 1.2 or later */
+	if (linker_support < 0)
 	{
-		SpinLockRelease(&opencl_devprog_shm_values->lock);
-		return;
+		linker_support = opencl_entry_has_linker();
+		for (i=0; linker_support && i < opencl_num_devices; i++)
+		{
+			const pgstrom_device_info *dinfo = pgstrom_get_device_info(i);
+
+			if (sscanf(dinfo->dev_opencl_c_version, "OpenCL C %d.%d ",
+					   &major, &minor) != 2 ||
+				major < 1 || (major == 1 && minor < 2))
+				linker_support = 0;
+		}
 	}
+	if (!linker_support)
+		goto fallback;
 
-	dlist_reverse_foreach(iter, &opencl_devprog_shm_values->lru_list)
+	/* library objects */
+	for (i=0; i < lengthof(devprog_libraries); i++)
 	{
-		devprog_entry  *dprog
-			= dlist_container(devprog_entry, lru_chain, iter.cur);
+		devprog_library	*dlib = &devprog_libraries[i];
 
-		if (dprog->refcnt > 0)
+		if ((dprog->extra_flags & dlib->extra_flag) == 0)
 			continue;
+		inputs[++ninputs] = clserv_devprog_get_library(dlib);
+		if (!inputs[ninputs])
+			goto fallback;
+	}
 
-		Assert(dprog->refcnt == 0);
-		dlist_delete(&dprog->hash_chain);
-		dlist_delete(&dprog->lru_chain);
+	/* compile the program source with prototypes of the libraries */
+	count = clserv_devprog_sources(dprog, DEVPROG_LINKABLE_LIBS,
+								   sources, lengths);
+	snprintf(compile_opts, sizeof(compile_opts),
+			 "%s -DOPENCL_DEVICE_PROTOTYPE", build_opts);
+	program = clCreateProgramWithSource(opencl_context,
+										count, sources, lengths, &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("clCreateProgramWithSource failed: %s",
+				   opencl_strerror(rc));
+		goto fallback;
+	}
+	rc = clCompileProgram(program,
+						  opencl_num_devices,
+						  opencl_devices,
+						  compile_opts,
+						  0, NULL, NULL,
+						  NULL, NULL);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("clCompileProgram failed: %s", opencl_strerror(rc));
+		clserv_devprog_log_build_error(program, "program");
+		clReleaseProgram(program);
+		goto fallback;
+	}
 
-		length = offsetof(devprog_entry, source[dprog->source_len]);
-		if (dprog->errmsg)
+	/* link them */
+	inputs[0] = program;
+	linked = clLinkProgram(opencl_context,
+						   opencl_num_devices,
+						   opencl_devices,
+						   NULL,
+						   ninputs + 1,
+						   inputs,
+						   NULL, NULL,
+						   &rc);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("clLinkProgram failed: %s", opencl_strerror(rc));
+		if (linked)
 		{
-			length += strlen(dprog->errmsg);
-			pgstrom_shmem_free(dprog->errmsg);
+			clserv_devprog_log_build_error(linked, "linked program");
+			clReleaseProgram(linked);
 		}
-		clReleaseProgram(dprog->program);
-		opencl_devprog_shm_values->usage -= length;
-		break;
+		linked = NULL;
 	}
-	SpinLockRelease(&opencl_devprog_shm_values->lock);
+	clReleaseProgram(program);
+	if (!linked)
+		goto fallback;
+
+	return linked;
+
+fallback:
+	if (linker_support)
+		clserv_log("separate compilation failed, build the whole source");
+	__sync_fetch_and_add(&opencl_devprog_shm_values->num_link_fallbacks, 1);
+	return NULL;
 }
 
 /*
@@ -130,9 +1194,8 @@ clserv_devprog_build_callback(cl_program program, void *cb_private)
 {
 	devprog_entry *dprog = (devprog_entry *) cb_private;
 	cl_build_status	status;
-	dlist_mutable_iter iter;
-	struct timeval	tv;
 	char		   *errmsg = NULL;
+	bool			retry_source = false;
 	cl_int			i, rc;
 
 	/* check program build status */
@@ -176,8 +1239,9 @@ clserv_devprog_build_callback(cl_program program, void *cb_private)
 			errmsg = pgstrom_shmem_alloc(buflen + 1);
 			if (errmsg)
 			{
-				opencl_devprog_shm_values->usage += buflen;
 				strcpy(errmsg, buffer);
+				__sync_fetch_and_add(&opencl_devprog_shm_values->usage,
+									 strlen(errmsg));
 			}
 			goto out_error;
 		}
@@ -207,45 +1271,46 @@ clserv_devprog_build_callback(cl_program program, void *cb_private)
 #endif
 	}
 	/*
-	 * OK, source build was successfully done for all the devices
+	 * OK, source build was successfully done for all the devices.
+	 * Save the binaries for the next time, unless it came from there.
+	 * File i/o is deferred to the server threads.
 	 */
+	if (devprog_binary_cache && !dprog->bin_loaded)
+		clserv_devprog_queue_binary(dprog, program);
+
 	SpinLockAcquire(&dprog->lock);
 	Assert(dprog->program == program);
-	dlist_foreach_modify(iter, &dprog->waitq)
-	{
-		pgstrom_message	*msg
-			= dlist_container(pgstrom_message, chain, iter.cur);
-
-		dlist_delete(&msg->chain);
-
-		if (msg->pfm.enabled)
-		{
-			gettimeofday(&tv, NULL);
-			msg->pfm.time_kern_build += timeval_diff(&msg->pfm.tv, &tv);
-		}
-		pgstrom_enqueue_message(msg);
-	}
+	clserv_devprog_requeue_waiters(dprog, true);
 	dprog->build_running = false;
 	SpinLockRelease(&dprog->lock);
 	return;
 
 
 out_error:
+	/*
+	 * In case of build failure from the binary, we forget the binary then
+	 * try to build it from the source again on the next lookup.
+	 */
+	if (dprog->bin_loaded)
+	{
+		clserv_devprog_forget_binary(dprog);
+		retry_source = true;
+		if (errmsg)
+		{
+			__sync_fetch_and_sub(&opencl_devprog_shm_values->usage,
+								 strlen(errmsg));
+			pgstrom_shmem_free(errmsg);
+			errmsg = NULL;
+		}
+	}
 	SpinLockAcquire(&dprog->lock);
 	Assert(dprog->program == program);
 	dprog->errmsg = errmsg;
-	dlist_foreach_modify(iter, &dprog->waitq)
-	{
-		pgstrom_message *msg
-			= dlist_container(pgstrom_message, chain, iter.cur);
-
-		dlist_delete(&msg->chain);
-        pgstrom_enqueue_message(msg);
-    }
-	dprog->build_running = false;
 	rc = clReleaseProgram(program);
 	Assert(rc == CL_SUCCESS);
-	dprog->program = BAD_OPENCL_PROGRAM;
+	dprog->program = (retry_source ? NULL : BAD_OPENCL_PROGRAM);
+	clserv_devprog_requeue_waiters(dprog, false);
+	dprog->build_running = false;
 	SpinLockRelease(&dprog->lock);
 }
 
@@ -266,6 +1331,8 @@ out_error:
  * again.
  * In case of (3), it returns BAD_OPENCL_PROGRAM to inform caller the
  * supplied program has compile errors, or something broken.
+ * On case (1), the program binary saved under $PGDATA/pg_strom_cache on
+ * the previous build is used instead of the source, if any.
  */
 cl_program
 clserv_lookup_device_program(Datum dprog_key, pgstrom_message *message)
@@ -285,139 +1352,90 @@ clserv_lookup_device_program(Datum dprog_key, pgstrom_message *message)
 	 * destruction.
 	 */
 	pg_memory_barrier();
-	if (opencl_devprog_shm_values->usage >= reclaim_threshold)
+	if (reclaim_threshold > 0 &&
+		opencl_devprog_shm_values->usage >= reclaim_threshold)
 		pgstrom_reclaim_devprog();
 
 	SpinLockAcquire(&dprog->lock);
-	if (!dprog->program)
+	if (!dprog->program && !dprog->build_running)
 	{
 		cl_program		program;
 		const char	   *sources[32];
 		size_t			lengths[32];
 		char			build_opts[1024];
-		cl_uint			ofs;
-		cl_uint			count = 0;
-		static size_t	common_code_length = 0;
-
-		/* common opencl header */
-		if (!common_code_length)
-			common_code_length = strlen(pgstrom_opencl_common_code);
-		sources[count] = pgstrom_opencl_common_code;
-		lengths[count] = common_code_length;
-		count++;
+		cl_uint			count;
+		uint32			build_gen;
+		bool			bin_loaded;
 
 		/*
-		 * Supplemental OpenCL Libraries
+		 * Mark the build is running, then construct a program object
+		 * without lock, because it may involve file i/o.
+		 * The generation identifies this build, to determine whether
+		 * the build is still owned by us on failure of clBuildProgram().
 		 */
+		dprog->build_running = true;
+		build_gen = ++dprog->build_gen;
+		if (message)
+			dlist_push_tail(&dprog->waitq, &message->chain);
+		SpinLockRelease(&dprog->lock);
 
-		/* opencl mathlib */
-		if (dprog->extra_flags & DEVFUNC_NEEDS_MATHLIB)
-		{
-			static size_t	mathlib_code_length = 0;
-
-			if (!mathlib_code_length)
-				mathlib_code_length = strlen(pgstrom_opencl_mathlib_code);
-			sources[count] = pgstrom_opencl_mathlib_code;
-            lengths[count] = mathlib_code_length;
-            count++;
-		}
-
-		/* opencl timelib */
-		if (dprog->extra_flags & DEVFUNC_NEEDS_TIMELIB)
-		{
-			static size_t	timelib_code_length = 0;
-
-			if (!timelib_code_length)
-				timelib_code_length = strlen(pgstrom_opencl_timelib_code);
-			sources[count] = pgstrom_opencl_timelib_code;
-			lengths[count] = timelib_code_length;
-			count++;
-		}
-
-		/* opencl textlib */
-		if (dprog->extra_flags & DEVFUNC_NEEDS_TEXTLIB)
-		{
-			static size_t	textlib_code_length = 0;
-
-			if (!textlib_code_length)
-				textlib_code_length = strlen(pgstrom_opencl_textlib_code);
-			sources[count] = pgstrom_opencl_textlib_code;
-			lengths[count] = textlib_code_length;
-			count++;
-		}
-
-		/* opencl numeric */
-		if (dprog->extra_flags & DEVFUNC_NEEDS_NUMERIC)
-		{
-			static size_t  numeric_code_length = 0;
-
-			if (!numeric_code_length)
-				numeric_code_length = strlen(pgstrom_opencl_numeric_code);
-			sources[count] = pgstrom_opencl_numeric_code;
-			lengths[count] = numeric_code_length;
-			count++;
-		}
+		count = clserv_devprog_sources(dprog, 0, sources, lengths);
+		clserv_devprog_build_options(dprog->extra_flags,
+									 build_opts, sizeof(build_opts));
 
 		/*
-		 * main logic for each GPU task (scan, sort, join)
+		 * Try to load the program binary being built on the previous
+		 * run, if any. Elsewhere, construct a program object from the
+		 * source.
 		 */
+		program = NULL;
+		dprog->bin_crc = clserv_devprog_binary_crc(sources, lengths, count,
+												   build_opts);
+		if (devprog_binary_cache)
+			program = clserv_devprog_load_binary(dprog);
+		bin_loaded = (program != NULL);
+		SpinLockAcquire(&dprog->lock);
+		dprog->bin_loaded = bin_loaded;
+		SpinLockRelease(&dprog->lock);
 
-		/* gpuscan device implementation */
-		if (dprog->extra_flags & DEVKERNEL_NEEDS_GPUSCAN)
-		{
-			static size_t	gpuscan_code_length = 0;
-
-			if (!gpuscan_code_length)
-				gpuscan_code_length = strlen(pgstrom_opencl_gpuscan_code);
-			sources[count] = pgstrom_opencl_gpuscan_code;
-			lengths[count] = gpuscan_code_length;
-			count++;
-		}
-		/* hashjoin device implementation */
-		if (dprog->extra_flags & DEVKERNEL_NEEDS_HASHJOIN)
-		{
-			static size_t	hashjoin_code_length = 0;
-
-			if (!hashjoin_code_length)
-				hashjoin_code_length = strlen(pgstrom_opencl_hashjoin_code);
-			sources[count] = pgstrom_opencl_hashjoin_code;
-			lengths[count] = hashjoin_code_length;
-			count++;
-		}
-		/* gpupreagg device implementation */
-		if (dprog->extra_flags & DEVKERNEL_NEEDS_GPUPREAGG)
+		/*
+		 * If the program needs the supplemental libraries being compiled
+		 * separately, link it with the library objects. It is already
+		 * built, so we can finish it immediately. Elsewhere, all the
+		 * source shall be built as usual.
+		 */
+		if (!program)
 		{
-			static size_t	gpupreagg_code_length = 0;
-
-			if (!gpupreagg_code_length)
-				gpupreagg_code_length = strlen(pgstrom_opencl_gpupreagg_code);
-			sources[count] = pgstrom_opencl_gpupreagg_code;
-			lengths[count] = gpupreagg_code_length;
-			count++;
+			program = clserv_devprog_link_program(dprog, build_opts);
+			if (program)
+			{
+				SpinLockAcquire(&dprog->lock);
+				dprog->program = program;
+				SpinLockRelease(&dprog->lock);
+				clserv_devprog_build_callback(program, dprog);
+				return NULL;
+			}
 		}
 
-		/* source code of this program */
-		sources[count] = dprog->source;
-		lengths[count] = dprog->source_len;
-		count++;
-
-		/* OK, construct a program object */
-		program = clCreateProgramWithSource(opencl_context,
-											count,
-											sources,
-											lengths,
-											&rc);
-		if (rc != CL_SUCCESS)
+		if (!program)
 		{
-			elog(LOG, "clCreateProgramWithSource failed: %s",
-				 opencl_strerror(rc));
-			dprog->program = BAD_OPENCL_PROGRAM;
-			goto out_unlock;
+			program = clCreateProgramWithSource(opencl_context,
+												count,
+												sources,
+												lengths,
+												&rc);
+			if (rc != CL_SUCCESS)
+			{
+				elog(LOG, "clCreateProgramWithSource failed: %s",
+					 opencl_strerror(rc));
+				SpinLockAcquire(&dprog->lock);
+				dprog->program = BAD_OPENCL_PROGRAM;
+				dprog->build_running = false;
+				clserv_devprog_requeue_waiters(dprog, false);
+				SpinLockRelease(&dprog->lock);
+				return NULL;
+			}
 		}
-		dprog->program = program;
-		dprog->build_running = true;
-		if (message)
-			dlist_push_tail(&dprog->waitq, &message->chain);
 
 		/*
 		 * NOTE: clBuildProgram() kicks kernel build asynchronously or
@@ -427,37 +1445,13 @@ clserv_lookup_device_program(Datum dprog_key, pgstrom_message *message)
 		 * Its callback function on build completion acquires the lock
 		 * of device-program, we have to release it prior to the call of
 		 * clBuildProgram().
+		 * Even if the program is loaded from the binary, clBuildProgram()
+		 * is still required, but it takes much less time.
 		 */
+		SpinLockAcquire(&dprog->lock);
+		dprog->program = program;
 		SpinLockRelease(&dprog->lock);
 
-		Assert(SIZEOF_VOID_P == 8 || SIZEOF_VOID_P == 4);
-		ofs = snprintf(build_opts, sizeof(build_opts),
-#ifdef PGSTROM_DEBUG
-					   " -Werror"
-#endif
-					   " -DOPENCL_DEVICE_CODE -DHOSTPTRLEN=%u -DBLCKSZ=%u"
-					   " -DITEMID_OFFSET_SHIFT=%u"
-					   " -DITEMID_FLAGS_SHIFT=%u"
-					   " -DITEMID_LENGTH_SHIFT=%u"
-					   " -DMAXIMUM_ALIGNOF=%u",
-					   SIZEOF_VOID_P, BLCKSZ,
-					   itemid_offset_shift,
-					   itemid_flags_shift,
-					   itemid_length_shift,
-					   MAXIMUM_ALIGNOF);
-		if (dprog->extra_flags & DEVKERNEL_DISABLE_OPTIMIZE)
-			ofs += snprintf(build_opts + ofs, sizeof(build_opts) - ofs,
-							" -cl-opt-disable");
-		if (dprog->extra_flags & DEVKERNEL_NEEDS_GPUSCAN)
-			ofs += snprintf(build_opts + ofs, sizeof(build_opts) - ofs,
-							" -DKERNEL_IS_GPUSCAN=1");
-		if (dprog->extra_flags & DEVKERNEL_NEEDS_HASHJOIN)
-			ofs += snprintf(build_opts + ofs, sizeof(build_opts) - ofs,
-                            " -DKERNEL_IS_HASHJOIN=1");
-		if (dprog->extra_flags & DEVKERNEL_NEEDS_GPUPREAGG)
-			ofs += snprintf(build_opts + ofs, sizeof(build_opts) - ofs,
-							" -DKERNEL_IS_GPUPREAGG=1");
-
 		rc = clBuildProgram(program,
 							opencl_num_devices,
 							opencl_devices,
@@ -466,8 +1460,6 @@ clserv_lookup_device_program(Datum dprog_key, pgstrom_message *message)
 							dprog);
 		if (rc != CL_SUCCESS)
 		{
-			dlist_mutable_iter iter;
-
 			clserv_log("clBuildProgram failed: %s", opencl_strerror(rc));
 
 			SpinLockAcquire(&dprog->lock);
@@ -481,91 +1473,625 @@ clserv_lookup_device_program(Datum dprog_key, pgstrom_message *message)
 			 * program.
 			 */
 
-			/*
-			 * NOTE: In case of synchronous build failure, program-build
-			 * callback is already called; that makes response message
-			 * with error code, so this message should be no longer handled
-			 * by OpenCL server. (This callback clears 'build_running').
-			 * In this case, we returns the caller NULL, to break its
-			 * cb_process handler immediately, without duplicated message
-			 * queuing.
-			 */
-			if (!dprog->build_running)
+			/*
+			 * NOTE: In case of synchronous build failure, program-build
+			 * callback is already called; that makes response message
+			 * with error code, so this message should be no longer handled
+			 * by OpenCL server. (This callback clears 'build_running').
+			 * Once the callback cleared it, other thread may already start
+			 * another build, so 'build_running' alone does not tell us
+			 * whether the build is still ours; the generation does.
+			 * In this case, we returns the caller NULL, to break its
+			 * cb_process handler immediately, without duplicated message
+			 * queuing.
+			 */
+			if (!dprog->build_running || dprog->build_gen != build_gen)
+			{
+				SpinLockRelease(&dprog->lock);
+				return NULL;
+			}
+			Assert(dprog->program == program);
+			SpinLockRelease(&dprog->lock);
+
+			/*
+			 * Callback is never called on asynchronous job input failure,
+			 * and nobody else starts a build while 'build_running' is set,
+			 * so we can forget the binary without lock, if the program came
+			 * from there.
+			 */
+			if (bin_loaded)
+				clserv_devprog_forget_binary(dprog);
+
+			/*
+			 * otherwise, all the waiting messages shall be enqueued again
+			 * to generate error response messages, or to build from the
+			 * source if it was loaded from the binary.
+			 */
+			SpinLockAcquire(&dprog->lock);
+			dprog->build_running = false;
+			dprog->program = (bin_loaded ? NULL : BAD_OPENCL_PROGRAM);
+			rc = clReleaseProgram(program);
+			Assert(rc == CL_SUCCESS);
+
+			clserv_devprog_requeue_waiters(dprog, true);
+			SpinLockRelease(&dprog->lock);
+		}
+		return NULL;
+	}
+	else if (dprog->program != BAD_OPENCL_PROGRAM)
+	{
+		cl_program	program;
+
+		/*
+		 * If valid program build process is still running, we chain the
+		 * message object onto waiting queue of this device program.
+		 */
+		if (dprog->build_running)
+		{
+			if (message)
+				dlist_push_tail(&dprog->waitq, &message->chain);
+			SpinLockRelease(&dprog->lock);
+			return NULL;
+		}
+
+		/* nealy zero seconds for kernel build, even if perfmon is enabled */
+		if (message->pfm.enabled)
+		{
+			gettimeofday(&tv, NULL);
+			message->pfm.time_kern_build
+				+= timeval_diff(&message->pfm.tv, &tv);
+		}
+
+		/*
+		 * Elsewhere, everything is OK to run required device kernel
+		 */
+		rc = clRetainProgram(dprog->program);
+		if (rc != CL_SUCCESS)
+		{
+			elog(LOG, "clRetainProgram failed: %s", opencl_strerror(rc));
+			goto out_unlock;
+		}
+		program = dprog->program;
+		SpinLockRelease(&dprog->lock);
+		return program;
+	}
+out_unlock:
+	SpinLockRelease(&dprog->lock);
+
+	return BAD_OPENCL_PROGRAM;
+}
+
+/*
+ * clserv_lookup_device_kernel
+ *
+ * It returns a kernel object of the supplied name on the device program
+ * being already built, from the cache of the current server thread.
+ * If not cached yet, it creates a new one and keeps it for later chunks.
+ * The returned object is retained, so caller has to release it using
+ * clReleaseKernel() as if it is created by clCreateKernel(), but it is
+ * just a decrement of reference counter.
+ * Note that caller must set all the kernel arguments prior to enqueue
+ * the kernel, because other chunks share the kernel object.
+ */
+cl_kernel
+clserv_lookup_device_kernel(Datum dprog_key, const char *kernel_name,
+							cl_int *errcode_ret)
+{
+	devprog_entry  *dprog = (devprog_entry *)DatumGetPointer(dprog_key);
+	devprog_kernel_cache *kcache;
+	cl_kernel		kernel;
+	cl_int			i, rc;
+
+	Assert(pgstrom_i_am_clserv);
+	Assert(dprog->program && dprog->program != BAD_OPENCL_PROGRAM);
+	Assert(strlen(kernel_name) < NAMEDATALEN);
+
+	/* not a server thread, so no cache is available */
+	if (clserv_thread_index < 0 || clserv_thread_index >= opencl_num_threads)
+		return clCreateKernel(dprog->program, kernel_name, errcode_ret);
+
+	if (!dprog->kcache)
+	{
+		devprog_kernel_cache *temp
+			= calloc(opencl_num_threads, sizeof(devprog_kernel_cache));
+
+		if (!temp)
+			return clCreateKernel(dprog->program, kernel_name, errcode_ret);
+
+		SpinLockAcquire(&dprog->lock);
+		if (!dprog->kcache)
+		{
+			dprog->kcache = temp;
+			temp = NULL;
+		}
+		SpinLockRelease(&dprog->lock);
+		if (temp)
+			free(temp);
+	}
+	kcache = &dprog->kcache[clserv_thread_index];
+
+	for (i=0; i < kcache->nitems; i++)
+	{
+		if (strcmp(kcache->items[i].kernel_name, kernel_name) == 0)
+		{
+			kernel = kcache->items[i].kernel;
+			rc = clRetainKernel(kernel);
+			*errcode_ret = rc;
+			return (rc == CL_SUCCESS ? kernel : NULL);
+		}
+	}
+
+	/* not found, so create a new one */
+	kernel = clCreateKernel(dprog->program, kernel_name, &rc);
+	if (rc != CL_SUCCESS)
+	{
+		*errcode_ret = rc;
+		return NULL;
+	}
+
+	/* if cache is full, replace an older one */
+	if (kcache->nitems < DEVPROG_KERNEL_CACHE_SIZE)
+		i = kcache->nitems++;
+	else
+	{
+		i = kcache->next_victim++ % DEVPROG_KERNEL_CACHE_SIZE;
+		clReleaseKernel(kcache->items[i].kernel);
+	}
+	strcpy(kcache->items[i].kernel_name, kernel_name);
+	kcache->items[i].kernel = kernel;
+	kcache->items[i].wgtune_dindex = -1;
+	kcache->items[i].wgtune_lwork_sz = 0;
+
+	*errcode_ret = clRetainKernel(kernel);
+	return kernel;
+}
+
+/*
+ * clserv_wgtune_lookup
+ *
+ * It looks up the autotuner entry for the supplied program, kernel and
+ * device. If not found and 'create' is true, it assigns a free slot, or
+ * reuses the slot of another kernel being already tuned.
+ * Caller must hold wgtune_lock.
+ */
+static int
+clserv_wgtune_lookup(pg_crc32 crc, const char *kernel_name, int dindex,
+					 bool create)
+{
+	wgtune_entry   *entry;
+	pg_crc32		hash;
+	int				i, index;
+	int				victim = -1;
+
+	INIT_CRC32(hash);
+	COMP_CRC32(hash, &crc, sizeof(pg_crc32));
+	COMP_CRC32(hash, &dindex, sizeof(int));
+	COMP_CRC32(hash, kernel_name, strlen(kernel_name));
+	FIN_CRC32(hash);
+
+	for (i=0; i < WGTUNE_MAX_PROBES; i++)
+	{
+		index = (hash + i) % WGTUNE_NUM_SLOTS;
+		entry = &opencl_devprog_shm_values->wgtune[index];
+
+		if (entry->kernel_name[0] == '\0')
+		{
+			if (victim < 0)
+				victim = index;
+			continue;
+		}
+		if (entry->crc == crc &&
+			entry->dindex == dindex &&
+			strcmp(entry->kernel_name, kernel_name) == 0)
+			return index;
+		if (victim < 0 && entry->lwork_best > 0)
+			victim = index;
+	}
+	if (!create || victim < 0)
+		return -1;
+
+	entry = &opencl_devprog_shm_values->wgtune[victim];
+	entry->crc = crc;
+	entry->dindex = dindex;
+	entry->generation++;
+	strncpy(entry->kernel_name, kernel_name, NAMEDATALEN);
+	entry->kernel_name[NAMEDATALEN - 1] = '\0';
+	entry->lwork_best = 0;
+	entry->num_cands = 0;
+	memset(entry->cands, 0, sizeof(entry->cands));
+
+	return victim;
+}
+
+/*
+ * clserv_wgtune_load
+ *
+ * It loads the results of autotuning on the previous run, if any. Results
+ * are applied only when the device of the same index has the same name.
+ */
+static void
+clserv_wgtune_load(void)
+{
+	FILE	   *filp;
+	char		linebuf[NAMEDATALEN + 512];
+	char		kernel_name[NAMEDATALEN];
+	unsigned int crc;
+	int			dindex;
+	size_t		lwork_sz;
+	int			ofs, index;
+	char	   *dev_name;
+
+	if (!devprog_binary_cache)
+		return;
+
+	filp = fopen(DEVPROG_WGTUNE_FILE, "r");
+	if (!filp)
+	{
+		if (errno != ENOENT)
+			clserv_log("failed to open \"%s\": %m", DEVPROG_WGTUNE_FILE);
+		return;
+	}
+
+	while (fgets(linebuf, sizeof(linebuf), filp) != NULL)
+	{
+		if (sscanf(linebuf, "%x %d %zu %63s %n",
+				   &crc, &dindex, &lwork_sz, kernel_name, &ofs) != 4 ||
+			dindex < 0 || dindex >= opencl_num_devices ||
+			lwork_sz == 0 || (lwork_sz & (lwork_sz - 1)) != 0)
+			continue;
+		dev_name = linebuf + ofs;
+		dev_name[strcspn(dev_name, "\n")] = '\0';
+		if (strcmp(dev_name, pgstrom_get_device_info(dindex)->dev_name) != 0)
+			continue;
+
+		SpinLockAcquire(&opencl_devprog_shm_values->wgtune_lock);
+		index = clserv_wgtune_lookup((pg_crc32) crc, kernel_name,
+									 dindex, true);
+		if (index >= 0)
+			opencl_devprog_shm_values->wgtune[index].lwork_best = lwork_sz;
+		SpinLockRelease(&opencl_devprog_shm_values->wgtune_lock);
+	}
+	fclose(filp);
+}
+
+/*
+ * clserv_wgtune_save
+ *
+ * It writes out the results of autotuning being already determined, if
+ * autotuner determined new ones since the last save. Server threads call
+ * it when they have no messages to be processed, so file i/o is never
+ * done on the event callback of OpenCL runtime.
+ */
+void
+clserv_wgtune_save(void)
+{
+	static pthread_mutex_t save_lock = PTHREAD_MUTEX_INITIALIZER;
+	wgtune_entry   *entries;
+	FILE		   *filp;
+	char			temp[MAXPGPATH];
+	int				i, nitems = 0;
+
+	if (!opencl_devprog_shm_values->wgtune_dirty)
+		return;
+
+	entries = malloc(sizeof(wgtune_entry) * WGTUNE_NUM_SLOTS);
+	if (!entries)
+		return;
+
+	SpinLockAcquire(&opencl_devprog_shm_values->wgtune_lock);
+	if (!opencl_devprog_shm_values->wgtune_dirty)
+	{
+		SpinLockRelease(&opencl_devprog_shm_values->wgtune_lock);
+		free(entries);
+		return;
+	}
+	opencl_devprog_shm_values->wgtune_dirty = false;
+	for (i=0; i < WGTUNE_NUM_SLOTS; i++)
+	{
+		wgtune_entry   *entry = &opencl_devprog_shm_values->wgtune[i];
+
+		if (entry->kernel_name[0] != '\0' && entry->lwork_best > 0)
+			memcpy(&entries[nitems++], entry, sizeof(wgtune_entry));
+	}
+	SpinLockRelease(&opencl_devprog_shm_values->wgtune_lock);
+
+	pthread_mutex_lock(&save_lock);
+	if (mkdir(DEVPROG_BINARY_CACHE_DIR, S_IRWXU) != 0 && errno != EEXIST)
+	{
+		clserv_log("failed to create directory \"%s\": %m",
+				   DEVPROG_BINARY_CACHE_DIR);
+		goto out;
+	}
+	snprintf(temp, sizeof(temp), "%s.%d", DEVPROG_WGTUNE_FILE, MyProcPid);
+	filp = fopen(temp, "w");
+	if (!filp)
+	{
+		clserv_log("failed to open \"%s\": %m", temp);
+		goto out;
+	}
+	for (i=0; i < nitems; i++)
+	{
+		fprintf(filp, "%08x %d %zu %s %s\n",
+				(unsigned int) entries[i].crc,
+				entries[i].dindex,
+				entries[i].lwork_best,
+				entries[i].kernel_name,
+				pgstrom_get_device_info(entries[i].dindex)->dev_name);
+	}
+	if (fclose(filp) != 0 || rename(temp, DEVPROG_WGTUNE_FILE) != 0)
+	{
+		clserv_log("failed to write \"%s\": %m", temp);
+		unlink(temp);
+	}
+out:
+	pthread_mutex_unlock(&save_lock);
+	free(entries);
+}
+
+/*
+ * clserv_wgtune_choose
+ *
+ * It returns a local workgroup size to be used for the supplied kernel.
+ * Once the autotuner determined the best one, it is returned. Elsewhere,
+ * it returns one of the candidates being sampled least; that are power
+ * of two between min_lwork_sz and max_lwork_sz, and informs the caller
+ * the ticket to feedback its execution time.
+ * The kernel is identified by 'kernel' being looked up by
+ * clserv_lookup_device_kernel(), or 'kernel_name' if kernel is NULL.
+ * Once tuned, the result is kept on the per-thread kernel cache, so the
+ * later launches don't need to acquire wgtune_lock.
+ * If autotuning is not available, it returns lwork_sz as is.
+ */
+size_t
+clserv_wgtune_choose(clserv_wgtune *wgtune,
+					 Datum dprog_key,
+					 cl_kernel kernel,
+					 const char *kernel_name,
+					 int dindex,
+					 size_t min_lwork_sz,
+					 size_t max_lwork_sz,
+					 size_t lwork_sz,
+					 size_t num_threads)
+{
+	static pthread_once_t wgtune_load_once = PTHREAD_ONCE_INIT;
+	devprog_entry  *dprog = (devprog_entry *) DatumGetPointer(dprog_key);
+	devprog_kernel_cache *kcache = NULL;
+	wgtune_entry   *entry;
+	char			namebuf[NAMEDATALEN];
+	size_t			result = lwork_sz;
+	int				index;
+	int				item = -1;
+	cl_uint			i, k;
+	cl_int			rc;
+
+	Assert(pgstrom_i_am_clserv);
+	Assert(kernel != NULL || kernel_name != NULL);
+	wgtune->index = -1;
+	if (!devprog_wgtune_enabled || !dprog || num_threads == 0)
+		return lwork_sz;
+
+	/* fast path; the kernel is already tuned on the device */
+	if (dprog->kcache &&
+		clserv_thread_index >= 0 && clserv_thread_index < opencl_num_threads)
+	{
+		kcache = &dprog->kcache[clserv_thread_index];
+		for (i=0; i < kcache->nitems; i++)
+		{
+			if (kernel ? kcache->items[i].kernel == kernel
+				: strcmp(kcache->items[i].kernel_name, kernel_name) == 0)
 			{
-				Assert(dlist_is_empty(&dprog->waitq));
-				SpinLockRelease(&dprog->lock);
-				return NULL;
+				item = i;
+				break;
 			}
-
-			/*
-			 * otherwise, all the waiting messages shall be enqueued again
-			 * to generate error response messages.
-			 */
-			dprog->build_running = false;
-			dprog->program = BAD_OPENCL_PROGRAM;
-			rc = clReleaseProgram(program);
-			Assert(rc == CL_SUCCESS);
-
-			dlist_foreach_modify(iter, &dprog->waitq)
+		}
+		if (item >= 0)
+		{
+			if (kcache->items[item].wgtune_dindex == dindex &&
+				kcache->items[item].wgtune_lwork_sz > 0)
 			{
-				pgstrom_message *msg
-					= dlist_container(pgstrom_message, chain, iter.cur);
-
-				dlist_delete(&msg->chain);
-				if (msg->pfm.enabled)
-				{
-					gettimeofday(&tv, NULL);
-					msg->pfm.time_kern_build
-						+= timeval_diff(&msg->pfm.tv, &tv);
-					gettimeofday(&msg->pfm.tv, NULL);
-				}
-				pgstrom_enqueue_message(msg);
+				result = kcache->items[item].wgtune_lwork_sz;
+				return (result <= max_lwork_sz ? result : lwork_sz);
 			}
-			goto out_unlock;
+			kernel_name = kcache->items[item].kernel_name;
 		}
-		return NULL;
 	}
-	else if (dprog->program != BAD_OPENCL_PROGRAM)
+	if (!kernel_name)
 	{
-		cl_program	program;
+		rc = clGetKernelInfo(kernel,
+							 CL_KERNEL_FUNCTION_NAME,
+							 sizeof(namebuf),
+							 namebuf,
+							 NULL);
+		if (rc != CL_SUCCESS)
+			return lwork_sz;
+		kernel_name = namebuf;
+	}
 
-		/*
-		 * If valid program build process is still running, we chain the
-		 * message object onto waiting queue of this device program.
-		 */
-		if (dprog->build_running)
+	pthread_once(&wgtune_load_once, clserv_wgtune_load);
+
+	SpinLockAcquire(&opencl_devprog_shm_values->wgtune_lock);
+	index = clserv_wgtune_lookup(dprog->crc, kernel_name, dindex, true);
+	if (index < 0)
+		goto out_unlock;
+	entry = &opencl_devprog_shm_values->wgtune[index];
+
+	/* already tuned */
+	if (entry->lwork_best > 0)
+	{
+		if (item >= 0)
 		{
-			if (message)
-				dlist_push_tail(&dprog->waitq, &message->chain);
-			SpinLockRelease(&dprog->lock);
-			return NULL;
+			kcache->items[item].wgtune_dindex = dindex;
+			kcache->items[item].wgtune_lwork_sz = entry->lwork_best;
 		}
+		if (entry->lwork_best <= max_lwork_sz)
+			result = entry->lwork_best;
+		goto out_unlock;
+	}
 
-		/* nealy zero seconds for kernel build, even if perfmon is enabled */
-		if (message->pfm.enabled)
+	/* set up candidates on the first execution */
+	if (entry->num_cands == 0)
+	{
+		size_t	sz;
+
+		for (sz = min_lwork_sz;
+			 sz <= max_lwork_sz && entry->num_cands < WGTUNE_MAX_CANDIDATES;
+			 sz *= 2)
+			entry->cands[entry->num_cands++].lwork_sz = sz;
+		/* nothing to be tuned */
+		if (entry->num_cands < 2)
 		{
-			gettimeofday(&tv, NULL);
-			message->pfm.time_kern_build
-				+= timeval_diff(&message->pfm.tv, &tv);
+			entry->lwork_best = lwork_sz;
+			goto out_unlock;
+		}
+	}
+
+	/*
+	 * pick up the candidate being launched least, among the ones being
+	 * acceptable for this launch. The oversized ones are marked as
+	 * exhausted, so they never prevent the autotuner from convergence.
+	 */
+	for (i=0, k=entry->num_cands; i < entry->num_cands; i++)
+	{
+		if (entry->cands[i].lwork_sz > max_lwork_sz)
+		{
+			entry->cands[i].nlaunched = Max(entry->cands[i].nlaunched,
+											2 * WGTUNE_NUM_SAMPLES);
+			continue;
 		}
+		if (k == entry->num_cands ||
+			entry->cands[i].nlaunched < entry->cands[k].nlaunched)
+			k = i;
+	}
+	if (k < entry->num_cands)
+	{
+		entry->cands[k].nlaunched++;
+		result = entry->cands[k].lwork_sz;
+		wgtune->index = index;
+		wgtune->generation = entry->generation;
+		wgtune->cand = k;
+		wgtune->num_threads = num_threads;
+	}
+out_unlock:
+	SpinLockRelease(&opencl_devprog_shm_values->wgtune_lock);
+
+	return result;
+}
+
+/*
+ * clserv_wgtune_callback
+ *
+ * It accounts the execution time of the kernel(s) on the candidate being
+ * sampled, then determines the best one once all the candidates have
+ * enough samples.
+ */
+typedef struct {
+	clserv_wgtune	wgtune;
+	cl_event		ev_begin;
+	cl_event		ev_end;
+} wgtune_sample;
+
+static void
+clserv_wgtune_callback(cl_event event, cl_int ev_status, void *private)
+{
+	wgtune_sample  *sample = private;
+	clserv_wgtune  *wgtune = &sample->wgtune;
+	wgtune_entry   *entry;
+	cl_ulong		tv_begin;
+	cl_ulong		tv_end;
+	cl_uint			i, k;
+
+	if (ev_status != CL_COMPLETE ||
+		clGetEventProfilingInfo(sample->ev_begin,
+								CL_PROFILING_COMMAND_START,
+								sizeof(cl_ulong),
+								&tv_begin,
+								NULL) != CL_SUCCESS ||
+		clGetEventProfilingInfo(sample->ev_end,
+								CL_PROFILING_COMMAND_END,
+								sizeof(cl_ulong),
+								&tv_end,
+								NULL) != CL_SUCCESS ||
+		tv_end < tv_begin)
+		goto out;
+
+	SpinLockAcquire(&opencl_devprog_shm_values->wgtune_lock);
+	entry = &opencl_devprog_shm_values->wgtune[wgtune->index];
+	if (entry->generation == wgtune->generation && entry->lwork_best == 0)
+	{
+		entry->cands[wgtune->cand].nsamples++;
+		entry->cands[wgtune->cand].nsec_per_thread
+			+= (double)(tv_end - tv_begin) / (double)wgtune->num_threads;
 
 		/*
-		 * Elsewhere, everything is OK to run required device kernel
+		 * Candidates that never completed (e.g, launch failure) are
+		 * ignored once they are launched twice as much as expected.
 		 */
-		rc = clRetainProgram(dprog->program);
-		if (rc != CL_SUCCESS)
+		for (i=0, k=wgtune->cand; i < entry->num_cands; i++)
 		{
-			elog(LOG, "clRetainProgram failed: %s", opencl_strerror(rc));
-			goto out_unlock;
+			cl_uint		nsamples = entry->cands[i].nsamples;
+
+			if (nsamples < WGTUNE_NUM_SAMPLES &&
+				entry->cands[i].nlaunched < 2 * WGTUNE_NUM_SAMPLES)
+				break;
+			if (nsamples > 0 &&
+				entry->cands[i].nsec_per_thread / nsamples <
+				entry->cands[k].nsec_per_thread / entry->cands[k].nsamples)
+				k = i;
+		}
+		if (i == entry->num_cands)
+		{
+			entry->lwork_best = entry->cands[k].lwork_sz;
+			/* server thread shall save it, not this callback */
+			if (devprog_binary_cache)
+				opencl_devprog_shm_values->wgtune_dirty = true;
 		}
-		program = dprog->program;
-		SpinLockRelease(&dprog->lock);
-		return program;
 	}
-out_unlock:
-	SpinLockRelease(&dprog->lock);
+	SpinLockRelease(&opencl_devprog_shm_values->wgtune_lock);
+out:
+	clReleaseEvent(sample->ev_begin);
+	clReleaseEvent(sample->ev_end);
+	free(sample);
+}
 
-	return BAD_OPENCL_PROGRAM;
+/*
+ * clserv_wgtune_feedback
+ *
+ * It registers a callback to collect the execution time of the kernel(s)
+ * launched with the local workgroup size being sampled, from the start of
+ * ev_begin to the end of ev_end. Nothing to do, if not sampled.
+ */
+void
+clserv_wgtune_feedback(clserv_wgtune *wgtune,
+					   cl_event ev_begin, cl_event ev_end)
+{
+	wgtune_sample  *sample;
+	cl_int			rc;
+
+	if (wgtune->index < 0)
+		return;
+
+	sample = malloc(sizeof(wgtune_sample));
+	if (!sample)
+		return;
+	sample->wgtune = *wgtune;
+	sample->ev_begin = ev_begin;
+	sample->ev_end = ev_end;
+	clRetainEvent(ev_begin);
+	clRetainEvent(ev_end);
+
+	rc = clSetEventCallback(ev_end,
+							CL_COMPLETE,
+							clserv_wgtune_callback,
+							sample);
+	if (rc != CL_SUCCESS)
+	{
+		clserv_log("failed on clSetEventCallback: %s", opencl_strerror(rc));
+		clReleaseEvent(ev_begin);
+		clReleaseEvent(ev_end);
+		free(sample);
+	}
+	/* only once per launch */
+	wgtune->index = -1;
 }
 
 /*
@@ -581,8 +2107,9 @@ Datum
 pgstrom_get_devprog_key(const char *source, int32 extra_flags)
 {
 	devprog_entry *dprog = NULL;
+	devprog_shard *shard;
 	Size		source_len = strlen(source);
-	Size		alloc_len;
+	Size		alloc_len = offsetof(devprog_entry, source[source_len + 1]);
 	int			index;
 	dlist_iter	iter;
 	pg_crc32	crc;
@@ -593,9 +2120,10 @@ pgstrom_get_devprog_key(const char *source, int32 extra_flags)
 	COMP_CRC32(crc, source, source_len);
 	FIN_CRC32(crc);
 
-retry:
 	index = crc % DEVPROG_HASH_SIZE;
-	SpinLockAcquire(&opencl_devprog_shm_values->lock);
+	shard = &opencl_devprog_shm_values->shards[DEVPROG_SHARD(crc)];
+retry:
+	SpinLockAcquire(&shard->lock);
 	dlist_foreach (iter, &opencl_devprog_shm_values->slot[index])
 	{
 		devprog_entry *entry
@@ -606,14 +2134,12 @@ retry:
 			entry->source_len == source_len &&
 			strcmp(entry->source, source) == 0)
 		{
-			dlist_move_head(&opencl_devprog_shm_values->lru_list,
-							&entry->lru_chain);
-			SpinLockAcquire(&entry->lock);
+			dlist_move_head(&shard->lru_list, &entry->lru_chain);
 			entry->refcnt++;
-			SpinLockRelease(&entry->lock);
-			SpinLockRelease(&opencl_devprog_shm_values->lock);
+			SpinLockRelease(&shard->lock);
 			if (dprog)
 				pgstrom_shmem_free(dprog);
+			__sync_fetch_and_add(&opencl_devprog_shm_values->num_hits, 1);
 
 			return PointerGetDatum(entry);
 		}
@@ -628,16 +2154,16 @@ retry:
 	{
 		dlist_push_tail(&opencl_devprog_shm_values->slot[index],
 						&dprog->hash_chain);
-		dlist_push_head(&opencl_devprog_shm_values->lru_list,
-						&dprog->lru_chain);
-		SpinLockRelease(&opencl_devprog_shm_values->lock);
+		dlist_push_head(&shard->lru_list, &dprog->lru_chain);
+		SpinLockRelease(&shard->lock);
+		__sync_fetch_and_add(&opencl_devprog_shm_values->usage, alloc_len);
+		__sync_fetch_and_add(&opencl_devprog_shm_values->num_misses, 1);
 
 		return PointerGetDatum(dprog);
 	}
-	SpinLockRelease(&opencl_devprog_shm_values->lock);
+	SpinLockRelease(&shard->lock);
 
 	/* OK, create a new device program entry */
-	alloc_len = offsetof(devprog_entry, source[source_len + 1]);
 	dprog = pgstrom_shmem_alloc(alloc_len);
 	if (!dprog)
 		elog(ERROR, "out of shared memory");
@@ -647,13 +2173,16 @@ retry:
 	dprog->refcnt = 1;
 	dlist_init(&dprog->waitq);
 	dprog->program = NULL;
+	dprog->kcache = NULL;
 	dprog->build_running = false;
+	dprog->bin_loaded = false;
+	dprog->build_gen = 0;
+	dprog->bin_crc = 0;
     dprog->errmsg = NULL;
 	dprog->crc = crc;
 	dprog->extra_flags = extra_flags;
 	dprog->source_len = source_len;
 	strcpy(dprog->source, source);
-	opencl_devprog_shm_values->usage += alloc_len;
 
 	goto retry;
 }
@@ -670,11 +2199,13 @@ void
 pgstrom_put_devprog_key(Datum dprog_key)
 {
 	devprog_entry  *dprog = (devprog_entry *) DatumGetPointer(dprog_key);
+	devprog_shard  *shard
+		= &opencl_devprog_shm_values->shards[DEVPROG_SHARD(dprog->crc)];
 
-	SpinLockAcquire(&opencl_devprog_shm_values->lock);
+	SpinLockAcquire(&shard->lock);
 	dprog->refcnt--;
 	Assert(dprog->refcnt >= 0);
-	SpinLockRelease(&opencl_devprog_shm_values->lock);
+	SpinLockRelease(&shard->lock);
 }
 
 /*
@@ -687,15 +2218,154 @@ Datum
 pgstrom_retain_devprog_key(Datum dprog_key)
 {
 	devprog_entry  *dprog = (devprog_entry *) DatumGetPointer(dprog_key);
+	devprog_shard  *shard
+		= &opencl_devprog_shm_values->shards[DEVPROG_SHARD(dprog->crc)];
 
-	SpinLockAcquire(&opencl_devprog_shm_values->lock);
+	SpinLockAcquire(&shard->lock);
 	Assert(dprog->refcnt >= 0);
 	dprog->refcnt++;
-	SpinLockRelease(&opencl_devprog_shm_values->lock);
+	SpinLockRelease(&shard->lock);
 
 	return dprog_key;
 }
 
+/*
+ * pgstrom_devprog_prebuild
+ *
+ * A message to kick build of the device program speculatively, prior to
+ * the first chunk; that allows to overlap the build with loading of the
+ * first chunk.
+ */
+typedef struct {
+	pgstrom_message	msg;		/* = StromTag_DevProgBuild */
+	Datum		dprog_key;		/* key of the device program to be built */
+	bool		build_done;		/* true, if build is finished */
+} pgstrom_devprog_prebuild;
+
+/*
+ * clserv_process_devprog_prebuild
+ *
+ * It just looks up the device program; that kicks the build if nobody did
+ * it yet. Its time_kern_build accumulates the time to build.
+ */
+static void
+clserv_process_devprog_prebuild(pgstrom_message *msg)
+{
+	pgstrom_devprog_prebuild *prebuild = (pgstrom_devprog_prebuild *) msg;
+	cl_program		program;
+	cl_int			rc;
+
+	program = clserv_lookup_device_program(prebuild->dprog_key, msg);
+	if (!program)
+		return;		/* message is in waitq, retry it! */
+	if (program != BAD_OPENCL_PROGRAM)
+	{
+		rc = clReleaseProgram(program);
+		Assert(rc == CL_SUCCESS);
+	}
+	else
+		msg->errcode = CL_BUILD_PROGRAM_FAILURE;
+
+	SpinLockAcquire(&msg->lock);
+	prebuild->build_done = true;
+	SpinLockRelease(&msg->lock);
+
+	/* nobody waits for the response, so it is just released */
+	pgstrom_reply_message(msg);
+}
+
+/*
+ * pgstrom_release_devprog_prebuild
+ *
+ * Callback handler when reference counter of the prebuild message reached
+ * to zero. It may be called by either of OpenCL server or backend.
+ */
+static void
+pgstrom_release_devprog_prebuild(pgstrom_message *msg)
+{
+	pgstrom_devprog_prebuild *prebuild = (pgstrom_devprog_prebuild *) msg;
+
+	if (msg->respq)
+		pgstrom_put_queue(msg->respq);
+	pgstrom_put_devprog_key(prebuild->dprog_key);
+	pgstrom_shmem_free(prebuild);
+}
+
+/*
+ * pgstrom_prebuild_devprog
+ *
+ * It enqueues a message to build the device program speculatively, then
+ * returns the message to be tracked by the caller, or NULL if the program
+ * is already built or under the build. It is not a fatal error even if
+ * we cannot enqueue it, because the first chunk will build the program.
+ * The message has its own response queue being already closed, so it is
+ * scheduled apart from the chunks, and nobody needs to receive it.
+ */
+pgstrom_message *
+pgstrom_prebuild_devprog(Datum dprog_key)
+{
+	devprog_entry  *dprog = (devprog_entry *) DatumGetPointer(dprog_key);
+	pgstrom_devprog_prebuild *prebuild;
+	pgstrom_queue  *mqueue;
+	bool			needs_build;
+
+	SpinLockAcquire(&dprog->lock);
+	needs_build = (!dprog->program && !dprog->build_running);
+	SpinLockRelease(&dprog->lock);
+	if (!needs_build)
+		return NULL;
+
+	mqueue = pgstrom_create_queue();
+	prebuild = pgstrom_shmem_alloc(sizeof(pgstrom_devprog_prebuild));
+	if (!prebuild)
+	{
+		pgstrom_close_queue(mqueue);
+		return NULL;
+	}
+	pgstrom_init_message(&prebuild->msg,
+						 StromTag_DevProgBuild,
+						 mqueue,
+						 clserv_process_devprog_prebuild,
+						 pgstrom_release_devprog_prebuild,
+						 true);
+	pgstrom_close_queue(mqueue);
+	prebuild->dprog_key = pgstrom_retain_devprog_key(dprog_key);
+	prebuild->build_done = false;
+
+	if (!pgstrom_enqueue_message(&prebuild->msg))
+	{
+		pgstrom_put_message(&prebuild->msg);
+		return NULL;
+	}
+	return &prebuild->msg;
+}
+
+/*
+ * pgstrom_perfmon_prebuild
+ *
+ * It sets the time of the speculative build being hidden behind the load
+ * of the first chunk; that is the time to build except for the time the
+ * chunks actually waited for the build.
+ */
+void
+pgstrom_perfmon_prebuild(pgstrom_perfmon *pfm, pgstrom_message *msg)
+{
+	pgstrom_devprog_prebuild *prebuild = (pgstrom_devprog_prebuild *) msg;
+	cl_ulong	time_build = 0;
+
+	if (!pfm->enabled || !msg)
+		return;
+	Assert(StromTagIs(msg, DevProgBuild));
+
+	SpinLockAcquire(&msg->lock);
+	if (prebuild->build_done && msg->errcode == StromError_Success)
+		time_build = msg->pfm.time_kern_build;
+	SpinLockRelease(&msg->lock);
+
+	if (time_build > pfm->time_kern_build)
+		pfm->time_kern_prebuild = time_build - pfm->time_kern_build;
+}
+
 /*
  * pgstrom_get_devprog_errmsg
  *
@@ -711,10 +2381,9 @@ pgstrom_get_devprog_errmsg(Datum dprog_key)
 	devprog_entry  *dprog = (devprog_entry *) DatumGetPointer(dprog_key);
 	const char	   *errmsg;
 
-	SpinLockAcquire(&opencl_devprog_shm_values->lock);
-	Assert(dprog->refcnt >= 0);
+	SpinLockAcquire(&dprog->lock);
 	errmsg = dprog->errmsg;
-	SpinLockRelease(&opencl_devprog_shm_values->lock);
+	SpinLockRelease(&dprog->lock);
 
 	return errmsg;
 }
@@ -782,6 +2451,7 @@ pgstrom_opencl_program_info(PG_FUNCTION_ARGS)
 		TupleDesc		tupdesc;
 		MemoryContext	oldcxt;
 		List		   *dp_list = NIL;
+		int				i;
 
 		fncxt = SRF_FIRSTCALL_INIT();
 		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
@@ -805,14 +2475,16 @@ pgstrom_opencl_program_info(PG_FUNCTION_ARGS)
 						   TEXTOID, -1, 0);
 		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
 
-		SpinLockAcquire(&opencl_devprog_shm_values->lock);
-		PG_TRY();
+		for (i=0; i < DEVPROG_HASH_SIZE; i++)
 		{
-			dlist_iter	iter;
-			int			i;
+			devprog_shard  *shard = &opencl_devprog_shm_values->
+				shards[i % DEVPROG_NUM_SHARDS];
 
-			for (i=0; i < DEVPROG_HASH_SIZE; i++)
+			SpinLockAcquire(&shard->lock);
+			PG_TRY();
 			{
+				dlist_iter	iter;
+
 				dlist_foreach (iter, &opencl_devprog_shm_values->slot[i])
 				{
 					devprog_entry *entry
@@ -841,14 +2513,14 @@ pgstrom_opencl_program_info(PG_FUNCTION_ARGS)
 					dp_list = lappend(dp_list, dp_info);
 				}
 			}
+			PG_CATCH();
+			{
+				SpinLockRelease(&shard->lock);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+			SpinLockRelease(&shard->lock);
 		}
-		PG_CATCH();
-		{
-			SpinLockRelease(&opencl_devprog_shm_values->lock);
-			PG_RE_THROW();
-		}
-		PG_END_TRY();
-		SpinLockRelease(&opencl_devprog_shm_values->lock);
 
 		fncxt->user_fctx = dp_list;
 
@@ -887,6 +2559,148 @@ pgstrom_opencl_program_info(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_opencl_program_info);
 
+/*
+ * pgstrom_opencl_program_stat
+ *
+ * shows the cumulative counters of the whole program cache, as a row
+ */
+Datum
+pgstrom_opencl_program_stat(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[5];
+	bool		isnull[5];
+
+	tupdesc = CreateTemplateTupleDesc(5, false);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "usage",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "hits",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 3, "misses",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 4, "evicts",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 5, "link_fallbacks",
+					   INT8OID, -1, 0);
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = Int64GetDatum(opencl_devprog_shm_values->usage);
+	values[1] = Int64GetDatum(opencl_devprog_shm_values->num_hits);
+	values[2] = Int64GetDatum(opencl_devprog_shm_values->num_misses);
+	values[3] = Int64GetDatum(opencl_devprog_shm_values->num_evicts);
+	values[4] = Int64GetDatum(opencl_devprog_shm_values->num_link_fallbacks);
+
+	tuple = heap_form_tuple(tupdesc, values, isnull);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_opencl_program_stat);
+
+/*
+ * pgstrom_opencl_workgroup_info
+ *
+ * shows the status of workgroup size autotuner for each kernel
+ */
+Datum
+pgstrom_opencl_workgroup_info(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	wgtune_entry   *entry;
+	HeapTuple		tuple;
+	Datum			values[6];
+	bool			isnull[6];
+	StringInfoData	str;
+	char			buf[256];
+	int				index;
+	cl_uint			i;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc		tupdesc;
+		MemoryContext	oldcxt;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+
+		tupdesc = CreateTemplateTupleDesc(6, false);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "crc",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "kernel",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 3, "device",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 4, "state",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 5, "lwork_sz",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 6, "samples",
+						   TEXTOID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+
+		/* take a snapshot of the tuner entries */
+		entry = palloc(sizeof(wgtune_entry) * WGTUNE_NUM_SLOTS);
+		SpinLockAcquire(&opencl_devprog_shm_values->wgtune_lock);
+		memcpy(entry, opencl_devprog_shm_values->wgtune,
+			   sizeof(wgtune_entry) * WGTUNE_NUM_SLOTS);
+		SpinLockRelease(&opencl_devprog_shm_values->wgtune_lock);
+		fncxt->user_fctx = entry;
+		fncxt->max_calls = WGTUNE_NUM_SLOTS;
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+
+	/* skip free slots */
+	for (index = fncxt->call_cntr; index < fncxt->max_calls; index++)
+	{
+		entry = (wgtune_entry *) fncxt->user_fctx + index;
+		if (entry->kernel_name[0] != '\0')
+			break;
+	}
+	if (index >= fncxt->max_calls)
+		SRF_RETURN_DONE(fncxt);
+	fncxt->call_cntr = index;
+
+	memset(isnull, 0, sizeof(isnull));
+	snprintf(buf, sizeof(buf), "0x%08x", entry->crc);
+	values[0] = CStringGetTextDatum(buf);
+	values[1] = CStringGetTextDatum(entry->kernel_name);
+	values[2] = Int32GetDatum(entry->dindex);
+	values[3] = CStringGetTextDatum(entry->lwork_best > 0 ?
+									"tuned" : "tuning");
+	if (entry->lwork_best > 0)
+		values[4] = Int64GetDatum(entry->lwork_best);
+	else
+		isnull[4] = true;
+
+	/* average time per thread of each candidate */
+	initStringInfo(&str);
+	for (i=0; i < entry->num_cands; i++)
+	{
+		if (i > 0)
+			appendStringInfoChar(&str, ' ');
+		if (entry->cands[i].nsamples > 0)
+			appendStringInfo(&str, "%zu:%.3fns(%u)",
+							 entry->cands[i].lwork_sz,
+							 entry->cands[i].nsec_per_thread /
+							 (double) entry->cands[i].nsamples,
+							 entry->cands[i].nsamples);
+		else
+			appendStringInfo(&str, "%zu:-", entry->cands[i].lwork_sz);
+	}
+	if (entry->num_cands > 0)
+		values[5] = CStringGetTextDatum(str.data);
+	else
+		isnull[5] = true;
+
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_opencl_workgroup_info);
+
 /*
  * pgstrom_startup_opencl_devprog
  *
@@ -907,9 +2721,20 @@ pgstrom_startup_opencl_devprog(void)
 						  &found);
 	Assert(!found);
 
-	SpinLockInit(&opencl_devprog_shm_values->lock);
 	opencl_devprog_shm_values->usage = 0;
-	dlist_init(&opencl_devprog_shm_values->lru_list);
+	opencl_devprog_shm_values->num_hits = 0;
+	opencl_devprog_shm_values->num_misses = 0;
+	opencl_devprog_shm_values->num_evicts = 0;
+	opencl_devprog_shm_values->num_link_fallbacks = 0;
+	for (i=0; i < DEVPROG_NUM_SHARDS; i++)
+	{
+		SpinLockInit(&opencl_devprog_shm_values->shards[i].lock);
+		dlist_init(&opencl_devprog_shm_values->shards[i].lru_list);
+	}
+	SpinLockInit(&opencl_devprog_shm_values->wgtune_lock);
+	opencl_devprog_shm_values->wgtune_dirty = false;
+	memset(opencl_devprog_shm_values->wgtune, 0,
+		   sizeof(opencl_devprog_shm_values->wgtune));
 	for (i=0; i < DEVPROG_HASH_SIZE; i++)
 		dlist_init(&opencl_devprog_shm_values->slot[i]);
 }
@@ -935,6 +2760,48 @@ pgstrom_init_opencl_devprog(void)
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
 
+	/* save/load the built program binaries for the next run */
+	DefineCustomBoolVariable("pg_strom.devprog_binary_cache",
+							 "enables on-disk cache of device program binaries",
+							 NULL,
+							 &devprog_binary_cache,
+							 true,
+							 PGC_POSTMASTER,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/* max total size of the on-disk cache of program binaries */
+	DefineCustomIntVariable("pg_strom.devprog_binary_cache_size",
+							"max size of on-disk cache of program binaries",
+							"Binaries used least recently are removed once the cache exceeds this size. Zero means unlimited.",
+							&devprog_binary_cache_size,
+							262144,		/* 256MB */
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	/* compile supplemental libraries separately, then link them */
+	DefineCustomBoolVariable("pg_strom.devprog_separate_compile",
+							 "enables separate compile of device libraries",
+							 NULL,
+							 &devprog_separate_compile,
+							 true,
+							 PGC_POSTMASTER,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/* autotuning of workgroup size */
+	DefineCustomBoolVariable("pg_strom.workgroup_autotune",
+							 "enables autotuning of workgroup size",
+							 NULL,
+							 &devprog_wgtune_enabled,
+							 true,
+							 PGC_POSTMASTER,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
 	/* threshold to reclaim the cached opencl programs */
 	DefineCustomIntVariable("pg_strom.devprog_reclaim_threshold",
 							"threahold to reclaim device program objects",
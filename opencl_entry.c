@@ -868,6 +868,14 @@ static cl_program (*p_clCreateProgramWithSource)(
 	const char **strings,
 	const size_t *lengths,
 	cl_int *errcode_ret) = NULL;
+static cl_program (*p_clCreateProgramWithBinary)(
+	cl_context context,
+	cl_uint num_devices,
+	const cl_device_id *device_list,
+	const size_t *lengths,
+	const unsigned char **binaries,
+	cl_int *binary_status,
+	cl_int *errcode_ret) = NULL;
 static cl_int (*p_clRetainProgram)(cl_program program) = NULL;
 static cl_int (*p_clReleaseProgram)(cl_program program) = NULL;
 static cl_int (*p_clBuildProgram)(
@@ -879,6 +887,30 @@ static cl_int (*p_clBuildProgram)(
 		cl_program program,
 		void *user_data),
 	void *user_data) = NULL;
+static cl_int (*p_clCompileProgram)(
+	cl_program program,
+	cl_uint num_devices,
+	const cl_device_id *device_list,
+	const char *options,
+	cl_uint num_input_headers,
+	const cl_program *input_headers,
+	const char **header_include_names,
+	void (CL_CALLBACK *pfn_notify)(
+		cl_program program,
+		void *user_data),
+	void *user_data) = NULL;
+static cl_program (*p_clLinkProgram)(
+	cl_context context,
+	cl_uint num_devices,
+	const cl_device_id *device_list,
+	const char *options,
+	cl_uint num_input_programs,
+	const cl_program *input_programs,
+	void (CL_CALLBACK *pfn_notify)(
+		cl_program program,
+		void *user_data),
+	void *user_data,
+	cl_int *errcode_ret) = NULL;
 static cl_int (*p_clGetProgramInfo)(
 	cl_program program,
 	cl_program_info param_name,
@@ -907,6 +939,24 @@ clCreateProgramWithSource(cl_context context,
 										  errcode_ret);
 }
 
+cl_program
+clCreateProgramWithBinary(cl_context context,
+						  cl_uint num_devices,
+						  const cl_device_id *device_list,
+						  const size_t *lengths,
+						  const unsigned char **binaries,
+						  cl_int *binary_status,
+						  cl_int *errcode_ret)
+{
+	return (*p_clCreateProgramWithBinary)(context,
+										  num_devices,
+										  device_list,
+										  lengths,
+										  binaries,
+										  binary_status,
+										  errcode_ret);
+}
+
 cl_int
 clRetainProgram(cl_program program)
 {
@@ -937,6 +987,71 @@ clBuildProgram(cl_program program,
 							   user_data);
 }
 
+/*
+ * clCompileProgram and clLinkProgram are OpenCL 1.2 features, so they
+ * are not available on the older platforms.
+ */
+bool
+opencl_entry_has_linker(void)
+{
+	return (p_clCompileProgram != NULL && p_clLinkProgram != NULL);
+}
+
+cl_int
+clCompileProgram(cl_program program,
+				 cl_uint num_devices,
+				 const cl_device_id *device_list,
+				 const char *options,
+				 cl_uint num_input_headers,
+				 const cl_program *input_headers,
+				 const char **header_include_names,
+				 void (CL_CALLBACK *pfn_notify)(
+					 cl_program program,
+					 void *user_data),
+				 void *user_data)
+{
+	if (!p_clCompileProgram)
+		return CL_INVALID_OPERATION;
+	return (*p_clCompileProgram)(program,
+								 num_devices,
+								 device_list,
+								 options,
+								 num_input_headers,
+								 input_headers,
+								 header_include_names,
+								 pfn_notify,
+								 user_data);
+}
+
+cl_program
+clLinkProgram(cl_context context,
+			  cl_uint num_devices,
+			  const cl_device_id *device_list,
+			  const char *options,
+			  cl_uint num_input_programs,
+			  const cl_program *input_programs,
+			  void (CL_CALLBACK *pfn_notify)(
+				  cl_program program,
+				  void *user_data),
+			  void *user_data,
+			  cl_int *errcode_ret)
+{
+	if (!p_clLinkProgram)
+	{
+		*errcode_ret = CL_INVALID_OPERATION;
+		return NULL;
+	}
+	return (*p_clLinkProgram)(context,
+							  num_devices,
+							  device_list,
+							  options,
+							  num_input_programs,
+							  input_programs,
+							  pfn_notify,
+							  user_data,
+							  errcode_ret);
+}
+
 cl_int
 clGetProgramInfo(cl_program program,
 				 cl_program_info param_name,
@@ -1361,6 +1476,9 @@ lookup_opencl_function(void *handle, const char *func_name)
 
 #define LOOKUP_OPENCL_FUNCTION(func_name)		\
 	p_##func_name = lookup_opencl_function(handle, #func_name)
+/* same as above, but not an error if not found */
+#define LOOKUP_OPENCL_FUNCTION_OPTIONAL(func_name)	\
+	p_##func_name = dlsym(handle, #func_name)
 
 void
 pgstrom_init_opencl_entry(void)
@@ -1411,9 +1529,12 @@ pgstrom_init_opencl_entry(void)
 		LOOKUP_OPENCL_FUNCTION(clGetSamplerInfo);
 		/* Program Objects */
 		LOOKUP_OPENCL_FUNCTION(clCreateProgramWithSource);
+		LOOKUP_OPENCL_FUNCTION(clCreateProgramWithBinary);
 		LOOKUP_OPENCL_FUNCTION(clRetainProgram);
 		LOOKUP_OPENCL_FUNCTION(clReleaseProgram);
 		LOOKUP_OPENCL_FUNCTION(clBuildProgram);
+		LOOKUP_OPENCL_FUNCTION_OPTIONAL(clCompileProgram);
+		LOOKUP_OPENCL_FUNCTION_OPTIONAL(clLinkProgram);
 		LOOKUP_OPENCL_FUNCTION(clGetProgramInfo);
 		LOOKUP_OPENCL_FUNCTION(clGetProgramBuildInfo);
 		LOOKUP_OPENCL_FUNCTION(clCreateKernel);
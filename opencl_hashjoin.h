@@ -478,7 +478,8 @@ kern_gpuhashjoin_projection_row(__global kern_hashjoin *khashjoin,	/* in */
 
 	/* Ensure format of the kern_data_store (source/destination) */
 	if ((kds->format != KDS_FORMAT_ROW &&
-		 kds->format != KDS_FORMAT_ROW_FLAT) ||
+		 kds->format != KDS_FORMAT_ROW_FLAT &&
+		 kds->format != KDS_FORMAT_COLUMN) ||
 		kds_dest->format != KDS_FORMAT_ROW_FLAT)
 	{
 		STROM_SET_ERROR(&errcode, StromError_DataStoreCorruption);
@@ -724,7 +725,8 @@ kern_gpuhashjoin_projection_slot(__global kern_hashjoin *khashjoin,	/* in */
 		goto out;
 	/* Ensure format of the kern_data_store */
 	if ((kds->format != KDS_FORMAT_ROW &&
-		 kds->format != KDS_FORMAT_ROW_FLAT) ||
+		 kds->format != KDS_FORMAT_ROW_FLAT &&
+		 kds->format != KDS_FORMAT_COLUMN) ||
 		kds_dest->format != KDS_FORMAT_TUPSLOT)
 	{
 		STROM_SET_ERROR(&errcode, StromError_DataStoreCorruption);
@@ -748,7 +750,32 @@ kern_gpuhashjoin_projection_slot(__global kern_hashjoin *khashjoin,	/* in */
 		cl_uint					nattrs;
 		cl_bool					heap_hasnull;
 
-		if (depth == 0)
+		if (depth == 0 && kds->format == KDS_FORMAT_COLUMN)
+		{
+			/*
+			 * column-format has no heap-tuple to walk on, so we pick up
+			 * the columns being loaded individually. Varlena values are
+			 * on the arena of kds itself.
+			 */
+			baseaddr = (__global char *)&kds->hostptr;
+			hostaddr = kds->hostptr;
+			for (i=0; i < kds->ncols; i++)
+			{
+				if (kds->colmeta[i].cs_offset == 0)
+					continue;
+				datum = kern_get_datum_column(kds, i, rbuffer[0] - 1);
+				gpuhashjoin_projection_datum(&errcode,
+											 slot_values,
+											 slot_isnull,
+											 depth,
+											 i,
+											 hostaddr + ((uintptr_t) datum -
+														 (uintptr_t) baseaddr),
+											 datum);
+			}
+			continue;
+		}
+		else if (depth == 0)
 		{
 			ncols = kds->ncols;
 			p_colmeta = kds->colmeta;
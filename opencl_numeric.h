@@ -162,8 +162,9 @@ typedef struct {
 	 ((mant) & PG_NUMERIC_MANTISSA_MASK))
 
 #ifdef OPENCL_DEVICE_CODE
+#ifndef OPENCL_DEVICE_PROTOTYPE
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pg_numeric_from_varlena(__private int *errcode, __global varlena *vl_val)
 {
 	pg_numeric_t		result;
@@ -314,7 +315,7 @@ pg_numeric_from_varlena(__private int *errcode, __global varlena *vl_val)
  * to reference varlena variable. Otherwise, in case when attlen > 0, it
  * tries to fetch fixed-length variable.
  */
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pg_numeric_vref(__global kern_data_store *kds,
 				__global kern_data_store *ktoast,
 				__private int *errcode,
@@ -339,7 +340,7 @@ pg_numeric_vref(__global kern_data_store *kds,
 /* pg_numeric_vstore() is same as template */
 STROMCL_SIMPLE_VARSTORE_TEMPLATE(numeric, cl_ulong)
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pg_numeric_param(__global kern_parambuf *kparams,
 				 __private int *errcode,
 				 cl_uint param_id)
@@ -364,7 +365,7 @@ pg_numeric_param(__global kern_parambuf *kparams,
 
 
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_numeric_isnull(__private int *errcode,
 					pg_numeric_t arg)
 {
@@ -377,7 +378,7 @@ pgfn_numeric_isnull(__private int *errcode,
 
 
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_numeric_isnotnull(__private int *errcode,
 					   pg_numeric_t arg)
 {
@@ -396,7 +397,7 @@ pgfn_numeric_isnotnull(__private int *errcode,
  * Numeric format translation functions
  * ----------------------------------------------------------------
  */
-static pg_int8_t
+STROMCL_LIBFUNC pg_int8_t
 numeric_to_integer(__private int *errcode, pg_numeric_t arg, cl_int size)
 {
 	pg_int8_t	v;
@@ -463,7 +464,7 @@ numeric_to_integer(__private int *errcode, pg_numeric_t arg, cl_int size)
 
 
 
-static pg_float8_t
+STROMCL_LIBFUNC pg_float8_t
 numeric_to_float(__private int *errcode, pg_numeric_t arg)
 {
 	pg_float8_t	v;
@@ -504,7 +505,7 @@ numeric_to_float(__private int *errcode, pg_numeric_t arg)
 
 
 
-static pg_int2_t
+STROMCL_LIBFUNC pg_int2_t
 pgfn_numeric_int2(__private int *errcode, pg_numeric_t arg)
 {
 	pg_int2_t v;
@@ -518,7 +519,7 @@ pgfn_numeric_int2(__private int *errcode, pg_numeric_t arg)
 
 
 
-static pg_int4_t
+STROMCL_LIBFUNC pg_int4_t
 pgfn_numeric_int4(__private int *errcode, pg_numeric_t arg)
 {
 	pg_int4_t v;
@@ -532,7 +533,7 @@ pgfn_numeric_int4(__private int *errcode, pg_numeric_t arg)
 
 
 
-static pg_int8_t
+STROMCL_LIBFUNC pg_int8_t
 pgfn_numeric_int8(__private int *errcode, pg_numeric_t arg)
 {
 	pg_int8_t v;
@@ -541,7 +542,7 @@ pgfn_numeric_int8(__private int *errcode, pg_numeric_t arg)
 
 
 
-static pg_float4_t
+STROMCL_LIBFUNC pg_float4_t
 pgfn_numeric_float4(__private int *errcode, pg_numeric_t arg)
 {
 
@@ -559,7 +560,7 @@ pgfn_numeric_float4(__private int *errcode, pg_numeric_t arg)
 
 
 
-static pg_float8_t
+STROMCL_LIBFUNC pg_float8_t
 pgfn_numeric_float8(__private int *errcode, pg_numeric_t arg)
 {
 	return numeric_to_float(errcode, arg);
@@ -567,7 +568,7 @@ pgfn_numeric_float8(__private int *errcode, pg_numeric_t arg)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 integer_to_numeric(__private int *errcode, pg_int8_t arg, cl_int size)
 {
 	pg_numeric_t	v;
@@ -621,7 +622,7 @@ integer_to_numeric(__private int *errcode, pg_int8_t arg, cl_int size)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 float_to_numeric(__private int *errcode, pg_float8_t arg, int dig)
 {
 	pg_numeric_t	v;
@@ -737,7 +738,7 @@ float_to_numeric(__private int *errcode, pg_float8_t arg, int dig)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_int2_numeric(__private int *errcode, pg_int2_t arg)
 {
 	pg_int8_t tmp = { arg.value, arg.isnull };
@@ -746,7 +747,7 @@ pgfn_int2_numeric(__private int *errcode, pg_int2_t arg)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_int4_numeric(__private int *errcode, pg_int4_t arg)
 {
 	pg_int8_t tmp = { arg.value, arg.isnull };
@@ -755,7 +756,7 @@ pgfn_int4_numeric(__private int *errcode, pg_int4_t arg)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_int8_numeric(__private int *errcode, pg_int8_t arg)
 {
 	return integer_to_numeric(errcode, arg, sizeof(arg.value));
@@ -763,7 +764,7 @@ pgfn_int8_numeric(__private int *errcode, pg_int8_t arg)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_float4_numeric(__private int *errcode, pg_float4_t arg)
 {
 	pg_float8_t tmp = { (cl_double)arg.value, arg.isnull };
@@ -772,7 +773,7 @@ pgfn_float4_numeric(__private int *errcode, pg_float4_t arg)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_float8_numeric(__private int *errcode, pg_float8_t arg)
 {
 	return float_to_numeric(errcode, arg, DBL_DIG);
@@ -784,7 +785,7 @@ pgfn_float8_numeric(__private int *errcode, pg_float8_t arg)
  * Numeric operator functions
  * ----------------------------------------------------------------
  */
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_numeric_uplus(__private int *errcode, pg_numeric_t arg)
 {
 	/* return the value as-is */
@@ -793,7 +794,7 @@ pgfn_numeric_uplus(__private int *errcode, pg_numeric_t arg)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_numeric_uminus(__private int *errcode, pg_numeric_t arg)
 {
 	/* reverse the sign bit */
@@ -803,7 +804,7 @@ pgfn_numeric_uminus(__private int *errcode, pg_numeric_t arg)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_numeric_abs(__private int *errcode, pg_numeric_t arg)
 {
 	/* clear the sign bit */
@@ -813,7 +814,7 @@ pgfn_numeric_abs(__private int *errcode, pg_numeric_t arg)
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_numeric_add(__private int *errcode,
 				 pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -921,7 +922,7 @@ pgfn_numeric_add(__private int *errcode,
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_numeric_sub(__private int *errcode,
 				 pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -932,7 +933,7 @@ pgfn_numeric_sub(__private int *errcode,
 
 
 
-static pg_numeric_t
+STROMCL_LIBFUNC pg_numeric_t
 pgfn_numeric_mul(__private int *errcode,
 				 pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -1032,7 +1033,7 @@ pgfn_numeric_mul(__private int *errcode,
  * Numeric comparison functions
  * ----------------------------------------------------------------
  */
-static int
+STROMCL_LIBFUNC int
 numeric_cmp(__private cl_int *errcode, pg_numeric_t arg1, pg_numeric_t arg2)
 {
 	int			expo1 = PG_NUMERIC_EXPONENT(arg1.value);
@@ -1095,7 +1096,7 @@ numeric_cmp(__private cl_int *errcode, pg_numeric_t arg1, pg_numeric_t arg2)
 
 
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_numeric_eq(__private cl_int *errcode,
 				pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -1115,7 +1116,7 @@ pgfn_numeric_eq(__private cl_int *errcode,
 
 
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_numeric_ne(__private cl_int *errcode,
 				pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -1135,7 +1136,7 @@ pgfn_numeric_ne(__private cl_int *errcode,
 
 
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_numeric_lt(__private cl_int *errcode,
 				pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -1155,7 +1156,7 @@ pgfn_numeric_lt(__private cl_int *errcode,
 
 
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_numeric_le(__private cl_int *errcode,
 				pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -1175,7 +1176,7 @@ pgfn_numeric_le(__private cl_int *errcode,
 
 
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_numeric_gt(__private cl_int *errcode,
 				pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -1195,7 +1196,7 @@ pgfn_numeric_gt(__private cl_int *errcode,
 
 
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_numeric_ge(__private cl_int *errcode,
 				pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -1215,7 +1216,7 @@ pgfn_numeric_ge(__private cl_int *errcode,
 
 
 
-static pg_int4_t
+STROMCL_LIBFUNC pg_int4_t
 pgfn_numeric_cmp(__private cl_int *errcode,
 				pg_numeric_t arg1, pg_numeric_t arg2)
 {
@@ -1233,5 +1234,97 @@ pgfn_numeric_cmp(__private cl_int *errcode,
 	return result;
 }
 
+#else	/* OPENCL_DEVICE_PROTOTYPE */
+/*
+ * Prototypes of the numeric functions, for the program being linked with
+ * the library object being compiled separately.
+ */
+STROMCL_SIMPLE_VARSTORE_TEMPLATE(numeric, cl_ulong)
+
+STROMCL_LIBFUNC pg_numeric_t
+pg_numeric_from_varlena(__private int *errcode, __global varlena *vl_val);
+STROMCL_LIBFUNC pg_numeric_t
+pg_numeric_vref(__global kern_data_store *kds,
+				__global kern_data_store *ktoast,
+				__private int *errcode,
+				cl_uint colidx,
+				cl_uint rowidx);
+STROMCL_LIBFUNC pg_numeric_t
+pg_numeric_param(__global kern_parambuf *kparams,
+				 __private int *errcode,
+				 cl_uint param_id);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_numeric_isnull(__private int *errcode,
+					pg_numeric_t arg);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_numeric_isnotnull(__private int *errcode,
+					   pg_numeric_t arg);
+STROMCL_LIBFUNC pg_int8_t
+numeric_to_integer(__private int *errcode, pg_numeric_t arg, cl_int size);
+STROMCL_LIBFUNC pg_float8_t
+numeric_to_float(__private int *errcode, pg_numeric_t arg);
+STROMCL_LIBFUNC pg_int2_t
+pgfn_numeric_int2(__private int *errcode, pg_numeric_t arg);
+STROMCL_LIBFUNC pg_int4_t
+pgfn_numeric_int4(__private int *errcode, pg_numeric_t arg);
+STROMCL_LIBFUNC pg_int8_t
+pgfn_numeric_int8(__private int *errcode, pg_numeric_t arg);
+STROMCL_LIBFUNC pg_float4_t
+pgfn_numeric_float4(__private int *errcode, pg_numeric_t arg);
+STROMCL_LIBFUNC pg_float8_t
+pgfn_numeric_float8(__private int *errcode, pg_numeric_t arg);
+STROMCL_LIBFUNC pg_numeric_t
+integer_to_numeric(__private int *errcode, pg_int8_t arg, cl_int size);
+STROMCL_LIBFUNC pg_numeric_t
+float_to_numeric(__private int *errcode, pg_float8_t arg, int dig);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_int2_numeric(__private int *errcode, pg_int2_t arg);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_int4_numeric(__private int *errcode, pg_int4_t arg);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_int8_numeric(__private int *errcode, pg_int8_t arg);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_float4_numeric(__private int *errcode, pg_float4_t arg);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_float8_numeric(__private int *errcode, pg_float8_t arg);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_numeric_uplus(__private int *errcode, pg_numeric_t arg);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_numeric_uminus(__private int *errcode, pg_numeric_t arg);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_numeric_abs(__private int *errcode, pg_numeric_t arg);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_numeric_add(__private int *errcode,
+				 pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_numeric_sub(__private int *errcode,
+				 pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC pg_numeric_t
+pgfn_numeric_mul(__private int *errcode,
+				 pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC int
+numeric_cmp(__private cl_int *errcode, pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_numeric_eq(__private cl_int *errcode,
+				pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_numeric_ne(__private cl_int *errcode,
+				pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_numeric_lt(__private cl_int *errcode,
+				pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_numeric_le(__private cl_int *errcode,
+				pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_numeric_gt(__private cl_int *errcode,
+				pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_numeric_ge(__private cl_int *errcode,
+				pg_numeric_t arg1, pg_numeric_t arg2);
+STROMCL_LIBFUNC pg_int4_t
+pgfn_numeric_cmp(__private cl_int *errcode,
+				pg_numeric_t arg1, pg_numeric_t arg2);
+#endif	/* OPENCL_DEVICE_PROTOTYPE */
 #endif /* OPENCL_DEVICE_CODE */
 #endif /* OPENCL_NUMERIC_H */
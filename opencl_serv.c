@@ -32,18 +32,64 @@
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "pg_strom.h"
+#include <float.h>
 #include <limits.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <unistd.h>
 
 /* static variables */
-static int		opencl_num_threads;
+int				opencl_num_threads;
+int				opencl_dma_staging_threshold;
+/* index of the current server thread, or -1 if not a server thread */
+__thread int	clserv_thread_index = -1;
 static shmem_startup_hook_type shmem_startup_hook_next;
+
+/*
+ * statistics of the workload being dispatched to a particular device, to
+ * estimate the time when the device can complete the next request.
+ */
+typedef struct {
+	slock_t		lock;
+	Size		outstanding_bytes;	/* bytes of the running requests */
+	cl_uint		outstanding_nreqs;	/* number of the running requests */
+	double		usec_per_byte;	/* EWMA of time per byte; 0 if unknown */
+	double		avg_length;		/* EWMA of length of requests */
+	cl_ulong	num_dispatched;	/* total number of dispatched requests */
+	cl_ulong	num_completed;	/* total number of completed requests */
+} clserv_device_stat;
+
+/* weight of a new sample of EWMA, in 1/N */
+#define CLSERV_SCHED_EWMA_FACTOR	8
+/* penalty of the device on remote NUMA node, in ratio to the cost */
+#define CLSERV_SCHED_NUMA_REMOTE_RATIO	1.25
+
 static struct {
 	slock_t		serial_lock;
+	clserv_device_stat dev_stat[MAX_NUM_DEVICES];
 } *opencl_serv_shm_values;
 
+/*
+ * per-device pool of buffer objects, to avoid driver round trip and
+ * fragmentation of device memory by clCreateBuffer for each request.
+ * A buffer object is allocated on one of the size classes; four classes
+ * for each power of 2, so the wasted area is less than 25%.
+ */
+#define CLSERV_BUFPOOL_MIN_SHIFT	16		/* 64KB */
+#define CLSERV_BUFPOOL_NUM_CLASSES	100		/* up to 64KB * 2^25 */
+#define CLSERV_BUFPOOL_DEPTH		16		/* max buffers per class */
+
+typedef struct {
+	pthread_mutex_t	lock;
+	Size		pooled_bytes;	/* total length of the pooled buffers */
+	Size		limit_bytes;	/* upper limit of pooled_bytes */
+	cl_uint		nfree[CLSERV_BUFPOOL_NUM_CLASSES];
+	cl_mem		free_mem[CLSERV_BUFPOOL_NUM_CLASSES][CLSERV_BUFPOOL_DEPTH];
+} clserv_buffer_pool;
+
+static int					opencl_buffer_pool_size;	/* in kB */
+static clserv_buffer_pool  *opencl_buffer_pool = NULL;
+
 /* signal flag */
 volatile bool		pgstrom_clserv_exit_pending = false;
 /* true, if OpenCL intermidiation server */
@@ -72,37 +118,431 @@ pgstrom_opencl_sighup(SIGNAL_ARGS)
  *
  * main loop of OpenCL intermediation server. each message class has its own
  * processing logic, so all we do here is just call the callback routine.
+ * Server threads are assigned to the devices in round-robin, by the thread
+ * index being supplied as argument.
  */
 static void *
 pgstrom_opencl_event_loop(void *arg)
 {
 	pgstrom_message	   *msg;
 
+	clserv_thread_index = (int)(intptr_t) arg;
+	pgstrom_bind_server_thread(clserv_thread_index % opencl_num_devices);
+
+	/* per-thread cache of slab entries; not a fatal error even if fail */
+	if (!pgstrom_shmem_slab_magazine_init())
+		clserv_log("failed to set up slab magazine, continue without it");
+
 	while (!pgstrom_clserv_exit_pending)
 	{
 		CHECK_FOR_INTERRUPTS();
 		msg = pgstrom_dequeue_server_message();
 		if (!msg)
+		{
+			/* good time to write out program binaries and autotuner */
+			clserv_devprog_save_binaries();
+			clserv_wgtune_save();
 			continue;
+		}
 		msg->cb_process(msg);
 	}
+	clserv_devprog_save_binaries();
+	clserv_wgtune_save();
+	/* also, destructor of the thread flushes replies deferred later */
+	pgstrom_flush_reply_messages();
+	pgstrom_shmem_slab_magazine_flush();
+
 	return NULL;
 }
 
 /*
  * pgstrom_opencl_device_schedule
  *
- * It suggests which opencl device shall be the target of kernel execution.
- * We plan to select an optimal device according to NUMA characteristics
- * and current waiting queue length, however, it is simple round robin
- * right now.
+ * It suggests which opencl device shall be the target of kernel execution,
+ * for a request that sends 'length' bytes to the device.
+ * We pick up the device with the earliest expected completion; that is
+ * the bytes of outstanding requests plus the new one, multiplied by the
+ * time per byte being observed on the device. It also accounts the request
+ * as outstanding workload of the chosen device, until the message is
+ * replied to the backend.
+ * If the message is already bound to a device on dequeue of the server
+ * message queue, that device wins unconditionally. The binding was made
+ * by the backlog of the devices when the message was enqueued, and a
+ * thread of an idle device steals the message for its own device, so
+ * overriding it here would only move the message away from the thread
+ * (and its NUMA node) that is going to process it.
+ * Elsewhere, the devices on remote NUMA node from the current server
+ * thread get a penalty. The device that has no estimation yet is assumed
+ * to be as fast as the fastest one, so it will get requests to learn its
+ * throughput.
  */
 int
-pgstrom_opencl_device_schedule(pgstrom_message *message)
+pgstrom_opencl_device_schedule(pgstrom_message *message, Size length)
+{
+	static int	index = 0;
+	Size		backlog[MAX_NUM_DEVICES];
+	double		usec_per_byte[MAX_NUM_DEVICES];
+	double		min_rate = 0.0;
+	double		cost, best = DBL_MAX;
+	int			numa_node = -1;
+	int			i, k, start, dindex = -1;
+
+	/* device being bound on dequeue has priority */
+	if (message->dindex >= 0 && message->dindex < opencl_num_devices)
+	{
+		dindex = message->dindex;
+		pgstrom_opencl_device_dispatch(message, dindex, length);
+		return dindex;
+	}
+
+	for (i=0; i < opencl_num_devices; i++)
+	{
+		clserv_device_stat *dstat = &opencl_serv_shm_values->dev_stat[i];
+
+		SpinLockAcquire(&dstat->lock);
+		backlog[i] = dstat->outstanding_bytes;
+		usec_per_byte[i] = dstat->usec_per_byte;
+		SpinLockRelease(&dstat->lock);
+
+		if (usec_per_byte[i] > 0.0 &&
+			(min_rate == 0.0 || usec_per_byte[i] < min_rate))
+			min_rate = usec_per_byte[i];
+	}
+	if (pgstrom_numa_num_nodes() > 1)
+		numa_node = pgstrom_numa_current_node();
+
+	/* rotate the starting point to distribute the tie */
+	start = index++ % opencl_num_devices;
+
+	for (k=0; k < opencl_num_devices; k++)
+	{
+		i = (start + k) % opencl_num_devices;
+		cost = (double)(backlog[i] + length) *
+			(usec_per_byte[i] > 0.0 ? usec_per_byte[i] :
+			 min_rate > 0.0 ? min_rate : 1.0);
+		if (numa_node >= 0 &&
+			pgstrom_get_device_info(i)->dev_numa_node >= 0 &&
+			pgstrom_get_device_info(i)->dev_numa_node != numa_node)
+			cost *= CLSERV_SCHED_NUMA_REMOTE_RATIO;
+		if (cost < best)
+		{
+			best = cost;
+			dindex = i;
+		}
+	}
+	Assert(dindex >= 0);
+	pgstrom_opencl_device_dispatch(message, dindex, length);
+
+	return dindex;
+}
+
+/*
+ * pgstrom_opencl_device_dispatch
+ *
+ * It accounts the request as outstanding workload of the supplied device.
+ * Usually, pgstrom_opencl_device_schedule() calls it, however, caller can
+ * also call it when the device is already fixed by other reason, like the
+ * hash table being loaded onto a particular device.
+ */
+void
+pgstrom_opencl_device_dispatch(pgstrom_message *message,
+							   int dindex, Size length)
+{
+	clserv_device_stat *dstat = &opencl_serv_shm_values->dev_stat[dindex];
+
+	Assert(dindex >= 0 && dindex < opencl_num_devices);
+	Assert(message->sched_length == 0);
+
+	/* zero-length request is accounted as 1 byte, to track it */
+	length = Max(length, 1);
+
+	SpinLockAcquire(&dstat->lock);
+	message->sched_backlog = dstat->outstanding_bytes;
+	dstat->outstanding_bytes += length;
+	dstat->outstanding_nreqs++;
+	if (dstat->num_dispatched++ == 0)
+		dstat->avg_length = (double) length;
+	else
+		dstat->avg_length += ((double) length - dstat->avg_length)
+			/ CLSERV_SCHED_EWMA_FACTOR;
+	SpinLockRelease(&dstat->lock);
+
+	message->dindex = dindex;
+	message->sched_length = length;
+	gettimeofday(&message->tv_sched, NULL);
+}
+
+/*
+ * pgstrom_opencl_device_complete
+ *
+ * It releases the outstanding workload of the message, then updates the
+ * throughput estimation of the device. The event profiling data tells us
+ * the actual busy time of the device, if performance monitor is enabled.
+ * Elsewhere, we estimate it by the wall-clock time since dispatch, but it
+ * includes the time to process the outstanding requests at that time.
+ * Request without device dispatch is silently ignored.
+ */
+void
+pgstrom_opencl_device_complete(pgstrom_message *message)
+{
+	clserv_device_stat *dstat;
+	pgstrom_perfmon	   *pfm = &message->pfm;
+	struct timeval		tv;
+	double				busy_time;
+	double				sample = 0.0;
+
+	if (message->sched_length == 0)
+		return;
+	Assert(message->dindex >= 0 && message->dindex < opencl_num_devices);
+	dstat = &opencl_serv_shm_values->dev_stat[message->dindex];
+
+	/* failed request does not tell us the throughput */
+	if (message->errcode == StromError_Success)
+	{
+		if (pfm->enabled)
+		{
+			busy_time = (double)(pfm->time_dma_send +
+								 pfm->time_kern_exec +
+								 pfm->time_kern_proj +
+								 pfm->time_kern_prep +
+								 pfm->time_kern_sort +
+								 pfm->time_dma_recv);
+			sample = busy_time / (double) message->sched_length;
+		}
+		if (sample <= 0.0)
+		{
+			gettimeofday(&tv, NULL);
+			busy_time = (double) timeval_diff(&message->tv_sched, &tv);
+			sample = busy_time / (double)(message->sched_backlog +
+										  message->sched_length);
+		}
+	}
+
+	SpinLockAcquire(&dstat->lock);
+	Assert(dstat->outstanding_bytes >= message->sched_length);
+	dstat->outstanding_bytes -= message->sched_length;
+	dstat->outstanding_nreqs--;
+	dstat->num_completed++;
+	if (sample > 0.0)
+	{
+		if (dstat->usec_per_byte == 0.0)
+			dstat->usec_per_byte = sample;
+		else
+			dstat->usec_per_byte += (sample - dstat->usec_per_byte)
+				/ CLSERV_SCHED_EWMA_FACTOR;
+	}
+	SpinLockRelease(&dstat->lock);
+
+	message->sched_length = 0;
+}
+
+/*
+ * pgstrom_opencl_device_backlog
+ *
+ * It returns the expected time (in usec) for the supplied device to complete
+ * the outstanding requests and 'num_pending' requests of average length,
+ * or -1.0 if the device has no estimation of its throughput yet.
+ * Note that it is also called by backend processes.
+ */
+double
+pgstrom_opencl_device_backlog(int dindex, int num_pending)
+{
+	clserv_device_stat *dstat;
+	double		result = -1.0;
+
+	if (!opencl_serv_shm_values || dindex < 0 || dindex >= MAX_NUM_DEVICES)
+		return -1.0;
+	dstat = &opencl_serv_shm_values->dev_stat[dindex];
+
+	SpinLockAcquire(&dstat->lock);
+	if (dstat->usec_per_byte > 0.0)
+		result = ((double) dstat->outstanding_bytes +
+				  (double) num_pending * dstat->avg_length)
+			* dstat->usec_per_byte;
+	SpinLockRelease(&dstat->lock);
+
+	return result;
+}
+
+/*
+ * clserv_buffer_pool_class
+ *
+ * It returns the size class of the supplied length, and its length.
+ * -1 shall be returned if length is too large to be pooled.
+ */
+static int
+clserv_buffer_pool_class(Size length, Size *p_class_length)
+{
+	Size	base;
+	Size	step;
+	int		shift;
+	int		index;
+
+	if (length <= (1UL << CLSERV_BUFPOOL_MIN_SHIFT))
+	{
+		*p_class_length = (1UL << CLSERV_BUFPOOL_MIN_SHIFT);
+		return 0;
+	}
+	shift = sizeof(unsigned long) * BITS_PER_BYTE - 1
+		- __builtin_clzl((unsigned long)(length - 1));
+	base = (1UL << shift);
+	step = base / 4;
+	length = TYPEALIGN(step, length);
+	index = 4 * (shift - CLSERV_BUFPOOL_MIN_SHIFT) + (length - base) / step;
+	if (index >= CLSERV_BUFPOOL_NUM_CLASSES)
+		return -1;
+	*p_class_length = length;
+	return index;
+}
+
+/*
+ * clserv_trim_buffer_pool
+ *
+ * It releases all the pooled buffers, to give device memory back under
+ * the memory pressure.
+ */
+static void
+clserv_trim_buffer_pool(void)
+{
+	clserv_buffer_pool *bpool;
+	int		i, j;
+
+	for (i=0; i < opencl_num_devices; i++)
+	{
+		bpool = &opencl_buffer_pool[i];
+		pthread_mutex_lock(&bpool->lock);
+		for (j=0; j < CLSERV_BUFPOOL_NUM_CLASSES; j++)
+		{
+			while (bpool->nfree[j] > 0)
+				clReleaseMemObject(bpool->free_mem[j][--bpool->nfree[j]]);
+		}
+		bpool->pooled_bytes = 0;
+		pthread_mutex_unlock(&bpool->lock);
+	}
+}
+
+/*
+ * clserv_create_buffer
+ *
+ * It returns a read-writable buffer object that has at least 'length'
+ * bytes, to be used on the device of 'dindex'. It tries to reuse a buffer
+ * object in the pool of the device first, then creates a new one.
+ * If device memory is exhausted, it trims the pool and tries again.
+ * The buffer object has to be released by clserv_release_buffer().
+ */
+cl_mem
+clserv_create_buffer(int dindex, Size length,
+					 pgstrom_perfmon *pfm, cl_int *errcode_ret)
+{
+	clserv_buffer_pool *bpool = &opencl_buffer_pool[dindex];
+	cl_mem		mem = NULL;
+	Size		class_length;
+	int			index;
+	cl_int		rc;
+
+	Assert(dindex >= 0 && dindex < opencl_num_devices);
+	index = clserv_buffer_pool_class(length, &class_length);
+	if (index < 0)
+		class_length = length;
+	else
+	{
+		pthread_mutex_lock(&bpool->lock);
+		if (bpool->nfree[index] > 0)
+		{
+			mem = bpool->free_mem[index][--bpool->nfree[index]];
+			bpool->pooled_bytes -= class_length;
+		}
+		pthread_mutex_unlock(&bpool->lock);
+
+		if (mem)
+		{
+			pfm->num_bufpool_hit++;
+			*errcode_ret = CL_SUCCESS;
+			return mem;
+		}
+	}
+	pfm->num_bufpool_miss++;
+
+	mem = clCreateBuffer(opencl_context,
+						 CL_MEM_READ_WRITE,
+						 class_length,
+						 NULL,
+						 &rc);
+	if (rc == CL_MEM_OBJECT_ALLOCATION_FAILURE ||
+		rc == CL_OUT_OF_RESOURCES)
+	{
+		clserv_trim_buffer_pool();
+		mem = clCreateBuffer(opencl_context,
+							 CL_MEM_READ_WRITE,
+							 class_length,
+							 NULL,
+							 &rc);
+	}
+	*errcode_ret = rc;
+	return mem;
+}
+
+/*
+ * clserv_release_buffer
+ *
+ * It puts back the buffer object being acquired by clserv_create_buffer()
+ * to the pool of the device, or releases it if pool is already full.
+ * Caller must ensure no commands in flight touch this buffer any more.
+ */
+void
+clserv_release_buffer(int dindex, cl_mem mem)
+{
+	clserv_buffer_pool *bpool = &opencl_buffer_pool[dindex];
+	Size		length;
+	Size		class_length;
+	int			index;
+	cl_int		rc;
+
+	Assert(dindex >= 0 && dindex < opencl_num_devices);
+	rc = clGetMemObjectInfo(mem, CL_MEM_SIZE, sizeof(size_t), &length, NULL);
+	if (rc == CL_SUCCESS &&
+		(index = clserv_buffer_pool_class(length, &class_length)) >= 0 &&
+		class_length == length)
+	{
+		pthread_mutex_lock(&bpool->lock);
+		if (bpool->nfree[index] < CLSERV_BUFPOOL_DEPTH &&
+			bpool->pooled_bytes + length <= bpool->limit_bytes)
+		{
+			bpool->free_mem[index][bpool->nfree[index]++] = mem;
+			bpool->pooled_bytes += length;
+			mem = NULL;
+		}
+		pthread_mutex_unlock(&bpool->lock);
+	}
+	if (mem)
+		clReleaseMemObject(mem);
+}
+
+/*
+ * init_opencl_buffer_pool
+ *
+ * It sets up the per-device buffer pool. Pooled buffers never consume
+ * more than a quarter of the global memory of the device.
+ */
+static void
+init_opencl_buffer_pool(void)
 {
-	static int index = 0;
+	int		i;
 
-	return index++ % opencl_num_devices;
+	opencl_buffer_pool = calloc(opencl_num_devices,
+								sizeof(clserv_buffer_pool));
+	if (!opencl_buffer_pool)
+		elog(ERROR, "out of memory");
+
+	for (i=0; i < opencl_num_devices; i++)
+	{
+		const pgstrom_device_info *dinfo = pgstrom_get_device_info(i);
+
+		pthread_mutex_init(&opencl_buffer_pool[i].lock, NULL);
+		opencl_buffer_pool[i].limit_bytes
+			= Min((Size) opencl_buffer_pool_size * 1024,
+				  dinfo->dev_global_mem_size / 4);
+	}
 }
 
 /*
@@ -246,6 +686,10 @@ pgstrom_opencl_main(Datum main_arg)
 
 	/* initialize opencl context and shared memory segment */
 	init_opencl_context_and_shmem();
+
+	/* set up per-device buffer pool and message queues */
+	init_opencl_buffer_pool();
+	pgstrom_setup_mqueue_devices(opencl_num_devices);
 	elog(LOG, "Starting PG-Strom OpenCL Server");
 
 	/*
@@ -271,7 +715,7 @@ pgstrom_opencl_main(Datum main_arg)
 		if (pthread_create(&threads[i],
 						   NULL,
 						   pgstrom_opencl_event_loop,
-						   NULL) != 0)
+						   (void *)(intptr_t) i) != 0)
 			break;
 	}
 
@@ -385,6 +829,7 @@ static void
 pgstrom_startup_opencl_server(void)
 {
 	bool		found;
+	int			i;
 
 	if (shmem_startup_hook_next)
 		(*shmem_startup_hook_next)();
@@ -397,6 +842,8 @@ pgstrom_startup_opencl_server(void)
 
 	memset(opencl_serv_shm_values, 0, sizeof(*opencl_serv_shm_values));
 	SpinLockInit(&opencl_serv_shm_values->serial_lock);
+	for (i=0; i < MAX_NUM_DEVICES; i++)
+		SpinLockInit(&opencl_serv_shm_values->dev_stat[i].lock);
 }
 
 void
@@ -416,6 +863,30 @@ pgstrom_init_opencl_server(void)
 							GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
 
+	/* max size of the pooled buffer objects per device */
+	DefineCustomIntVariable("pg_strom.opencl_buffer_pool_size",
+							"max size of pooled buffer objects per device",
+							NULL,
+							&opencl_buffer_pool_size,
+							262144,		/* 256MB */
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	/* average run length of pages to be gathered prior to DMA send */
+	DefineCustomIntVariable("pg_strom.dma_staging_threshold",
+							"minimum average run of pages sent without staging",
+							"Pages are gathered into a staging buffer prior to DMA send, if average length of continuous pages is less than this value. Zero disables staging.",
+							&opencl_dma_staging_threshold,
+							4,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
 	/* launch a background worker process */	
 	memset(&worker, 0, sizeof(BackgroundWorker));
 	strcpy(worker.bgw_name, "PG-Strom OpenCL Server");
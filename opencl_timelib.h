@@ -117,6 +117,7 @@ STROMCL_SIMPLE_TYPE_TEMPLATE(timestamp,Timestamp)
 STROMCL_SIMPLE_TYPE_TEMPLATE(int4,cl_int);
 #endif
 
+#ifndef OPENCL_DEVICE_PROTOTYPE
 /*
  * Support routines
  */
@@ -186,7 +187,7 @@ dt2time(Timestamp jd, cl_int *hour, cl_int *min, cl_int *sec, cl_int *fsec)
 }
 
 /* simplified version; no timezone support now */
-static cl_bool
+STROMCL_LIBFUNC cl_bool
 timestamp2tm(Timestamp dt, struct pg_tm *tm, fsec_t *fsec)
 {
 	cl_long		date;	/* Timestamp in original */
@@ -224,7 +225,7 @@ timestamp2tm(Timestamp dt, struct pg_tm *tm, fsec_t *fsec)
  * Type cast functions
  *
  * --------------------------------------------------------------- */
-static pg_date_t
+STROMCL_LIBFUNC pg_date_t
 pgfn_timestamp_date(__private cl_int *errcode, pg_timestamp_t arg1)
 {
 	pg_date_t		result;
@@ -257,7 +258,7 @@ pgfn_timestamp_date(__private cl_int *errcode, pg_timestamp_t arg1)
 }
 
 
-static pg_time_t
+STROMCL_LIBFUNC pg_time_t
 pgfn_timestamp_time(__private cl_int *errcode, pg_timestamp_t arg1)
 {
 	pg_time_t		result;
@@ -285,7 +286,7 @@ pgfn_timestamp_time(__private cl_int *errcode, pg_timestamp_t arg1)
 	return result;
 }
 
-static pg_timestamp_t
+STROMCL_LIBFUNC pg_timestamp_t
 pgfn_date_timestamp(__private cl_int *errcode, pg_date_t arg1)
 {
 	pg_timestamp_t	result;
@@ -322,7 +323,7 @@ pgfn_date_timestamp(__private cl_int *errcode, pg_date_t arg1)
 /*
  * Time/Date operators
  */
-static pg_date_t
+STROMCL_LIBFUNC pg_date_t
 pgfn_date_pli(__private cl_int *errcode, pg_date_t arg1, pg_int4_t arg2)
 {
 	pg_date_t	result;
@@ -340,7 +341,7 @@ pgfn_date_pli(__private cl_int *errcode, pg_date_t arg1, pg_int4_t arg2)
 	return result;
 }
 
-static pg_date_t
+STROMCL_LIBFUNC pg_date_t
 pgfn_date_mii(__private cl_int *errcode, pg_date_t arg1, pg_int4_t arg2)
 {
 	pg_date_t	result;
@@ -358,7 +359,7 @@ pgfn_date_mii(__private cl_int *errcode, pg_date_t arg1, pg_int4_t arg2)
 	return result;
 }
 
-static pg_int4_t
+STROMCL_LIBFUNC pg_int4_t
 pgfn_date_mi(__private cl_int *errcode, pg_date_t arg1, pg_date_t arg2)
 {
 	pg_int4_t	result;
@@ -378,7 +379,7 @@ pgfn_date_mi(__private cl_int *errcode, pg_date_t arg1, pg_date_t arg2)
 	return result;
 }
 
-static pg_timestamp_t
+STROMCL_LIBFUNC pg_timestamp_t
 pgfn_datetime_pl(__private cl_int *errcode, pg_date_t arg1, pg_time_t arg2)
 {
 	pg_timestamp_t	result;
@@ -394,13 +395,13 @@ pgfn_datetime_pl(__private cl_int *errcode, pg_date_t arg1, pg_time_t arg2)
 	return result;
 }
 
-static pg_date_t
+STROMCL_LIBFUNC pg_date_t
 pgfn_integer_pl_date(__private cl_int *errcode, pg_int4_t arg1, pg_date_t arg2)
 {
 	return pgfn_date_pli(errcode, arg2, arg1);
 }
 
-static pg_timestamp_t
+STROMCL_LIBFUNC pg_timestamp_t
 pgfn_timedata_pl(__private cl_int *errcode, pg_time_t arg1, pg_date_t arg2)
 {
 	return pgfn_datetime_pl(errcode, arg2, arg1);
@@ -409,7 +410,7 @@ pgfn_timedata_pl(__private cl_int *errcode, pg_time_t arg1, pg_date_t arg2)
 /*
  * Date comparison
  */
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_date_eq_timestamp(__private cl_int *errcode,
 					   pg_date_t arg1, pg_timestamp_t arg2)
 {
@@ -426,7 +427,7 @@ pgfn_date_eq_timestamp(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_date_ne_timestamp(__private cl_int *errcode,
 					   pg_date_t arg1, pg_timestamp_t arg2)
 {
@@ -443,7 +444,7 @@ pgfn_date_ne_timestamp(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_date_lt_timestamp(__private cl_int *errcode,
 					   pg_date_t arg1, pg_timestamp_t arg2)
 {
@@ -460,7 +461,7 @@ pgfn_date_lt_timestamp(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_date_le_timestamp(__private cl_int *errcode,
 					   pg_date_t arg1, pg_timestamp_t arg2)
 {
@@ -477,7 +478,7 @@ pgfn_date_le_timestamp(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_date_gt_timestamp(__private cl_int *errcode,
 					   pg_date_t arg1, pg_timestamp_t arg2)
 {
@@ -494,7 +495,7 @@ pgfn_date_gt_timestamp(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_date_ge_timestamp(__private cl_int *errcode,
 					   pg_date_t arg1, pg_timestamp_t arg2)
 {
@@ -511,7 +512,7 @@ pgfn_date_ge_timestamp(__private cl_int *errcode,
 	return result;
 }
 
-static pg_int4_t
+STROMCL_LIBFUNC pg_int4_t
 date_cmp_timestamp(__private cl_int *errcode,
 				   pg_date_t arg1, pg_timestamp_t arg2)
 {
@@ -536,7 +537,7 @@ date_cmp_timestamp(__private cl_int *errcode,
 /*
  * Timestamp comparison
  */
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_timestamp_eq_date(__private cl_int *errcode,
 					   pg_timestamp_t arg1, pg_date_t arg2)
 {
@@ -553,7 +554,7 @@ pgfn_timestamp_eq_date(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_timestamp_ne_date(__private cl_int *errcode,
 					   pg_timestamp_t arg1, pg_date_t arg2)
 {
@@ -570,7 +571,7 @@ pgfn_timestamp_ne_date(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_timestamp_lt_date(__private cl_int *errcode,
 					   pg_timestamp_t arg1, pg_date_t arg2)
 {
@@ -587,7 +588,7 @@ pgfn_timestamp_lt_date(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_timestamp_le_date(__private cl_int *errcode,
 					   pg_timestamp_t arg1, pg_date_t arg2)
 {
@@ -604,7 +605,7 @@ pgfn_timestamp_le_date(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_timestamp_gt_date(__private cl_int *errcode,
 					   pg_timestamp_t arg1, pg_date_t arg2)
 {
@@ -621,7 +622,7 @@ pgfn_timestamp_gt_date(__private cl_int *errcode,
 	return result;
 }
 
-static pg_bool_t
+STROMCL_LIBFUNC pg_bool_t
 pgfn_timestamp_ge_date(__private cl_int *errcode,
 					   pg_timestamp_t arg1, pg_date_t arg2)
 {
@@ -638,7 +639,7 @@ pgfn_timestamp_ge_date(__private cl_int *errcode,
 	return result;
 }
 
-static pg_int4_t
+STROMCL_LIBFUNC pg_int4_t
 pgfn_timestamp_cmp_date(__private cl_int *errcode,
 						pg_timestamp_t arg1, pg_date_t arg2)
 {
@@ -660,5 +661,73 @@ pgfn_timestamp_cmp_date(__private cl_int *errcode,
 	return result;
 }
 
+#else	/* OPENCL_DEVICE_PROTOTYPE */
+/*
+ * Prototypes of the timelib functions, for the program being linked with
+ * the library object being compiled separately.
+ */
+STROMCL_LIBFUNC cl_bool
+timestamp2tm(Timestamp dt, struct pg_tm *tm, fsec_t *fsec);
+STROMCL_LIBFUNC pg_date_t
+pgfn_timestamp_date(__private cl_int *errcode, pg_timestamp_t arg1);
+STROMCL_LIBFUNC pg_time_t
+pgfn_timestamp_time(__private cl_int *errcode, pg_timestamp_t arg1);
+STROMCL_LIBFUNC pg_timestamp_t
+pgfn_date_timestamp(__private cl_int *errcode, pg_date_t arg1);
+STROMCL_LIBFUNC pg_date_t
+pgfn_date_pli(__private cl_int *errcode, pg_date_t arg1, pg_int4_t arg2);
+STROMCL_LIBFUNC pg_date_t
+pgfn_date_mii(__private cl_int *errcode, pg_date_t arg1, pg_int4_t arg2);
+STROMCL_LIBFUNC pg_int4_t
+pgfn_date_mi(__private cl_int *errcode, pg_date_t arg1, pg_date_t arg2);
+STROMCL_LIBFUNC pg_timestamp_t
+pgfn_datetime_pl(__private cl_int *errcode, pg_date_t arg1, pg_time_t arg2);
+STROMCL_LIBFUNC pg_date_t
+pgfn_integer_pl_date(__private cl_int *errcode, pg_int4_t arg1, pg_date_t arg2);
+STROMCL_LIBFUNC pg_timestamp_t
+pgfn_timedata_pl(__private cl_int *errcode, pg_time_t arg1, pg_date_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_date_eq_timestamp(__private cl_int *errcode,
+					   pg_date_t arg1, pg_timestamp_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_date_ne_timestamp(__private cl_int *errcode,
+					   pg_date_t arg1, pg_timestamp_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_date_lt_timestamp(__private cl_int *errcode,
+					   pg_date_t arg1, pg_timestamp_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_date_le_timestamp(__private cl_int *errcode,
+					   pg_date_t arg1, pg_timestamp_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_date_gt_timestamp(__private cl_int *errcode,
+					   pg_date_t arg1, pg_timestamp_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_date_ge_timestamp(__private cl_int *errcode,
+					   pg_date_t arg1, pg_timestamp_t arg2);
+STROMCL_LIBFUNC pg_int4_t
+date_cmp_timestamp(__private cl_int *errcode,
+				   pg_date_t arg1, pg_timestamp_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_timestamp_eq_date(__private cl_int *errcode,
+					   pg_timestamp_t arg1, pg_date_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_timestamp_ne_date(__private cl_int *errcode,
+					   pg_timestamp_t arg1, pg_date_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_timestamp_lt_date(__private cl_int *errcode,
+					   pg_timestamp_t arg1, pg_date_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_timestamp_le_date(__private cl_int *errcode,
+					   pg_timestamp_t arg1, pg_date_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_timestamp_gt_date(__private cl_int *errcode,
+					   pg_timestamp_t arg1, pg_date_t arg2);
+STROMCL_LIBFUNC pg_bool_t
+pgfn_timestamp_ge_date(__private cl_int *errcode,
+					   pg_timestamp_t arg1, pg_date_t arg2);
+STROMCL_LIBFUNC pg_int4_t
+pgfn_timestamp_cmp_date(__private cl_int *errcode,
+						pg_timestamp_t arg1, pg_date_t arg2);
+#endif	/* OPENCL_DEVICE_PROTOTYPE */
 #endif	/* OPENCL_DEVICE_CODE */
 #endif	/* OPENCL_TIMELIB_H */
@@ -10,7 +10,11 @@ CREATE TYPE __pgstrom_shmem_info AS (
   zone    int4,
   size    text,
   active  int8,
-  free    int8
+  free    int8,
+  pagesz  int8,
+  numa_node int4,
+  int_frag float8,
+  ext_frag float8
 );
 CREATE FUNCTION pgstrom_shmem_info()
   RETURNS SETOF __pgstrom_shmem_info
@@ -37,7 +41,8 @@ CREATE TYPE __pgstrom_shmem_slab_info AS (
   owner		int4,
   location	text,
   active    bool,
-  broken	bool
+  broken	bool,
+  mag_hitratio float8
 );
 CREATE FUNCTION pgstrom_shmem_slab_info()
   RETURNS SETOF __pgstrom_shmem_slab_info
@@ -70,11 +75,42 @@ CREATE FUNCTION pgstrom_opencl_program_info()
   AS 'MODULE_PATHNAME'
   LANGUAGE C STRICT;
 
+CREATE TYPE __pgstrom_opencl_program_stat AS (
+  usage		int8,
+  hits		int8,
+  misses	int8,
+  evicts	int8,
+  link_fallbacks int8
+);
+CREATE FUNCTION pgstrom_opencl_program_stat()
+  RETURNS __pgstrom_opencl_program_stat
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C STRICT;
+
+CREATE TYPE __pgstrom_opencl_workgroup_info AS (
+  crc		text,
+  kernel	text,
+  device	int4,
+  state		text,
+  lwork_sz	int8,
+  samples	text
+);
+CREATE FUNCTION pgstrom_opencl_workgroup_info()
+  RETURNS SETOF __pgstrom_opencl_workgroup_info
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C STRICT;
+CREATE VIEW pgstrom_opencl_workgroup AS
+  SELECT * FROM pgstrom_opencl_workgroup_info();
+
 CREATE TYPE __pgstrom_mqueue_info AS (
   mqueue	text,
   owner		int4,
   state     text,
-  refcnt	int4
+  refcnt	int4,
+  weight	int4,
+  depth		int4,
+  wait_avg	float8,
+  wait_max	float8
 );
 CREATE FUNCTION pgstrom_mqueue_info()
   RETURNS SETOF __pgstrom_mqueue_info
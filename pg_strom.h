@@ -20,6 +20,7 @@
 #include "nodes/execnodes.h"
 #include "nodes/plannodes.h"
 #include "nodes/primnodes.h"
+#include "storage/buf.h"
 #include "storage/lock.h"
 #include "storage/spin.h"
 #include "utils/resowner.h"
@@ -71,6 +72,7 @@ typedef struct {
 typedef struct {
 	pgstrom_platform_info *pl_info;
 	cl_uint		dev_index;
+	cl_int		dev_numa_node;	/* NUMA node of the device, or -1 */
 	cl_uint		dev_address_bits;
 	cl_bool		dev_available;
 	cl_bool		dev_compiler_available;
@@ -136,6 +138,7 @@ typedef enum {
 	StromTag_GpuHashJoin,
 	StromTag_HashJoinTable,
 	StromTag_GpuPreAgg,
+	StromTag_DevProgBuild,
 } StromTag;
 
 typedef struct {
@@ -162,6 +165,7 @@ StromTagGetLabel(StromObject *sobject)
 		StromTagGetLabelEntry(GpuPreAgg);
 		StromTagGetLabelEntry(GpuHashJoin);
 		StromTagGetLabelEntry(HashJoinTable);
+		StromTagGetLabelEntry(DevProgBuild);
 		default:
 			snprintf(msgbuf, sizeof(msgbuf),
 					 "unknown tag (%u)", sobject->stag);
@@ -180,14 +184,24 @@ typedef struct {
 	/*-- perfmon to load and materialize --*/
 	cl_ulong	time_inner_load;	/* time to load the inner relation */
 	cl_ulong	time_outer_load;	/* time to load the outer relation */
+	cl_ulong	time_io_wait;		/* time blocked on I/O during load */
 	cl_ulong	time_materialize;	/* time to materialize the result */
 	/*-- perfmon for message exchanging --*/
 	cl_ulong	time_in_sendq;		/* waiting time in the server mqueue */
 	cl_ulong	time_in_recvq;		/* waiting time in the response mqueue */
 	cl_ulong	time_kern_build;	/* max time to build opencl kernel */
+	cl_ulong	time_kern_prebuild;	/* build time hidden by prebuild */
+	cl_uint		num_recv_spin_hit;	/* number of responses got by spin */
+	cl_uint		num_recv_spin_miss;	/* number of sleeps after spinning */
+	cl_uint		num_recv_block;		/* number of sleeps without spinning */
+	cl_ulong	time_recv_spin;		/* time to spin on the response mqueue */
+	cl_uint		num_bufpool_hit;	/* number of buffers reused from pool */
+	cl_uint		num_bufpool_miss;	/* number of buffers newly created */
 	/*-- perfmon for DMA send/recv --*/
 	cl_uint		num_dma_send;	/* number of DMA send request */
 	cl_uint		num_dma_recv;	/* number of DMA receive request */
+	cl_uint		num_dma_saved;	/* number of DMA send saved by coalescing */
+	cl_ulong	bytes_dma_staged;	/* bytes gathered to staging buffer */
 	cl_ulong	bytes_dma_send;	/* bytes of DMA send */
 	cl_ulong	bytes_dma_recv;	/* bytes of DMA receive */
 	cl_ulong	time_dma_send;	/* time to send host=>device data */
@@ -233,8 +247,23 @@ typedef struct {
 	pthread_cond_t	cond;
 	dlist_head		qhead;
 	bool			closed;
+	/* send queue of the messages towards OpenCL server */
+	dlist_node		sched_chain;	/* link to overflow list in mqueue.c */
+	dlist_head		sendq;			/* messages not fetched by server yet */
+	int				send_depth;		/* number of messages in sendq */
+	int				send_tokens;	/* number of tokens in server queue */
+	int				send_overflow;	/* number of tokens in overflow list */
+	int				send_weight;	/* max number of tokens */
+	int				send_dindex;	/* device being bound, or -1 */
+	uint64			send_nitems;	/* number of messages fetched */
+	uint64			send_wait;		/* total wait time in sendq (usec) */
+	/* only owner backend touches the field below */
+	long			recv_wait_avg;	/* average wait time on qhead (usec) */
 } pgstrom_queue;
 
+/* max number of messages to be enqueued or replied at once */
+#define MQUEUE_BATCH_SIZE		32
+
 typedef struct pgstrom_message {
 	StromObject		sobj;
 	slock_t			lock;	/* protection for reference counter */
@@ -242,6 +271,11 @@ typedef struct pgstrom_message {
 	cl_int			errcode;
 	dlist_node		chain;
 	pgstrom_queue  *respq;	/* mqueue for response message */
+	struct timeval	tv_enqueue;	/* timestamp when enqueued to server */
+	cl_int			dindex;		/* device to process, or -1 if not bound */
+	Size			sched_length;	/* bytes being accounted on the device */
+	Size			sched_backlog;	/* outstanding bytes at dispatch */
+	struct timeval	tv_sched;	/* timestamp when dispatched to the device */
 	void	(*cb_process)(struct pgstrom_message *message);
 	void	(*cb_release)(struct pgstrom_message *message);
 	pgstrom_perfmon	pfm;
@@ -312,8 +346,19 @@ typedef struct pgstrom_data_store {
 	struct pgstrom_data_store *ktoast;
 	ResourceOwner		resowner;	/* !!NOTE: private address!!*/
 	char			   *local_pages;/* duplication of local pages */
+	char			   *dma_staging;/* gathered pages for DMA, if any */
+	BlockNumber		   *direct_blknums;	/* block number of local_pages
+										 * being read directly */
+	Size				reserved;	/* shmem budget charged on this store */
 } pgstrom_data_store;
 
+/*
+ * pgstrom_direct_reader - state of direct relation reader; it loads
+ * blocks from the relation segment files onto local_pages, bypassing
+ * the shared buffer. See datastore.c for details.
+ */
+typedef struct pgstrom_direct_reader pgstrom_direct_reader;
+
 /*
  * pgstrom_bulk_slot
  *
@@ -364,6 +409,15 @@ extern Size pgstrom_shmem_zone_length(void);
 extern Size pgstrom_shmem_maxalloc(void);
 extern bool pgstrom_shmem_sanitycheck(const void *address);
 extern void pgstrom_shmem_dump(void);
+extern bool pgstrom_shmem_slab_magazine_init(void);
+extern void pgstrom_shmem_slab_magazine_flush(void);
+extern bool pgstrom_shmem_reserve(Size length, bool wait);
+extern void pgstrom_shmem_reserve_force(Size length);
+extern void pgstrom_shmem_unreserve(Size length);
+extern int pgstrom_numa_num_nodes(void);
+extern bool pgstrom_numa_is_simulated(void);
+extern int pgstrom_numa_current_node(void);
+extern int pgstrom_numa_node_of_address(void *address);
 extern void pgstrom_setup_shmem(Size zone_length,
 								bool (*callback)(void *address, Size length,
 												 const char *label,
@@ -375,17 +429,24 @@ extern Datum pgstrom_shmem_active_info(PG_FUNCTION_ARGS);
 extern Datum pgstrom_shmem_slab_info(PG_FUNCTION_ARGS);
 extern Datum pgstrom_shmem_alloc_func(PG_FUNCTION_ARGS);
 extern Datum pgstrom_shmem_free_func(PG_FUNCTION_ARGS);
+extern Datum pgstrom_shmem_alloc_bench(PG_FUNCTION_ARGS);
 
 /*
  * mqueue.c
  */
 extern pgstrom_queue *pgstrom_create_queue(void);
 extern bool pgstrom_enqueue_message(pgstrom_message *message);
+extern bool pgstrom_enqueue_messages(pgstrom_message **msgs, int nmsgs);
+extern void pgstrom_flush_messages(pgstrom_message **msgs, int *p_nmsgs);
 extern void pgstrom_reply_message(pgstrom_message *message);
+extern void pgstrom_reply_messages(pgstrom_message **msgs, int nmsgs);
+extern void pgstrom_flush_reply_messages(void);
 extern pgstrom_message *pgstrom_dequeue_message(pgstrom_queue *queue);
 extern pgstrom_message *pgstrom_try_dequeue_message(pgstrom_queue *queue);
 extern pgstrom_message *pgstrom_dequeue_server_message(void);
 extern void pgstrom_close_server_queue(void);
+extern void pgstrom_setup_mqueue_devices(int num_devices);
+extern void pgstrom_bind_server_thread(int dindex);
 extern void pgstrom_cancel_server_loop(void);
 extern void pgstrom_close_queue(pgstrom_queue *queue);
 extern pgstrom_queue *pgstrom_get_queue(pgstrom_queue *mqueue);
@@ -399,6 +460,7 @@ extern void pgstrom_init_message(pgstrom_message *msg,
 								 bool perfmon_enabled);
 extern void pgstrom_init_mqueue(void);
 extern Datum pgstrom_mqueue_info(PG_FUNCTION_ARGS);
+extern Datum pgstrom_mqueue_ring_bench(PG_FUNCTION_ARGS);
 
 /*
  * codegen.c
@@ -472,13 +534,27 @@ __pgstrom_create_data_store_tupslot(const char *filename, int lineno,
 										(internal_format))
 extern pgstrom_data_store *pgstrom_get_data_store(pgstrom_data_store *pds);
 extern void pgstrom_put_data_store(pgstrom_data_store *pds);
+extern Size pgstrom_data_store_shmem_length(pgstrom_data_store *pds);
 extern int pgstrom_data_store_insert_block(pgstrom_data_store *pds,
 										   Relation rel,
 										   BlockNumber blknum,
 										   Snapshot snapshot,
-										   bool page_prune);
+										   bool page_prune,
+										   BufferAccessStrategy strategy);
+extern pgstrom_direct_reader *pgstrom_begin_direct_read(Relation rel,
+														Snapshot snapshot);
+extern BlockNumber pgstrom_data_store_direct_read(pgstrom_data_store *pds,
+												  pgstrom_direct_reader *dreader,
+												  BlockNumber blknum,
+												  BlockNumber last_blknum,
+												  Snapshot snapshot,
+												  BufferAccessStrategy strategy);
+extern void pgstrom_end_direct_read(pgstrom_direct_reader *dreader);
 extern bool pgstrom_data_store_insert_tuple(pgstrom_data_store *pds,
 											TupleTableSlot *slot);
+extern void pgstrom_data_store_columnize(pgstrom_data_store *pds,
+										 TupleDesc tupdesc,
+										 Bitmapset *attr_refs);
 extern cl_int clserv_dmasend_data_store(pgstrom_data_store *pds,
 										cl_command_queue kcmdq,
 										cl_mem kds_buffer,
@@ -517,6 +593,9 @@ extern bool pgstrom_plan_is_gpuscan(const Plan *plan);
 extern void pgstrom_gpuscan_setup_bulkslot(PlanState *outer_ps,
 										   ProjectionInfo **p_bulk_proj,
 										   TupleTableSlot **p_bulk_slot);
+extern void pgstrom_gpuscan_bulk_attrefs(PlanState *outer_ps,
+										 Bitmapset *attr_refs,
+										 List *upper_quals);
 extern void pgstrom_init_gpuscan(void);
 
 /*
@@ -574,13 +653,26 @@ extern void construct_opencl_device_info(void);
 extern void pgstrom_init_opencl_devinfo(void);
 extern Datum pgstrom_opencl_device_info(PG_FUNCTION_ARGS);
 
+/*
+ * clserv_wgtune - a ticket of the workgroup size autotuner; that identifies
+ * the candidate being sampled on a particular kernel launch.
+ */
+typedef struct {
+	cl_int		index;		/* index of the tuner entry, or -1 */
+	cl_uint		generation;	/* generation of the tuner entry */
+	cl_uint		cand;		/* index of the candidate being sampled */
+	size_t		num_threads;	/* number of threads being launched */
+} clserv_wgtune;
+
 extern bool clserv_compute_workgroup_size(size_t *gwork_sz,
 										  size_t *lwork_sz,
 										  cl_kernel kernel,
 										  int dev_index,
 										  bool larger_is_better,
 										  size_t num_threads,
-										  size_t local_memsz_per_thread);
+										  size_t local_memsz_per_thread,
+										  Datum dprog_key,
+										  clserv_wgtune *wgtune);
 /*
  * opencl_devprog.c
  */
@@ -588,33 +680,68 @@ extern bool clserv_compute_workgroup_size(size_t *gwork_sz,
 extern bool		devprog_enable_optimize;
 extern cl_program clserv_lookup_device_program(Datum dprog_key,
 											   pgstrom_message *msg);
+extern cl_kernel clserv_lookup_device_kernel(Datum dprog_key,
+											 const char *kernel_name,
+											 cl_int *errcode_ret);
 extern Datum pgstrom_get_devprog_key(const char *source, int32 extra_libs);
 extern void pgstrom_put_devprog_key(Datum dprog_key);
 extern Datum pgstrom_retain_devprog_key(Datum dprog_key);
+extern pgstrom_message *pgstrom_prebuild_devprog(Datum dprog_key);
+extern void pgstrom_perfmon_prebuild(pgstrom_perfmon *pfm,
+									 pgstrom_message *prebuild);
 extern const char *pgstrom_get_devprog_errmsg(Datum dprog_key);
 extern int32 pgstrom_get_devprog_extra_flags(Datum dprog_key);
 extern const char *pgstrom_get_devprog_kernel_source(Datum dprog_key);
 extern void pgstrom_init_opencl_devprog(void);
 extern Datum pgstrom_opencl_program_info(PG_FUNCTION_ARGS);
+extern Datum pgstrom_opencl_program_stat(PG_FUNCTION_ARGS);
+extern size_t clserv_wgtune_choose(clserv_wgtune *wgtune,
+								   Datum dprog_key,
+								   cl_kernel kernel,
+								   const char *kernel_name,
+								   int dindex,
+								   size_t min_lwork_sz,
+								   size_t max_lwork_sz,
+								   size_t lwork_sz,
+								   size_t num_threads);
+extern void clserv_wgtune_feedback(clserv_wgtune *wgtune,
+								   cl_event ev_begin, cl_event ev_end);
+extern void clserv_wgtune_save(void);
+extern void clserv_devprog_save_binaries(void);
+extern Datum pgstrom_opencl_workgroup_info(PG_FUNCTION_ARGS);
 
 /*
  * opencl_entry.c
  */
 extern void pgstrom_init_opencl_entry(void);
+extern bool opencl_entry_has_linker(void);
 extern const char *opencl_strerror(cl_int errcode);
 
 /*
  * opencl_serv.c
  */
+#define MAX_NUM_DEVICES		128
+
 extern cl_platform_id		opencl_platform_id;
 extern cl_context			opencl_context;
 extern cl_uint				opencl_num_devices;
 extern cl_device_id			opencl_devices[];
 extern cl_command_queue		opencl_cmdq[];
+extern int					opencl_num_threads;
+extern int					opencl_dma_staging_threshold;
+extern __thread int			clserv_thread_index;
 extern volatile bool		pgstrom_clserv_exit_pending;
 extern volatile bool		pgstrom_i_am_clserv;
 
-extern int pgstrom_opencl_device_schedule(pgstrom_message *message);
+extern int pgstrom_opencl_device_schedule(pgstrom_message *message,
+										  Size length);
+extern void pgstrom_opencl_device_dispatch(pgstrom_message *message,
+										   int dindex, Size length);
+extern void pgstrom_opencl_device_complete(pgstrom_message *message);
+extern double pgstrom_opencl_device_backlog(int dindex, int num_pending);
+extern cl_mem clserv_create_buffer(int dindex, Size length,
+								   pgstrom_perfmon *pfm, cl_int *errcode_ret);
+extern void clserv_release_buffer(int dindex, cl_mem mem);
 extern void pgstrom_init_opencl_server(void);
 
 extern void __clserv_log(const char *funcname,
@@ -630,6 +757,7 @@ extern void __clserv_log(const char *funcname,
 extern bool	pgstrom_enabled(void);
 extern bool pgstrom_perfmon_enabled;
 extern int	pgstrom_chunk_size;
+extern bool pgstrom_column_format;
 extern int	pgstrom_max_async_chunks;
 extern int	pgstrom_min_async_chunks;
 extern double pgstrom_gpu_setup_cost;
@@ -643,6 +771,9 @@ extern void show_scan_qual(List *qual, const char *qlabel,
 extern void show_instrumentation_count(const char *qlabel, int which,
 									   PlanState *planstate, ExplainState *es);
 extern void show_device_kernel(Datum dprog_key, ExplainState *es);
+extern bool pgstrom_reserve_async_chunk(int *p_max_async, bool has_pending);
+extern void pgstrom_release_async_chunk(void);
+extern void pgstrom_charge_async_chunk(pgstrom_data_store *pds);
 extern void pgstrom_perfmon_add(pgstrom_perfmon *pfm_sum,
 								pgstrom_perfmon *pfm_item);
 extern void pgstrom_perfmon_explain(pgstrom_perfmon *pfm,
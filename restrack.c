@@ -56,7 +56,8 @@ typedef struct {
 	 StromTagIs(sobject,GpuScan)	||	\
 	 StromTagIs(sobject,GpuPreAgg)	||	\
 	 StromTagIs(sobject,GpuHashJoin)||	\
-	 StromTagIs(sobject,HashJoinTable))
+	 StromTagIs(sobject,HashJoinTable)||\
+	 StromTagIs(sobject,DevProgBuild))
 
 #define RESTRACK_HASHSZ		100
 #define PTRMAP_HASHSZ		1200
@@ -17,9 +17,11 @@
  */
 #include "postgres.h"
 #include "access/htup_details.h"
+#include "access/xact.h"
 #include "catalog/pg_type.h"
 #include "funcapi.h"
 #include "lib/ilist.h"
+#include "miscadmin.h"
 #include "storage/barrier.h"
 #include "storage/ipc.h"
 #include "storage/shmem.h"
@@ -30,7 +32,11 @@
 #include "utils/pg_crc.h"
 #include "pg_strom.h"
 #include <limits.h>
+#include <sched.h>
+#include <strings.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 /*
  * management of shared memory segment in PG-Strom
@@ -38,13 +44,30 @@
  * Once a shared memory segment is allocated, PG-Strom split it into
  * multiple zones. A zone usually has more than 500MB, according to
  * the capability of OpenCL driver to map a parciular area as page-locked
- * memory. Also, it shall be associated with a particular NUMA node for
- * better memory access latency, in the future version.
+ * memory. Also, it is associated with a particular NUMA node for better
+ * memory access latency; allocation prefers zones local to the CPU on
+ * which the caller is running.
  * 
  * A zone contains a certain number of fixed-length (= SHMEM_BLOCKSZ) blocks. 
  * Block allocation system allocates 2^n blocks for the request.
  * On the other hand, context based allocation also allows to assign smaller
  * chunks on blocks being allocated by block allocation system.
+ *
+ * A zone is also split into a few sub-arenas; each of them is a range of
+ * 2^N blocks aligned to its length, and has its own lock and buddy free
+ * lists, so concurrent allocations on a zone does not serialize on a lock.
+ * Each arena also tracks a bitmap of orders whose free list is not empty,
+ * so we can find the least free block larger than required with a single
+ * find-first-set operation, instead of walking the free lists.
+ * A request larger than an arena takes a series of arenas being entirely
+ * free, under the locks of all the arenas in the zone. It is the slow
+ * path, but allows up to half of the zone as before.
+ *
+ * Block allocation is extent based; even though we pick up a 2^N blocks
+ * to satisfy the request, the tail blocks not needed are released to the
+ * free lists immediately, so a request consumes no more blocks than
+ * required. Once the extent is released, it is split into 2^N pieces
+ * again then merged with their buddies.
  */
 typedef struct
 {
@@ -61,18 +84,41 @@ typedef struct
 	  (block)->chain.prev != NULL) &&	\
 	 (block)->blocksz > 0)
 
+#define SHMEM_ZONE_MAX_ARENAS	16
+
 typedef struct
 {
 	slock_t		lock;
-	long		num_blocks;		/* number of total blocks */
+	long		start;			/* index of the first block */
+	long		num_blocks;		/* number of blocks in this arena */
+	uint32		free_mask;		/* bitmap of non-empty free_list */
+	long		active_blocks;	/* number of blocks in use */
+	Size		active_bytes;	/* sum of the requested length */
 	long		num_active[SHMEM_BLOCKSZ_BITS_RANGE + 1];
 	long		num_free[SHMEM_BLOCKSZ_BITS_RANGE + 1];
 	dlist_head	free_list[SHMEM_BLOCKSZ_BITS_RANGE + 1];
+} shmem_arena;
+
+typedef struct
+{
+	long		num_blocks;		/* number of total blocks */
+	int			numa_node;		/* NUMA node this zone is bound to */
+	int			num_arenas;		/* number of sub-arenas */
+	int			arena_shift;	/* length of arena (2^N blocks) */
+	shmem_arena	arenas[SHMEM_ZONE_MAX_ARENAS];
 	void	   *private;		/* cl_mem being mapped (Only OpenCL server) */
 	void	   *block_baseaddr;
 	shmem_block	blocks[FLEXIBLE_ARRAY_MEMBER];
 } shmem_zone;
 
+#define SHMEM_ZONE_GET_ARENA(zone,block_index)		\
+	(&(zone)->arenas[(block_index) >> (zone)->arena_shift])
+
+/* number of blocks consumed by an allocation of the supplied size */
+#define SHMEM_BODY_NBLOCKS(size)									\
+	((offsetof(shmem_body, data[0]) + (size) + sizeof(cl_uint) +	\
+	  SHMEM_BLOCKSZ - 1) >> SHMEM_BLOCKSZ_BITS)
+
 typedef struct {
 	dlist_node	chain;		/* link to the free list */
 	const char *filename;
@@ -97,6 +143,7 @@ static size_t slab_sizes[] = {
 	SHMEM_SLAB_SIZE(15),	/* about 512B */
 	SHMEM_SLAB_SIZE(6),		/* about 1.2KB */
 	SHMEM_SLAB_SIZE(3),		/* about 2.5KB */
+	SHMEM_SLAB_SIZE(2),		/* about 4KB */
 };
 #undef SHMEM_SLAB_SIZE
 
@@ -105,9 +152,18 @@ typedef struct
 	slock_t		slab_locks[lengthof(slab_sizes)];
 	dlist_head	slab_freelist[lengthof(slab_sizes)];
 	dlist_head	slab_blocklist[lengthof(slab_sizes)];
+	uint64		slab_mag_hits[lengthof(slab_sizes)];
+	uint64		slab_mag_miss[lengthof(slab_sizes)];
 
 	/* for zone management */
 	bool		is_ready;
+	uint32		alloc_hint;		/* round-robin counter for zone selection */
+	void	   *segment_baseaddr;	/* area to be split into zones */
+	void	   *segment_mapaddr;	/* address being mmap'ed, if any */
+	Size		segment_maplen;		/* length being mmap'ed, if any */
+	slock_t		reserve_lock;	/* lock for reserved_bytes */
+	Size		reserved_bytes;	/* total budget reserved by backends */
+	Size		segment_pagesz;	/* page size that backs the segment */
 	int			num_zones;
 	void	   *zone_baseaddr;
 	Size		zone_length;
@@ -124,6 +180,30 @@ typedef struct {
 
 /* XXX - we need to ensure SHMEM_ALLOC_COST is enough large */
 
+/*
+ * shmem_slab_magazine
+ *
+ * A per-thread cache of free slab entries for each slab class. Backend
+ * process and OpenCL server threads allocate/release slabs from/to its
+ * own magazine without any locks, then refill or drain the magazine in
+ * batch under the slab lock once it gets empty or full.
+ * Note that OpenCL runtime may invoke callbacks on the threads being
+ * unknown to us, so magazine is available only on the threads that
+ * called pgstrom_shmem_slab_magazine_init() explicitly. Entries in the
+ * magazine have neither free_list linkage nor filename, so they are
+ * not active but not on the freelist also.
+ */
+#define SHMEM_SLAB_MAGAZINE_SIZE	32
+#define SHMEM_SLAB_MAGAZINE_BATCH	(SHMEM_SLAB_MAGAZINE_SIZE / 2)
+
+typedef struct {
+	int			nitems[lengthof(slab_sizes)];
+	uint64		nhits[lengthof(slab_sizes)];	/* not counted yet */
+	shmem_slab *items[lengthof(slab_sizes)][SHMEM_SLAB_MAGAZINE_SIZE];
+} shmem_slab_magazine;
+
+static __thread shmem_slab_magazine *slab_magazine = NULL;
+
 #define SHMEM_BODY_MAGIC		0xabadcafe
 #define SHMEM_BLOCK_MAGIC		0xdeadbeaf
 #define SHMEM_SLAB_MAGIC		0xabadf11e
@@ -141,6 +221,29 @@ typedef struct {
 static shmem_startup_hook_type shmem_startup_hook_next;
 static Size			pgstrom_shmem_totalsize;
 static int			pgstrom_shmem_maxzones;
+static int			pgstrom_shmem_zone_arenas;
+static int			pgstrom_shmem_huge_pages;
+static int			pgstrom_numa_simulate_nodes;
+static int			pgstrom_shmem_reservable;
+static int			pgstrom_shmem_reserve_timeout;
+static Size			shmem_reserved_local = 0;	/* by this backend */
+static int			pgstrom_numa_nodes = 1;
+static int			pgstrom_numa_ncpus = 0;
+static int		   *pgstrom_numa_cpu_to_node = NULL;
+
+/*
+ * Options of pg_strom.shmem_huge_pages; the value is page size in KB
+ */
+#define SHMEM_HUGE_PAGES_OFF	0
+#define SHMEM_HUGE_PAGES_2MB	(2 * 1024)
+#define SHMEM_HUGE_PAGES_1GB	(1024 * 1024)
+
+static const struct config_enum_entry shmem_huge_pages_options[] = {
+	{"off", SHMEM_HUGE_PAGES_OFF, false},
+	{"2MB", SHMEM_HUGE_PAGES_2MB, false},
+	{"1GB", SHMEM_HUGE_PAGES_1GB, false},
+	{NULL, 0, false}
+};
 static shmem_head  *pgstrom_shmem_head;
 
 /*
@@ -193,75 +296,82 @@ find_least_pot(Size size)
 }
 
 /*
+ * Routines to manipulate free lists of arena, with free_mask maintenance
  *
- * XXX - caller must have lock of supplied zone
+ * XXX - caller must have lock of the supplied arena
  */
-static bool
-pgstrom_shmem_zone_block_split(shmem_zone *zone, int shift)
+static inline void
+shmem_arena_push_free(shmem_arena *arena, int shift, shmem_block *block)
 {
-	shmem_block	   *block;
-	dlist_node	   *dnode;
-	int				index;
-	int				i;
-
-	Assert(shift > 0 && shift <= SHMEM_BLOCKSZ_BITS_RANGE);
-	if (dlist_is_empty(&zone->free_list[shift]))
-	{
-		if (shift == SHMEM_BLOCKSZ_BITS_RANGE ||
-			!pgstrom_shmem_zone_block_split(zone, shift+1))
-			return false;
-	}
-	Assert(!dlist_is_empty(&zone->free_list[shift]));
-
-	dnode = dlist_pop_head_node(&zone->free_list[shift]);
-	zone->num_free[shift]--;
-
-	block = dlist_container(shmem_block, chain, dnode);
-	block->blocksz = (1 << (shift-1)) * SHMEM_BLOCKSZ;
-	index = block - &zone->blocks[0];
-	Assert((index & ((1UL << shift) - 1)) == 0);
-	dlist_push_tail(&zone->free_list[shift-1], &block->chain);
+	block->blocksz = (1UL << shift) * SHMEM_BLOCKSZ;
+	dlist_push_head(&arena->free_list[shift], &block->chain);
+	arena->num_free[shift]++;
+	arena->free_mask |= (1U << shift);
+}
 
-	/* is it exactly block head? */
-	for (i=1; i < (1 << shift); i++)
-		Assert(!BLOCK_IS_ACTIVE(block+i) && !BLOCK_IS_FREE(block+i));
+static inline void
+shmem_arena_delete_free(shmem_arena *arena, int shift, shmem_block *block)
+{
+	dlist_delete(&block->chain);
+	arena->num_free[shift]--;
+	if (dlist_is_empty(&arena->free_list[shift]))
+		arena->free_mask &= ~(1U << shift);
+}
 
-	block += (1 << (shift - 1));
-	block->blocksz = (1 << (shift-1)) * SHMEM_BLOCKSZ;
-	dlist_push_tail(&zone->free_list[shift-1], &block->chain);
+static inline shmem_block *
+shmem_arena_pop_free(shmem_arena *arena, int shift)
+{
+	dlist_node	   *dnode;
 
-	zone->num_free[shift-1] += 2;
+	Assert(!dlist_is_empty(&arena->free_list[shift]));
+	dnode = dlist_pop_head_node(&arena->free_list[shift]);
+	arena->num_free[shift]--;
+	if (dlist_is_empty(&arena->free_list[shift]))
+		arena->free_mask &= ~(1U << shift);
 
-	return true;
+	return dlist_container(shmem_block, chain, dnode);
 }
 
+/*
+ * pgstrom_shmem_arena_block_alloc
+ *
+ * It allocates an extent of blocks for the supplied size from the arena.
+ * The least free 2^N blocks being equal or larger than the required one
+ * is picked up using free_mask, then split into buddies until 2^shift
+ * blocks. Unused tail of the blocks are put back to the free list.
+ *
+ * XXX - caller must have lock of the supplied arena
+ */
 static void *
-pgstrom_shmem_zone_block_alloc(shmem_zone *zone,
-							   const char *filename, int lineno, Size size)
+pgstrom_shmem_arena_block_alloc(shmem_zone *zone, shmem_arena *arena,
+								const char *filename, int lineno,
+								Size size, int shift)
 {
 	shmem_block	*block;
 	shmem_body	*body;
-	dlist_node	*dnode;
-	Size	total_size;
-	int		shift;
-	int		index;
+	uint32	mask = arena->free_mask & ~((1U << shift) - 1);
+	long	nblocks = SHMEM_BODY_NBLOCKS(size);
+	long	pos;
+	int		curr;
+	long	index;
 	void   *address;
 	int		i;
 
-	total_size = offsetof(shmem_body, data[0]) + size + sizeof(cl_uint);
-	if (total_size > (1UL << SHMEM_BLOCKSZ_BITS_MAX))
-		return NULL;	/* too large size required */
-	shift = find_least_pot(total_size);
-	if (dlist_is_empty(&zone->free_list[shift]))
+	if (mask == 0)
+		return NULL;
+	curr = ffs(mask) - 1;
+
+	block = shmem_arena_pop_free(arena, curr);
+	Assert(block->blocksz == (1UL << curr) * SHMEM_BLOCKSZ);
+	index = block - &zone->blocks[0];
+	Assert((index & ((1UL << curr) - 1)) == 0);
+
+	/* split the block into buddies, and put the upper ones back */
+	while (curr > shift)
 	{
-		if (!pgstrom_shmem_zone_block_split(zone, shift+1))
-			return NULL;
+		curr--;
+		shmem_arena_push_free(arena, curr, block + (1UL << curr));
 	}
-	Assert(!dlist_is_empty(&zone->free_list[shift]));
-
-	dnode = dlist_pop_head_node(&zone->free_list[shift]);
-	block = dlist_container(shmem_block, chain, dnode);
-	Assert(block->blocksz == (1UL << shift) * SHMEM_BLOCKSZ);
 
 	memset(block, 0, sizeof(shmem_block));
 	block->blocksz = size;
@@ -270,11 +380,22 @@ pgstrom_shmem_zone_block_alloc(shmem_zone *zone,
 	for (i=1; i < (1 << shift); i++)
 		Assert(!BLOCK_IS_ACTIVE(block+i) && !BLOCK_IS_FREE(block+i));
 
-	index = block - &zone->blocks[0];
+	/*
+	 * Put back the tail blocks not needed. Every piece is aligned to its
+	 * length, and its buddy is a part of this extent, so no need to merge.
+	 */
+	Assert(nblocks > 0 && nblocks <= (1L << shift));
+	for (pos = nblocks; pos < (1L << shift); pos += (1L << curr))
+	{
+		curr = ffsl(pos) - 1;
+		shmem_arena_push_free(arena, curr, block + pos);
+	}
+
 	body = (shmem_body *)((char *)zone->block_baseaddr +
 						  index * SHMEM_BLOCKSZ);
-	zone->num_free[shift]--;
-	zone->num_active[shift]++;
+	arena->num_active[shift]++;
+	arena->active_blocks += nblocks;
+	arena->active_bytes += size;
 
 	/* tracking info */
 	body->magic = SHMEM_BODY_MAGIC;
@@ -289,37 +410,29 @@ pgstrom_shmem_zone_block_alloc(shmem_zone *zone,
 	return address;
 }
 
+/*
+ * pgstrom_shmem_arena_free_blocks
+ *
+ * It puts 2^shift blocks on the free list, and merge buddy blocks if
+ * possible.
+ *
+ * XXX - caller must have lock of the supplied arena
+ */
 static void
-pgstrom_shmem_zone_block_free(shmem_zone *zone, shmem_body *body)
+pgstrom_shmem_arena_free_blocks(shmem_zone *zone, shmem_arena *arena,
+								long index, int shift)
 {
-	shmem_block	   *block;
-	long			index;
-	long			shift;
-
-	Assert(ADDRESS_IN_SHMEM_ZONE(zone, body));
+	shmem_block	   *block = &zone->blocks[index];
 
-	index = ((uintptr_t)body -
-			 (uintptr_t)zone->block_baseaddr) / SHMEM_BLOCKSZ;
-	block = &zone->blocks[index];
-	Assert(BLOCK_IS_ACTIVE(block));
-	/* detect overrun */
-	Assert(*((cl_uint *)((uintptr_t)body->data +
-						 block->blocksz)) == SHMEM_BLOCK_MAGIC);
-	shift = find_least_pot(block->blocksz +
-						   offsetof(shmem_body, data[0]) +
-						   sizeof(cl_uint));
-	Assert(shift <= SHMEM_BLOCKSZ_BITS_RANGE);
 	Assert((index & ~((1UL << shift) - 1)) == index);
 
-	zone->num_active[shift]--;
-
 	/* try to merge buddy blocks if it is also free */
-	while (shift < SHMEM_BLOCKSZ_BITS_RANGE)
+	while (shift < zone->arena_shift)
 	{
 		shmem_block	   *buddy;
 		long			buddy_index = index ^ (1UL << shift);
 
-		if (buddy_index + (1UL << shift) >= zone->num_blocks)
+		if (buddy_index + (1UL << shift) > arena->start + arena->num_blocks)
 			break;
 
 		buddy = &zone->blocks[buddy_index];
@@ -332,7 +445,7 @@ pgstrom_shmem_zone_block_free(shmem_zone *zone, shmem_body *body)
 		/* ensure buddy is block head */
 		Assert(BLOCK_IS_FREE(buddy));
 
-		dlist_delete(&buddy->chain);
+		shmem_arena_delete_free(arena, shift, buddy);
 		if (buddy_index < index)
 		{
 			/* mark this block is not a head */
@@ -345,19 +458,410 @@ pgstrom_shmem_zone_block_free(shmem_zone *zone, shmem_body *body)
 			/* mark this block is not a head */
 			memset(buddy, 0, sizeof(shmem_block));
 		}
-		zone->num_free[shift]--;
 		shift++;
 	}
-	zone->num_free[shift]++;
-	block->blocksz = (1UL << shift) * SHMEM_BLOCKSZ;
-	dlist_push_head(&zone->free_list[shift], &block->chain);
+	shmem_arena_push_free(arena, shift, block);
 }
 
 /*
- * pgstrom_alloc_slab
+ * pgstrom_shmem_zone_lock / unlock
+ *
+ * It acquires (releases) locks of all the arenas in the supplied zone,
+ * for the routines that walk on the whole of zone.
+ */
+static void
+pgstrom_shmem_zone_lock(shmem_zone *zone)
+{
+	int		i;
+
+	for (i=0; i < zone->num_arenas; i++)
+		SpinLockAcquire(&zone->arenas[i].lock);
+}
+
+static void
+pgstrom_shmem_zone_unlock(shmem_zone *zone)
+{
+	int		i;
+
+	for (i=zone->num_arenas - 1; i >= 0; i--)
+		SpinLockRelease(&zone->arenas[i].lock);
+}
+
+/*
+ * pgstrom_shmem_arena_free_pieces
+ *
+ * It releases blocks in the range of [index, index + nblocks), being
+ * split into 2^N pieces aligned to their length.
+ *
+ * XXX - caller must have lock of the supplied arena
+ */
+static void
+pgstrom_shmem_arena_free_pieces(shmem_zone *zone, shmem_arena *arena,
+								long index, long nblocks)
+{
+	long	pos;
+	int		curr;
+
+	Assert(index >= arena->start &&
+		   index + nblocks <= arena->start + arena->num_blocks);
+	for (pos = 0; pos < nblocks; pos += (1L << curr))
+	{
+		curr = get_next_log2(nblocks - pos + 1) - 1;
+		if (index + pos > 0)
+			curr = Min(curr, ffsl(index + pos) - 1);
+		pgstrom_shmem_arena_free_blocks(zone, arena, index + pos, curr);
+	}
+}
+
+/*
+ * pgstrom_shmem_zone_oversize_alloc
+ *
+ * It allocates an extent larger than an arena. It needs a series of
+ * continuous arenas being entirely free; their free blocks are detached,
+ * and the tail not needed is put back to the last arena.
+ *
+ * XXX - caller must have locks of all the arenas in the zone
  */
 static void *
-pgstrom_alloc_slab(const char *filename, int lineno, int index)
+pgstrom_shmem_zone_oversize_alloc(shmem_zone *zone,
+								  const char *filename, int lineno,
+								  Size size, int shift)
+{
+	long		nblocks = SHMEM_BODY_NBLOCKS(size);
+	long		arena_len = (1L << zone->arena_shift);
+	int			num_arenas = (nblocks + arena_len - 1) >> zone->arena_shift;
+	int			base;
+	int			i, j;
+	long		index;
+	shmem_block *block;
+	shmem_body *body;
+	void	   *address;
+
+	for (base=0; base + num_arenas <= zone->num_arenas; base++)
+	{
+		for (i=0; i < num_arenas; i++)
+		{
+			shmem_arena *arena = &zone->arenas[base + i];
+			long		free_blocks = 0;
+
+			for (j=0; j <= zone->arena_shift; j++)
+				free_blocks += (arena->num_free[j] << j);
+			if (free_blocks < arena->num_blocks)
+				break;
+		}
+		if (i == num_arenas &&
+			zone->arenas[base].start + nblocks <=
+			zone->arenas[base + num_arenas - 1].start +
+			zone->arenas[base + num_arenas - 1].num_blocks)
+			break;
+	}
+	if (base + num_arenas > zone->num_arenas)
+		return NULL;
+
+	/* detach all the free blocks in the arenas */
+	for (i=0; i < num_arenas; i++)
+	{
+		shmem_arena *arena = &zone->arenas[base + i];
+		long		ofs;
+
+		for (ofs = 0; ofs < arena->num_blocks; ofs++)
+			memset(&zone->blocks[arena->start + ofs], 0,
+				   sizeof(shmem_block));
+		for (j=0; j <= zone->arena_shift; j++)
+		{
+			dlist_init(&arena->free_list[j]);
+			arena->num_free[j] = 0;
+		}
+		arena->free_mask = 0;
+		arena->active_blocks += Min(arena->num_blocks,
+									zone->arenas[base].start + nblocks -
+									arena->start);
+	}
+	index = zone->arenas[base].start;
+	block = &zone->blocks[index];
+	block->blocksz = size;
+	zone->arenas[base].num_active[shift]++;
+	zone->arenas[base].active_bytes += size;
+
+	/* put back the tail blocks not needed */
+	if (index + nblocks < zone->arenas[base + num_arenas - 1].start +
+		zone->arenas[base + num_arenas - 1].num_blocks)
+	{
+		shmem_arena *arena = &zone->arenas[base + num_arenas - 1];
+
+		pgstrom_shmem_arena_free_pieces(zone, arena, index + nblocks,
+										arena->start + arena->num_blocks -
+										(index + nblocks));
+	}
+
+	body = (shmem_body *)((char *)zone->block_baseaddr +
+						  index * SHMEM_BLOCKSZ);
+	body->magic = SHMEM_BODY_MAGIC;
+	body->owner = getpid();
+	body->filename = filename;	/* must be static cstring! */
+	body->lineno = lineno;
+	address = (void *)body->data;
+
+	/* to detect overrun */
+	*((cl_uint *)((uintptr_t)address + size)) = SHMEM_BLOCK_MAGIC;
+
+	return address;
+}
+
+/*
+ * pgstrom_shmem_zone_block_alloc
+ *
+ * It tries to allocate a memory block from the arenas of the supplied zone,
+ * starting from the arena pointed by the hint.
+ */
+static void *
+pgstrom_shmem_zone_block_alloc(shmem_zone *zone,
+							   const char *filename, int lineno,
+							   Size size, uint32 hint)
+{
+	shmem_arena *arena;
+	Size	total_size;
+	uint32	mask;
+	int		shift;
+	int		i;
+	void   *address;
+
+	total_size = offsetof(shmem_body, data[0]) + size + sizeof(cl_uint);
+	if (total_size > (1UL << SHMEM_BLOCKSZ_BITS_MAX))
+		return NULL;	/* too large size required */
+	shift = find_least_pot(total_size);
+	if (shift > zone->arena_shift)
+	{
+		/* larger than arena, so takes the slow path */
+		pgstrom_shmem_zone_lock(zone);
+		address = pgstrom_shmem_zone_oversize_alloc(zone, filename, lineno,
+													size, shift);
+		pgstrom_shmem_zone_unlock(zone);
+		return address;
+	}
+	mask = ~((1U << shift) - 1);
+
+	for (i=0; i < zone->num_arenas; i++)
+	{
+		arena = &zone->arenas[(hint + i) % zone->num_arenas];
+
+		/*
+		 * Quick check without lock. Even if we overlooked a block being
+		 * released concurrently, it is same as the case when allocation
+		 * came prior to the release.
+		 */
+		if ((arena->free_mask & mask) == 0)
+			continue;
+
+		SpinLockAcquire(&arena->lock);
+		address = pgstrom_shmem_arena_block_alloc(zone, arena,
+												  filename, lineno,
+												  size, shift);
+		SpinLockRelease(&arena->lock);
+
+		if (address)
+			return address;
+	}
+	return NULL;
+}
+
+/*
+ * pgstrom_shmem_zone_block_free
+ *
+ * It releases the supplied extent of blocks. The extent is split into
+ * 2^N pieces aligned to their length, then each of them is released.
+ * Note that head of the extent is not always aligned to 2^N, if it was
+ * expanded in-place by pgstrom_shmem_zone_block_resize().
+ * Lock of the arena is acquired in this function.
+ */
+static void
+pgstrom_shmem_zone_block_free(shmem_zone *zone, shmem_body *body)
+{
+	shmem_arena	   *arena;
+	shmem_block	   *block;
+	long			index;
+	long			nblocks;
+	int				shift;
+
+	Assert(ADDRESS_IN_SHMEM_ZONE(zone, body));
+
+	index = ((uintptr_t)body -
+			 (uintptr_t)zone->block_baseaddr) / SHMEM_BLOCKSZ;
+	arena = SHMEM_ZONE_GET_ARENA(zone, index);
+	block = &zone->blocks[index];
+
+	/*
+	 * Length of the extent is stable while it is active, so we can check
+	 * it prior to the lock, to determine whether it goes across arenas.
+	 */
+	nblocks = SHMEM_BODY_NBLOCKS(block->blocksz);
+	if (index + nblocks > arena->start + arena->num_blocks)
+	{
+		long	pos = index;
+		long	len;
+
+		pgstrom_shmem_zone_lock(zone);
+		Assert(BLOCK_IS_ACTIVE(block));
+		shift = find_least_pot(block->blocksz +
+							   offsetof(shmem_body, data[0]) +
+							   sizeof(cl_uint));
+		arena->num_active[shift]--;
+		arena->active_bytes -= block->blocksz;
+		memset(block, 0, sizeof(shmem_block));
+
+		while (pos < index + nblocks)
+		{
+			arena = SHMEM_ZONE_GET_ARENA(zone, pos);
+			len = Min(index + nblocks,
+					  arena->start + arena->num_blocks) - pos;
+			arena->active_blocks -= len;
+			pgstrom_shmem_arena_free_pieces(zone, arena, pos, len);
+			pos += len;
+		}
+		pgstrom_shmem_zone_unlock(zone);
+		return;
+	}
+
+	SpinLockAcquire(&arena->lock);
+	Assert(BLOCK_IS_ACTIVE(block));
+	/* detect overrun */
+	Assert(*((cl_uint *)((uintptr_t)body->data +
+						 block->blocksz)) == SHMEM_BLOCK_MAGIC);
+	shift = find_least_pot(block->blocksz +
+						   offsetof(shmem_body, data[0]) +
+						   sizeof(cl_uint));
+	Assert(shift <= zone->arena_shift);
+
+	arena->num_active[shift]--;
+	arena->active_blocks -= nblocks;
+	arena->active_bytes -= block->blocksz;
+
+	/* mark the head block is no longer active */
+	memset(block, 0, sizeof(shmem_block));
+
+	pgstrom_shmem_arena_free_pieces(zone, arena, index, nblocks);
+	SpinLockRelease(&arena->lock);
+}
+
+/*
+ * pgstrom_shmem_zone_block_resize
+ *
+ * It tries to resize the supplied extent of blocks in-place. If it needs
+ * more blocks, the following blocks have to be free and in the same arena.
+ * These free blocks are detached from the free list (the part not needed
+ * is put back), then merged to the extent. If it needs less blocks, the
+ * tail blocks are released. It returns false if we cannot resize in-place.
+ * Lock of the arena is acquired in this function.
+ */
+static bool
+pgstrom_shmem_zone_block_resize(shmem_zone *zone, shmem_body *body,
+								Size newsize)
+{
+	shmem_arena	   *arena;
+	shmem_block	   *block;
+	Size			oldsize;
+	long			index;
+	long			old_nblocks;
+	long			new_nblocks;
+	long			tail;
+	long			pos;
+	int				curr;
+	bool			result = false;
+
+	Assert(ADDRESS_IN_SHMEM_ZONE(zone, body));
+
+	new_nblocks = SHMEM_BODY_NBLOCKS(newsize);
+	index = ((uintptr_t)body -
+			 (uintptr_t)zone->block_baseaddr) / SHMEM_BLOCKSZ;
+	arena = SHMEM_ZONE_GET_ARENA(zone, index);
+	block = &zone->blocks[index];
+
+	SpinLockAcquire(&arena->lock);
+	Assert(BLOCK_IS_ACTIVE(block));
+	oldsize = block->blocksz;
+	old_nblocks = SHMEM_BODY_NBLOCKS(oldsize);
+
+	/* extent across the arenas is never resized in-place */
+	if (index + Max(old_nblocks,
+					new_nblocks) > arena->start + arena->num_blocks)
+		goto out;
+
+	if (new_nblocks > old_nblocks)
+	{
+
+		/*
+		 * Check whether the following blocks are free. Because free
+		 * blocks never overlap with active ones, a free block that covers
+		 * the next block to the extent has to begin at this block.
+		 */
+		for (pos = index + old_nblocks;
+			 pos < index + new_nblocks;
+			 pos += zone->blocks[pos].blocksz >> SHMEM_BLOCKSZ_BITS)
+		{
+			if (!BLOCK_IS_FREE(&zone->blocks[pos]))
+				goto out;
+		}
+
+		/* OK, detach the free blocks and merge them */
+		pos = index + old_nblocks;
+		while (pos < index + new_nblocks)
+		{
+			shmem_block	   *fblock = &zone->blocks[pos];
+
+			curr = find_least_pot(fblock->blocksz);
+			tail = pos + (1L << curr);
+			shmem_arena_delete_free(arena, curr, fblock);
+			memset(fblock, 0, sizeof(shmem_block));
+
+			/* put back the part not needed */
+			for (pos = index + new_nblocks; pos < tail; pos += (1L << curr))
+			{
+				curr = Min(get_next_log2(tail - pos + 1) - 1,
+						   ffsl(pos) - 1);
+				shmem_arena_push_free(arena, curr, &zone->blocks[pos]);
+			}
+			pos = tail;
+		}
+	}
+	else if (new_nblocks < old_nblocks)
+	{
+		/* release the tail blocks not needed */
+		for (pos = index + new_nblocks;
+			 pos < index + old_nblocks;
+			 pos += (1L << curr))
+		{
+			curr = Min(get_next_log2(index + old_nblocks - pos + 1) - 1,
+					   ffsl(pos) - 1);
+			pgstrom_shmem_arena_free_blocks(zone, arena, pos, curr);
+		}
+	}
+	arena->num_active[find_least_pot(offsetof(shmem_body, data[0]) +
+									 oldsize + sizeof(cl_uint))]--;
+	arena->num_active[find_least_pot(offsetof(shmem_body, data[0]) +
+									 newsize + sizeof(cl_uint))]++;
+	arena->active_blocks += (new_nblocks - old_nblocks);
+	arena->active_bytes += (newsize - oldsize);
+
+	block->blocksz = newsize;
+	/* to detect overrun */
+	*((cl_uint *)((uintptr_t)body->data + newsize)) = SHMEM_BLOCK_MAGIC;
+	result = true;
+out:
+	SpinLockRelease(&arena->lock);
+
+	return result;
+}
+
+/*
+ * pgstrom_slab_pop_entry
+ *
+ * It pops a free slab entry from the global freelist, or allocates a new
+ * block for slabs if freelist is empty.
+ *
+ * XXX - caller must have the slab lock of the supplied index
+ */
+static shmem_slab *
+pgstrom_slab_pop_entry(const char *filename, int lineno, int index)
 {
 	shmem_slab_head *sblock;
 	shmem_slab	   *entry;
@@ -365,7 +869,7 @@ pgstrom_alloc_slab(const char *filename, int lineno, int index)
 	Size			slab_sz = slab_sizes[index];
 	Size			unitsz = MAXALIGN(offsetof(shmem_slab, data[0]) +
 									  INTALIGN(slab_sz) + sizeof(cl_uint));
-	SpinLockAcquire(&pgstrom_shmem_head->slab_locks[index]);
+
 	if (dlist_is_empty(&pgstrom_shmem_head->slab_freelist[index]))
 	{
 		Size		length;
@@ -376,10 +880,7 @@ pgstrom_alloc_slab(const char *filename, int lineno, int index)
 		sblock = __pgstrom_shmem_alloc_alap(filename, lineno,
 											sizeof(shmem_slab_head), &length);
 		if (!sblock)
-		{
-			SpinLockRelease(&pgstrom_shmem_head->slab_locks[index]);
 			return NULL;
-		}
 		dlist_push_tail(&pgstrom_shmem_head->slab_blocklist[index],
 						&sblock->chain);
 
@@ -401,10 +902,84 @@ pgstrom_alloc_slab(const char *filename, int lineno, int index)
 	dnode = dlist_pop_head_node(&pgstrom_shmem_head->slab_freelist[index]);
 	entry = dlist_container(shmem_slab, chain, dnode);
 	memset(&entry->chain, 0, sizeof(dlist_node));
+
+	return entry;
+}
+
+/*
+ * pgstrom_shmem_slab_magazine_cleanup
+ *
+ * on_shmem_exit callback to return the cached slabs to the freelists.
+ */
+static void
+pgstrom_shmem_slab_magazine_cleanup(int code, Datum arg)
+{
+	pgstrom_shmem_slab_magazine_flush();
+}
+
+/*
+ * pgstrom_get_slab_magazine
+ *
+ * It returns the slab magazine of the current thread, if available.
+ * Backend process sets up its magazine on the first invocation.
+ */
+static inline shmem_slab_magazine *
+pgstrom_get_slab_magazine(void)
+{
+	if (!slab_magazine && !pgstrom_i_am_clserv && IsUnderPostmaster)
+	{
+		if (pgstrom_shmem_slab_magazine_init())
+			on_shmem_exit(pgstrom_shmem_slab_magazine_cleanup, 0);
+	}
+	return slab_magazine;
+}
+
+/*
+ * pgstrom_alloc_slab
+ */
+static void *
+pgstrom_alloc_slab(const char *filename, int lineno, int index)
+{
+	shmem_slab_magazine *magazine = pgstrom_get_slab_magazine();
+	shmem_slab	   *entry;
+
+	if (!magazine)
+	{
+		SpinLockAcquire(&pgstrom_shmem_head->slab_locks[index]);
+		entry = pgstrom_slab_pop_entry(filename, lineno, index);
+		SpinLockRelease(&pgstrom_shmem_head->slab_locks[index]);
+		if (!entry)
+			return NULL;
+	}
+	else
+	{
+		if (magazine->nitems[index] > 0)
+			magazine->nhits[index]++;
+		else
+		{
+			/* refill the magazine in batch */
+			SpinLockAcquire(&pgstrom_shmem_head->slab_locks[index]);
+			pgstrom_shmem_head->slab_mag_hits[index] += magazine->nhits[index];
+			pgstrom_shmem_head->slab_mag_miss[index]++;
+			magazine->nhits[index] = 0;
+			while (magazine->nitems[index] < SHMEM_SLAB_MAGAZINE_BATCH)
+			{
+				entry = pgstrom_slab_pop_entry(filename, lineno, index);
+				if (!entry)
+					break;
+				magazine->items[index][magazine->nitems[index]++] = entry;
+			}
+			SpinLockRelease(&pgstrom_shmem_head->slab_locks[index]);
+
+			if (magazine->nitems[index] == 0)
+				return NULL;
+		}
+		entry = magazine->items[index][--magazine->nitems[index]];
+		Assert(!entry->chain.next && !entry->chain.prev);
+	}
 	entry->owner = getpid();
 	entry->filename = filename;
 	entry->lineno = lineno;
-	SpinLockRelease(&pgstrom_shmem_head->slab_locks[index]);
 
 	return (void *)entry->data;
 }
@@ -420,10 +995,12 @@ pgstrom_alloc_slab(const char *filename, int lineno, int index)
 void *
 __pgstrom_shmem_alloc(const char *filename, int lineno, Size size)
 {
-	static int	zone_index = 0;
-	int			start;
 	shmem_zone *zone;
-	void	   *address;
+	void	   *address = NULL;
+	uint32		hint;
+	int			num_zones;
+	int			numa_node;
+	int			pass;
 	int			i;
 
 	/* does shared memory segment already set up? */
@@ -447,25 +1024,34 @@ __pgstrom_shmem_alloc(const char *filename, int lineno, Size size)
 
 	/*
 	 * find a zone we should allocate.
+	 * Zone (and arena within the zone) is picked up in round-robin manner
+	 * using a shared counter being incremented without locks.
 	 *
 	 * XXX - To be put more wise zone selection
 	 *  - NUMA aware
 	 *  - Memory reclaim when no blocks are available
 	 */
-	start = zone_index;
-	do {
-		zone = pgstrom_shmem_head->zones[zone_index];
-		SpinLockAcquire(&zone->lock);
-
-		address = pgstrom_shmem_zone_block_alloc(zone, filename, lineno, size);
-
-		SpinLockRelease(&zone->lock);
-
-		if (address)
-			break;
-
-		zone_index = (zone_index + 1) % pgstrom_shmem_head->num_zones;
-	} while (zone_index != start);
+#ifdef __GNUC__
+	hint = __sync_fetch_and_add(&pgstrom_shmem_head->alloc_hint, 1);
+#else
+	hint = pgstrom_shmem_head->alloc_hint++;	/* just a hint, so racy */
+#endif
+	num_zones = pgstrom_shmem_head->num_zones;
+	numa_node = pgstrom_numa_current_node();
+	/* 1st trial on local zones, then 2nd trial on remote zones */
+	for (pass=0; !address && pass < 2; pass++)
+	{
+		for (i=0; i < num_zones; i++)
+		{
+			zone = pgstrom_shmem_head->zones[(hint + i) % num_zones];
+			if ((zone->numa_node == numa_node) != (pass == 0))
+				continue;
+			address = pgstrom_shmem_zone_block_alloc(zone, filename, lineno,
+													 size, hint / num_zones);
+			if (address)
+				break;
+		}
+	}
 #ifdef PGSTROM_DEBUG
 	/* For debugging, we dump current status of shared memory segment
 	 * if we have to return "out of shared memory" error */
@@ -483,10 +1069,10 @@ __pgstrom_shmem_alloc(const char *filename, int lineno, Size size)
  * pgstrom_shmem_alloc_alap
  *
  * pgstrom_shmem_alloc "as large as possible"
- * It is unavoidable to make unused memory area in buddy memory allocation
- * algorithm. In case when we want to acquire a memory block larget than
- * a particular size, likely toast buffer, best storategy is to allocate
- * least 2^N block larger than required size.
+ * Block allocation consumes a certain number of blocks, so it makes unused
+ * memory area at tail of the last block. In case when we want to acquire
+ * a memory block larger than a particular size, likely toast buffer, best
+ * storategy is to use up the blocks to be allocated.
  * This function round up the required size into the best-fit one.
  *
  * Also note that, it never falls to slab.
@@ -495,10 +1081,10 @@ void *
 __pgstrom_shmem_alloc_alap(const char *filename, int lineno,
 						   Size required, Size *allocated)
 {
-	int		shift = find_least_pot(required + sizeof(cl_uint));
+	Size	nblocks = SHMEM_BODY_NBLOCKS(required);
 	void   *result;
 
-	required = (1UL << (shift + SHMEM_BLOCKSZ_BITS))
+	required = (nblocks << SHMEM_BLOCKSZ_BITS)
 		- offsetof(shmem_body, data[0])
 		- sizeof(cl_uint);
 	result = __pgstrom_shmem_alloc(filename, lineno, required);
@@ -513,15 +1099,90 @@ __pgstrom_shmem_alloc_alap(const char *filename, int lineno,
 static void
 pgstrom_free_slab(shmem_slab_head *sblock, shmem_slab *entry)
 {
+	shmem_slab_magazine *magazine = pgstrom_get_slab_magazine();
 	int		index = sblock->slab_index;
+	int		i;
 
 	Assert(!entry->chain.next && !entry->chain.prev);
 	Assert(*((uint32 *)((char *)entry->data +
 						INTALIGN(slab_sizes[index]))) == SHMEM_SLAB_MAGIC);
-	SpinLockAcquire(&pgstrom_shmem_head->slab_locks[index]);
-	dlist_push_head(&pgstrom_shmem_head->slab_freelist[index],
-					&entry->chain);
-	SpinLockRelease(&pgstrom_shmem_head->slab_locks[index]);
+	entry->filename = NULL;
+	entry->lineno = 0;
+
+	if (!magazine)
+	{
+		SpinLockAcquire(&pgstrom_shmem_head->slab_locks[index]);
+		dlist_push_head(&pgstrom_shmem_head->slab_freelist[index],
+						&entry->chain);
+		SpinLockRelease(&pgstrom_shmem_head->slab_locks[index]);
+		return;
+	}
+
+	/* drain the magazine in batch, if full */
+	if (magazine->nitems[index] == SHMEM_SLAB_MAGAZINE_SIZE)
+	{
+		SpinLockAcquire(&pgstrom_shmem_head->slab_locks[index]);
+		for (i=0; i < SHMEM_SLAB_MAGAZINE_BATCH; i++)
+		{
+			shmem_slab *temp = magazine->items[index][--magazine->nitems[index]];
+
+			dlist_push_head(&pgstrom_shmem_head->slab_freelist[index],
+							&temp->chain);
+		}
+		SpinLockRelease(&pgstrom_shmem_head->slab_locks[index]);
+	}
+	magazine->items[index][magazine->nitems[index]++] = entry;
+}
+
+/*
+ * pgstrom_shmem_slab_magazine_init
+ *
+ * It sets up a slab magazine for the current thread. Caller has to flush
+ * the magazine using pgstrom_shmem_slab_magazine_flush() prior to exit of
+ * the thread, or entries in the magazine shall be leaked.
+ */
+bool
+pgstrom_shmem_slab_magazine_init(void)
+{
+	if (!slab_magazine)
+	{
+		slab_magazine = calloc(1, sizeof(shmem_slab_magazine));
+		if (!slab_magazine)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * pgstrom_shmem_slab_magazine_flush
+ *
+ * It returns all the entries in the magazine of the current thread to
+ * the global freelist, then release the magazine itself.
+ */
+void
+pgstrom_shmem_slab_magazine_flush(void)
+{
+	shmem_slab_magazine *magazine = slab_magazine;
+	int		index;
+
+	if (!magazine)
+		return;
+
+	for (index=0; index < lengthof(slab_sizes); index++)
+	{
+		SpinLockAcquire(&pgstrom_shmem_head->slab_locks[index]);
+		while (magazine->nitems[index] > 0)
+		{
+			shmem_slab *entry = magazine->items[index][--magazine->nitems[index]];
+
+			dlist_push_head(&pgstrom_shmem_head->slab_freelist[index],
+							&entry->chain);
+		}
+		pgstrom_shmem_head->slab_mag_hits[index] += magazine->nhits[index];
+		SpinLockRelease(&pgstrom_shmem_head->slab_locks[index]);
+	}
+	slab_magazine = NULL;
+	free(magazine);
 }
 
 void
@@ -557,33 +1218,66 @@ pgstrom_shmem_free(void *address)
 	Assert(zone_index >= 0 && zone_index < pgstrom_shmem_head->num_zones);
 
 	zone = pgstrom_shmem_head->zones[zone_index];
-	SpinLockAcquire(&zone->lock);
 	pgstrom_shmem_zone_block_free(zone, body);
-	SpinLockRelease(&zone->lock);
 }
 
 /*
  * pgstrom_shmem_realloc
  *
- * It allocate a shared memory block, and copy the contents in the supplied
- * oldaddr to the new one, then release shared memory block.
+ * It tries to resize the supplied block in-place, if the following blocks
+ * are free. Elsewhere, it allocate a shared memory block, and copy the
+ * contents in the supplied oldaddr to the new one, then release shared
+ * memory block.
  */
 void *
 __pgstrom_shmem_realloc(const char *filename, int lineno,
 						void *oldaddr, Size newsize)
 {
 	void   *newaddr;
+	Size	oldsize;
+	Size	offset;
+
+	if (!oldaddr)
+		return __pgstrom_shmem_alloc(filename, lineno, newsize);
+
+	offset = ((uintptr_t)oldaddr & (SHMEM_BLOCKSZ - 1));
+	if (offset != offsetof(shmem_body, data[0]))
+	{
+		/* oldaddr is a slab */
+		shmem_slab_head *sblock = (shmem_slab_head *)
+			((char *)oldaddr - offset + offsetof(shmem_body, data));
+
+		oldsize = slab_sizes[sblock->slab_index];
+	}
+	else
+	{
+		shmem_body *body = (shmem_body *)
+			((char *)oldaddr - offsetof(shmem_body, data[0]));
+		void	   *zone_baseaddr = pgstrom_shmem_head->zone_baseaddr;
+		Size		zone_length = pgstrom_shmem_head->zone_length;
+		int			zone_index;
+
+		/* no need to fall into slabs, if it is enough small */
+		if (newsize > 0 && newsize <= pgstrom_shmem_maxalloc())
+		{
+			zone_index = ((uintptr_t)body -
+						  (uintptr_t)zone_baseaddr) / zone_length;
+			Assert(zone_index >= 0 &&
+				   zone_index < pgstrom_shmem_head->num_zones);
+			if (pgstrom_shmem_zone_block_resize(pgstrom_shmem_head->
+												zones[zone_index],
+												body, newsize))
+				return oldaddr;
+		}
+		oldsize = pgstrom_shmem_getsize(oldaddr);
+	}
 
 	newaddr = __pgstrom_shmem_alloc(filename, lineno, newsize);
 	if (!newaddr)
 		return NULL;
-	if (oldaddr)
-	{
-		Size	oldsize = pgstrom_shmem_getsize(oldaddr);
+	memcpy(newaddr, oldaddr, Min(newsize, oldsize));
+	pgstrom_shmem_free(oldaddr);
 
-		memcpy(newaddr, oldaddr, Min(newsize, oldsize));
-		pgstrom_shmem_free(oldaddr);
-	}
 	return newaddr;
 }
 
@@ -596,6 +1290,7 @@ Size
 pgstrom_shmem_getsize(void *address)
 {
 	shmem_zone *zone;
+	shmem_arena *arena;
 	shmem_body *body;
 	shmem_block *block;
 	void	   *zone_baseaddr = pgstrom_shmem_head->zone_baseaddr;
@@ -613,18 +1308,120 @@ pgstrom_shmem_getsize(void *address)
 	zone = pgstrom_shmem_head->zones[index];
 
 	/* find shmem_block and get its status */
-	SpinLockAcquire(&zone->lock);
 	index = ((uintptr_t)body -
 			 (uintptr_t)zone->block_baseaddr) / SHMEM_BLOCKSZ;
+	arena = SHMEM_ZONE_GET_ARENA(zone, index);
+	SpinLockAcquire(&arena->lock);
 	block = &zone->blocks[index];
 	Assert(BLOCK_IS_ACTIVE(block));
 	blocksz = block->blocksz;
-    pgstrom_shmem_zone_block_free(zone, body);
-    SpinLockRelease(&zone->lock);
+	SpinLockRelease(&arena->lock);
 
 	return blocksz;
 }
 
+/*
+ * pgstrom_shmem_reserve
+ *
+ * It reserves an allocation budget of shared memory segment. Sum of the
+ * budget being reserved is limited to pg_strom.shmem_reservable percent
+ * of the total size, so backends can throttle their memory consumption
+ * prior to exhaustion of shared memory; that raises an error.
+ * If wait = true, it blocks until the budget gets available, up to
+ * pg_strom.shmem_reserve_timeout milliseconds, then returns false if
+ * timed out. Elsewhere, it returns false immediately.
+ * The budget is released by pgstrom_shmem_unreserve(), or at end of the
+ * transaction.
+ */
+static bool
+pgstrom_shmem_try_reserve(Size length, bool force)
+{
+	Size	limit = (pgstrom_shmem_totalsize / 100) * pgstrom_shmem_reservable;
+	bool	result = false;
+
+	SpinLockAcquire(&pgstrom_shmem_head->reserve_lock);
+	/* a request larger than the limit is allowed if nobody reserves */
+	if (force ||
+		pgstrom_shmem_head->reserved_bytes + length <= limit ||
+		pgstrom_shmem_head->reserved_bytes == 0)
+	{
+		pgstrom_shmem_head->reserved_bytes += length;
+		result = true;
+	}
+	SpinLockRelease(&pgstrom_shmem_head->reserve_lock);
+
+	if (result)
+		shmem_reserved_local += length;
+	return result;
+}
+
+bool
+pgstrom_shmem_reserve(Size length, bool wait)
+{
+	struct timeval	tv1, tv2;
+	long			sleep_us = 1000;
+
+	if (pgstrom_shmem_try_reserve(length, false))
+		return true;
+	if (!wait)
+		return false;
+
+	gettimeofday(&tv1, NULL);
+	for (;;)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		pg_usleep(sleep_us);
+		if (pgstrom_shmem_try_reserve(length, false))
+			return true;
+
+		gettimeofday(&tv2, NULL);
+		if (timeval_diff(&tv1, &tv2) / 1000 >= pgstrom_shmem_reserve_timeout)
+			break;
+		sleep_us = Min(2 * sleep_us, 100000);	/* up to 100ms */
+	}
+	return false;
+}
+
+/*
+ * pgstrom_shmem_reserve_force
+ *
+ * It adds the budget regardless of the limit; used to account the memory
+ * already allocated beyond the estimation.
+ */
+void
+pgstrom_shmem_reserve_force(Size length)
+{
+	pgstrom_shmem_try_reserve(length, true);
+}
+
+void
+pgstrom_shmem_unreserve(Size length)
+{
+	length = Min(length, shmem_reserved_local);
+
+	SpinLockAcquire(&pgstrom_shmem_head->reserve_lock);
+	Assert(pgstrom_shmem_head->reserved_bytes >= length);
+	pgstrom_shmem_head->reserved_bytes -= length;
+	SpinLockRelease(&pgstrom_shmem_head->reserve_lock);
+
+	shmem_reserved_local -= length;
+}
+
+/*
+ * pgstrom_shmem_reserve_xact_callback
+ *
+ * It releases the budget still reserved at end of the transaction; that
+ * usually happen when the transaction is aborted.
+ */
+static void
+pgstrom_shmem_reserve_xact_callback(XactEvent event, void *arg)
+{
+	if ((event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT) &&
+		shmem_reserved_local > 0)
+		pgstrom_shmem_unreserve(shmem_reserved_local);
+}
+
 /*
  * pgstrom_shmem_zone_length
  *
@@ -652,9 +1449,8 @@ pgstrom_shmem_maxalloc(void)
 		int		nbits;
 
 		zone_length = Min(zone_length, (1UL << SHMEM_BLOCKSZ_BITS_MAX));
-		nbits = get_next_log2(zone_length + 1);
-
-		maxalloc_length = ((1UL << (nbits - 1)) -	/* half of zone */
+		nbits = get_next_log2(zone_length + 1) - 1;	/* half of zone */
+		maxalloc_length = ((1UL << nbits) -
 						   offsetof(shmem_body, data[0]) -
 						   sizeof(cl_uint));
 	}
@@ -676,6 +1472,8 @@ pgstrom_init_slab(void)
 		SpinLockInit(&pgstrom_shmem_head->slab_locks[i]);
 		dlist_init(&pgstrom_shmem_head->slab_freelist[i]);
 		dlist_init(&pgstrom_shmem_head->slab_blocklist[i]);
+		pgstrom_shmem_head->slab_mag_hits[i] = 0;
+		pgstrom_shmem_head->slab_mag_miss[i] = 0;
 	}
 }
 
@@ -693,22 +1491,32 @@ typedef struct
 	uint32		owner;
 	bool		active;
 	bool		broken;
+	double		hit_ratio;	/* magazine hit ratio of this slab class */
 } shmem_slab_info;
 
 static void
-collect_shmem_slab_info(List **p_results,
-						slock_t *slab_lock,
-						dlist_head *slab_blocklist,
-						size_t slab_size)
+collect_shmem_slab_info(List **p_results, int index)
 {
+	slock_t	   *slab_lock = &pgstrom_shmem_head->slab_locks[index];
+
 	SpinLockAcquire(slab_lock);
 	PG_TRY();
 	{
 		dlist_iter	iter;
+		Size		slab_size = slab_sizes[index];
 		Size		unitsz = MAXALIGN(offsetof(shmem_slab, data[0]) +
 									  INTALIGN(slab_size) +
 									  sizeof(uint32));
-		dlist_foreach (iter, slab_blocklist)
+		uint64		nhits = pgstrom_shmem_head->slab_mag_hits[index];
+		uint64		nmiss = pgstrom_shmem_head->slab_mag_miss[index];
+		double		hit_ratio;
+
+		if (nhits + nmiss > 0)
+			hit_ratio = (double) nhits / (double)(nhits + nmiss);
+		else
+			hit_ratio = 0.0;
+
+		dlist_foreach (iter, &pgstrom_shmem_head->slab_blocklist[index])
 		{
 			shmem_slab_head *sblock;
 			shmem_slab *entry;
@@ -728,13 +1536,17 @@ collect_shmem_slab_info(List **p_results,
 				slinfo->lineno    = entry->lineno;
 				slinfo->index     = sblock->slab_index;
 				slinfo->owner     = entry->owner;
-				slinfo->active    = (!entry->chain.prev && !entry->chain.next);
+				/* entries in magazine have neither chain nor filename */
+				slinfo->active    = (!entry->chain.prev &&
+									 !entry->chain.next &&
+									 entry->filename != NULL);
 				if (*magic != SHMEM_SLAB_MAGIC ||
 					(!entry->chain.prev && entry->chain.next) ||
 					(entry->chain.prev && !entry->chain.next))
 					slinfo->broken = true;
 				else
 					slinfo->broken = false;
+				slinfo->hit_ratio = hit_ratio;
 
 				*p_results = lappend(*p_results, slinfo);
 			}
@@ -755,8 +1567,8 @@ pgstrom_shmem_slab_info(PG_FUNCTION_ARGS)
 	FuncCallContext	   *fncxt;
 	shmem_slab_info	   *slinfo;
 	HeapTuple			tuple;
-	Datum				values[6];
-	bool				isnull[6];
+	Datum				values[7];
+	bool				isnull[7];
 	char				buf[256];
 
 	if (SRF_IS_FIRSTCALL())
@@ -768,7 +1580,7 @@ pgstrom_shmem_slab_info(PG_FUNCTION_ARGS)
 		fncxt = SRF_FIRSTCALL_INIT();
 		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
 
-		tupdesc = CreateTemplateTupleDesc(6, false);
+		tupdesc = CreateTemplateTupleDesc(7, false);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "address",
 						   INT8OID, -1, 0);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "slabname",
@@ -781,16 +1593,13 @@ pgstrom_shmem_slab_info(PG_FUNCTION_ARGS)
 						   BOOLOID, -1, 0);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 6, "broken",
 						   BOOLOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 7, "mag_hitratio",
+						   FLOAT8OID, -1, 0);
 		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
 
 		for (i=0; i < lengthof(slab_sizes); i++)
-		{
+			collect_shmem_slab_info((List **)&fncxt->user_fctx, i);
 
-			collect_shmem_slab_info((List **)&fncxt->user_fctx,
-									&pgstrom_shmem_head->slab_locks[i],
-									&pgstrom_shmem_head->slab_blocklist[i],
-									slab_sizes[i]);
-		}
 		MemoryContextSwitchTo(oldcxt);
 	}
 	fncxt = SRF_PERCALL_SETUP();
@@ -818,6 +1627,7 @@ pgstrom_shmem_slab_info(PG_FUNCTION_ARGS)
 	}
 	values[4] = BoolGetDatum(slinfo->active);
 	values[5] = BoolGetDatum(slinfo->broken);
+	values[6] = Float8GetDatum(slinfo->hit_ratio);
 
 	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
 
@@ -891,10 +1701,7 @@ pgstrom_shmem_dump_zone(shmem_zone *zone, int zone_index)
 		{
 			shmem_body	   *body;
 			cl_uint		   *p_magic;
-			int				nshift;
 
-			nshift = find_least_pot(offsetof(shmem_body, data[0]) +
-									block->blocksz + sizeof(cl_uint));
 			body = (shmem_body *)((char *)zone->block_baseaddr +
 								  i * SHMEM_BLOCKSZ);
 			p_magic = (cl_uint *)((char *)body->data + block->blocksz);
@@ -907,7 +1714,7 @@ pgstrom_shmem_dump_zone(shmem_zone *zone, int zone_index)
 				 body->lineno,
 				 body->magic != SHMEM_BODY_MAGIC ? ", broken" : "",
 				 *p_magic != SHMEM_BLOCK_MAGIC ? ", overrun" : "");
-			i += (1 << nshift);
+			i += SHMEM_BODY_NBLOCKS(block->blocksz);
 		}
 		else if (BLOCK_IS_FREE(block))
 		{
@@ -935,9 +1742,9 @@ pgstrom_shmem_dump(void)
 	{
 		shmem_zone *zone = pgstrom_shmem_head->zones[i];
 
-		SpinLockAcquire(&zone->lock);
+		pgstrom_shmem_zone_lock(zone);
 		pgstrom_shmem_dump_zone(zone, i);
-		SpinLockRelease(&zone->lock);
+		pgstrom_shmem_zone_unlock(zone);
 	}
 }
 
@@ -947,6 +1754,10 @@ pgstrom_shmem_dump(void)
  * It collects statistical information of shared memory zone.
  * Note that it does not trust statistical values if debug build, thus
  * it may take longer time because of walking of shared memory zone.
+ *
+ * Fragmentation of the zone is also reported; int_frag is ratio of the
+ * unused area in the active blocks, and ext_frag is ratio of the free
+ * blocks not available for the largest possible allocation.
  */
 typedef struct
 {
@@ -954,6 +1765,9 @@ typedef struct
 	int		shift;
 	int		num_active;
 	int		num_free;
+	int		numa_node;
+	double	int_frag;
+	double	ext_frag;
 } shmem_block_info;
 
 static List *
@@ -962,6 +1776,12 @@ collect_shmem_block_info(shmem_zone *zone, int zone_index)
 	List	   *results = NIL;
 	long		num_active[SHMEM_BLOCKSZ_BITS_RANGE + 1];
 	long		num_free[SHMEM_BLOCKSZ_BITS_RANGE + 1];
+	long		active_blocks = 0;
+	Size		active_bytes = 0;
+	long		free_blocks = 0;
+	long		largest_free = 0;
+	double		int_frag = 0.0;
+	double		ext_frag = 0.0;
 	long		i;
 
 	/*
@@ -986,7 +1806,7 @@ collect_shmem_block_info(shmem_zone *zone, int zone_index)
 											sizeof(cl_uint));
 			Assert(nshift <= SHMEM_BLOCKSZ_BITS_RANGE);
 			num_active[nshift]++;
-			i += (1 << nshift);
+			i += SHMEM_BODY_NBLOCKS(block->blocksz);
 		}
 		else if (BLOCK_IS_FREE(block))
 		{
@@ -1000,17 +1820,49 @@ collect_shmem_block_info(shmem_zone *zone, int zone_index)
 			elog(ERROR, "block %ld is neither active nor free", i);
 	}
 #else
-	memcpy(num_active, zone->num_active, sizeof(num_active));
-	memcpy(num_free, zone->num_free, sizeof(num_free));
+	memset(num_active, 0, sizeof(num_active));
+	memset(num_free, 0, sizeof(num_free));
+	for (i=0; i < zone->num_arenas; i++)
+	{
+		shmem_arena	*arena = &zone->arenas[i];
+		int			j;
+
+		for (j=0; j <= SHMEM_BLOCKSZ_BITS_RANGE; j++)
+		{
+			num_active[j] += arena->num_active[j];
+			num_free[j] += arena->num_free[j];
+		}
+	}
 #endif
+	/* fragmentation */
+	for (i=0; i < zone->num_arenas; i++)
+	{
+		active_blocks += zone->arenas[i].active_blocks;
+		active_bytes += zone->arenas[i].active_bytes;
+	}
+	for (i=0; i <= SHMEM_BLOCKSZ_BITS_RANGE; i++)
+	{
+		free_blocks += num_free[i] * (1L << i);
+		if (num_free[i] > 0)
+			largest_free = (1L << i);
+	}
+	if (active_blocks > 0)
+		int_frag = 1.0 - ((double) active_bytes /
+						  (double)(active_blocks * SHMEM_BLOCKSZ));
+	if (free_blocks > 0)
+		ext_frag = 1.0 - (double) largest_free / (double) free_blocks;
+
 	for (i=0; i <= SHMEM_BLOCKSZ_BITS_RANGE; i++)
 	{
 		shmem_block_info *block_info
 			= palloc(sizeof(shmem_block_info));
 		block_info->zone = zone_index;
+		block_info->numa_node = zone->numa_node;
 		block_info->shift = i;
 		block_info->num_active = num_active[i];
 		block_info->num_free = num_free[i];
+		block_info->int_frag = int_frag;
+		block_info->ext_frag = ext_frag;
 
 		results = lappend(results, block_info);
 	}
@@ -1023,8 +1875,8 @@ pgstrom_shmem_info(PG_FUNCTION_ARGS)
 	FuncCallContext	   *fncxt;
 	shmem_block_info   *block_info;
 	HeapTuple	tuple;
-	Datum		values[4];
-	bool		isnull[4];
+	Datum		values[8];
+	bool		isnull[8];
 	int			shift;
 	char		buf[32];
 
@@ -1039,7 +1891,7 @@ pgstrom_shmem_info(PG_FUNCTION_ARGS)
 		fncxt = SRF_FIRSTCALL_INIT();
 		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
 
-		tupdesc = CreateTemplateTupleDesc(4, false);
+		tupdesc = CreateTemplateTupleDesc(8, false);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "zone",
 						   INT4OID, -1, 0);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "size",
@@ -1048,13 +1900,21 @@ pgstrom_shmem_info(PG_FUNCTION_ARGS)
 						   INT8OID, -1, 0);
 		TupleDescInitEntry(tupdesc, (AttrNumber) 4, "free",
 						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 5, "pagesz",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 6, "numa_node",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 7, "int_frag",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 8, "ext_frag",
+						   FLOAT8OID, -1, 0);
 		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
 
 		for (i=0; i < pgstrom_shmem_head->num_zones; i++)
 		{
 			zone = pgstrom_shmem_head->zones[i];
 
-			SpinLockAcquire(&zone->lock);
+			pgstrom_shmem_zone_lock(zone);
 			PG_TRY();
 			{
 				List   *temp = collect_shmem_block_info(zone, i);
@@ -1063,11 +1923,11 @@ pgstrom_shmem_info(PG_FUNCTION_ARGS)
 			}
 			PG_CATCH();
 			{
-				SpinLockRelease(&zone->lock);
+				pgstrom_shmem_zone_unlock(zone);
 				PG_RE_THROW();
 			}
 			PG_END_TRY();
-			SpinLockRelease(&zone->lock);
+			pgstrom_shmem_zone_unlock(zone);
 		}
 		fncxt->user_fctx = block_info_list;
 
@@ -1095,6 +1955,10 @@ pgstrom_shmem_info(PG_FUNCTION_ARGS)
 	values[1] = CStringGetTextDatum(buf);
 	values[2] = Int64GetDatum(block_info->num_active);
 	values[3] = Int64GetDatum(block_info->num_free);
+	values[4] = Int64GetDatum(pgstrom_shmem_head->segment_pagesz);
+	values[5] = Int32GetDatum(block_info->numa_node);
+	values[6] = Float8GetDatum(block_info->int_frag);
+	values[7] = Float8GetDatum(block_info->ext_frag);
 
 	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
 
@@ -1130,9 +1994,6 @@ collect_shmem_active_info(shmem_zone *zone, int zone_index)
 		{
 			shmem_active_info *sainfo;
 			cl_uint	   *p_magic;
-			int		nshift = find_least_pot(offsetof(shmem_body, data[0]) +
-											block->blocksz +
-											sizeof(cl_uint));
 
 			body = (shmem_body *)((char *)zone->block_baseaddr +
 								  i * SHMEM_BLOCKSZ);
@@ -1150,8 +2011,7 @@ collect_shmem_active_info(shmem_zone *zone, int zone_index)
 				sainfo->overrun = true;
 			results = lappend(results, sainfo);
 
-			Assert(nshift <= SHMEM_BLOCKSZ_BITS_RANGE);
-			i += (1 << nshift);
+			i += SHMEM_BODY_NBLOCKS(block->blocksz);
 		}
 		else if (BLOCK_IS_FREE(block))
 		{
@@ -1208,7 +2068,7 @@ pgstrom_shmem_active_info(PG_FUNCTION_ARGS)
 		{
 			zone = pgstrom_shmem_head->zones[i];
 
-			SpinLockAcquire(&zone->lock);
+			pgstrom_shmem_zone_lock(zone);
 			PG_TRY();
 			{
 				List   *temp = collect_shmem_active_info(zone, i);
@@ -1217,11 +2077,11 @@ pgstrom_shmem_active_info(PG_FUNCTION_ARGS)
 			}
 			PG_CATCH();
 			{
-				SpinLockRelease(&zone->lock);
+				pgstrom_shmem_zone_unlock(zone);
 				PG_RE_THROW();
 			}
 			PG_END_TRY();
-			SpinLockRelease(&zone->lock);
+			pgstrom_shmem_zone_unlock(zone);
 		}
 		fncxt->user_fctx = active_info_list;
 
@@ -1289,6 +2149,255 @@ pgstrom_shmem_free_func(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_shmem_free_func);
 
+/*
+ * pgstrom_shmem_alloc_bench
+ *
+ * A micro benchmark of the block allocator. It repeats allocation and
+ * release of the supplied size of blocks, with a certain number of blocks
+ * kept alive to exercise split and merge of buddies, then returns average
+ * latency of a pair of alloc/free in microseconds.
+ * See bench/pg_strom_bench.sql.
+ */
+Datum
+pgstrom_shmem_alloc_bench(PG_FUNCTION_ARGS)
+{
+	Size	size = PG_GETARG_INT64(0);
+	int32	nloops = PG_GETARG_INT32(1);
+	int32	nkeeps = PG_GETARG_INT32(2);
+	void  **blocks;
+	struct timeval tv1, tv2;
+	int		i;
+
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("only superuser can run the benchmark")));
+	if (nloops < 1 || nkeeps < 1)
+		elog(ERROR, "nloops and nkeeps must be positive");
+
+	blocks = palloc0(sizeof(void *) * nkeeps);
+	PG_TRY();
+	{
+		gettimeofday(&tv1, NULL);
+		for (i=0; i < nloops; i++)
+		{
+			int		j = i % nkeeps;
+
+			if (blocks[j])
+				pgstrom_shmem_free(blocks[j]);
+			blocks[j] = pgstrom_shmem_alloc(size);
+			if (!blocks[j])
+				elog(ERROR, "out of shared memory");
+			CHECK_FOR_INTERRUPTS();
+		}
+		gettimeofday(&tv2, NULL);
+	}
+	PG_CATCH();
+	{
+		for (i=0; i < nkeeps; i++)
+		{
+			if (blocks[i])
+				pgstrom_shmem_free(blocks[i]);
+		}
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	for (i=0; i < nkeeps; i++)
+	{
+		if (blocks[i])
+			pgstrom_shmem_free(blocks[i]);
+	}
+	pfree(blocks);
+
+	PG_RETURN_FLOAT8((double) timeval_diff(&tv1, &tv2) / (double) nloops);
+}
+PG_FUNCTION_INFO_V1(pgstrom_shmem_alloc_bench);
+
+/*
+ * NUMA support routines
+ *
+ * We don't depend on libnuma, but use the kernel interface directly.
+ * If pg_strom.numa_simulate_nodes is configured, CPUs are assigned to the
+ * simulated nodes in round-robin, and memory binding is skipped, to test
+ * the placement logic on single-node machines.
+ */
+#define PGSTROM_MPOL_PREFERRED		1
+#define PGSTROM_MPOL_MF_MOVE		(1 << 1)
+
+static void
+pgstrom_init_numa(void)
+{
+	char	path[MAXPGPATH];
+	int		nodes;
+	int		node;
+	long	ncpus;
+	int	   *cpu_to_node;
+
+	if (pgstrom_numa_simulate_nodes > 0)
+	{
+		pgstrom_numa_nodes = pgstrom_numa_simulate_nodes;
+		elog(LOG, "PG-Strom: %d NUMA nodes are simulated",
+			 pgstrom_numa_nodes);
+		return;
+	}
+
+	for (nodes = 0; nodes < 64; nodes++)
+	{
+		snprintf(path, sizeof(path),
+				 "/sys/devices/system/node/node%d", nodes);
+		if (access(path, F_OK) != 0)
+			break;
+	}
+	pgstrom_numa_nodes = Max(nodes, 1);
+	if (pgstrom_numa_nodes < 2)
+		return;
+
+	/*
+	 * Build a map from CPU to NUMA node, so pgstrom_numa_current_node()
+	 * needs only sched_getcpu(), being usually served by vDSO without
+	 * system call. It is inherited to the backends and OpenCL server.
+	 */
+	ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (ncpus < 1)
+		return;
+	cpu_to_node = malloc(sizeof(int) * ncpus);
+	if (!cpu_to_node)
+		return;
+	memset(cpu_to_node, 0, sizeof(int) * ncpus);
+	for (node = 0; node < pgstrom_numa_nodes; node++)
+	{
+		FILE   *filp;
+		int		lo, hi;
+		char	sep;
+
+		snprintf(path, sizeof(path),
+				 "/sys/devices/system/node/node%d/cpulist", node);
+		filp = AllocateFile(path, "r");
+		if (!filp)
+			continue;
+		/* format is like "0-7,16-23" */
+		while (fscanf(filp, "%d", &lo) == 1)
+		{
+			hi = lo;
+			sep = fgetc(filp);
+			if (sep == '-')
+			{
+				if (fscanf(filp, "%d", &hi) != 1)
+					break;
+				sep = fgetc(filp);
+			}
+			for (; lo <= hi; lo++)
+			{
+				if (lo >= 0 && lo < ncpus)
+					cpu_to_node[lo] = node;
+			}
+			if (sep != ',')
+				break;
+		}
+		FreeFile(filp);
+	}
+	pgstrom_numa_ncpus = ncpus;
+	pgstrom_numa_cpu_to_node = cpu_to_node;
+}
+
+/*
+ * pgstrom_numa_num_nodes
+ *
+ * It returns number of NUMA nodes (including simulated ones)
+ */
+int
+pgstrom_numa_num_nodes(void)
+{
+	return pgstrom_numa_nodes;
+}
+
+/*
+ * pgstrom_numa_is_simulated
+ *
+ * It returns true, if NUMA topology is simulated
+ */
+bool
+pgstrom_numa_is_simulated(void)
+{
+	return pgstrom_numa_simulate_nodes > 0;
+}
+
+/*
+ * pgstrom_numa_node_of_address
+ *
+ * It returns NUMA node of the shared memory zone on which the supplied
+ * address belongs to, or -1 if it is out of the shared memory segment.
+ */
+int
+pgstrom_numa_node_of_address(void *address)
+{
+	void	   *zone_baseaddr = pgstrom_shmem_head->zone_baseaddr;
+	Size		zone_length = pgstrom_shmem_head->zone_length;
+	long		index;
+
+	if (pgstrom_numa_nodes < 2 ||
+		(uintptr_t)address < (uintptr_t)zone_baseaddr)
+		return -1;
+	index = ((uintptr_t)address - (uintptr_t)zone_baseaddr) / zone_length;
+	if (index >= pgstrom_shmem_head->num_zones)
+		return -1;
+	return pgstrom_shmem_head->zones[index]->numa_node;
+}
+
+/*
+ * pgstrom_numa_current_node
+ *
+ * It returns NUMA node of the CPU on which the current thread is running.
+ */
+int
+pgstrom_numa_current_node(void)
+{
+	int		cpu;
+
+	if (pgstrom_numa_nodes < 2)
+		return 0;
+
+	cpu = sched_getcpu();
+	if (cpu < 0)
+		return 0;
+	if (pgstrom_numa_simulate_nodes > 0)
+		return cpu % pgstrom_numa_nodes;
+	if (cpu < pgstrom_numa_ncpus)
+		return pgstrom_numa_cpu_to_node[cpu];
+	return 0;
+}
+
+/*
+ * pgstrom_numa_bind_memory
+ *
+ * It binds the supplied memory region to the NUMA node (preferred).
+ * Note that MPOL_MF_MOVE does not migrate shared anonymous pages, so the
+ * policy is effective only on the pages not touched yet; the segment is
+ * never touched until pgstrom_setup_shmem(), see pgstrom_startup_shmem().
+ */
+static void
+pgstrom_numa_bind_memory(void *address, Size length, int numa_node)
+{
+#ifdef SYS_mbind
+	unsigned long	nodemask = (1UL << numa_node);
+	void		   *head;
+
+	if (pgstrom_numa_nodes < 2 || pgstrom_numa_simulate_nodes > 0)
+		return;
+
+	/* mbind(2) requires page aligned address */
+	head = (void *)TYPEALIGN_DOWN(getpagesize(), address);
+	length += (char *)address - (char *)head;
+	if (syscall(SYS_mbind, head, length,
+				PGSTROM_MPOL_PREFERRED,
+				&nodemask, sizeof(nodemask) * BITS_PER_BYTE,
+				PGSTROM_MPOL_MF_MOVE) != 0)
+		elog(LOG, "PG-Strom: failed to bind %p-%p on NUMA node %d: %m",
+			 head, (char *)head + length - 1, numa_node);
+#endif
+}
+
 void
 pgstrom_setup_shmem(Size zone_length,
 					bool (*callback)(void *address, Size length,
@@ -1317,11 +2426,24 @@ pgstrom_setup_shmem(Size zone_length,
 
 	zone_length = TYPEALIGN_DOWN(SHMEM_BLOCKSZ, zone_length);
 	num_zones = (pgstrom_shmem_totalsize + zone_length - 1) / zone_length;
-	pgstrom_shmem_head->zone_baseaddr
-		= (void *)TYPEALIGN(SHMEM_BLOCKSZ,
-							&pgstrom_shmem_head->zones[num_zones]);
+	pgstrom_shmem_head->zone_baseaddr = pgstrom_shmem_head->segment_baseaddr;
 	pgstrom_shmem_head->zone_length = zone_length;
 
+	/*
+	 * Bind each zone to a NUMA node prior to host memory mapping, because
+	 * OpenCL driver may pin the pages on the node they stay right now.
+	 */
+	offset = 0;
+	for (zone_index = 0; zone_index < num_zones; zone_index++)
+	{
+		Size	length = Min(zone_length, pgstrom_shmem_totalsize - offset);
+
+		pgstrom_numa_bind_memory((char *)pgstrom_shmem_head->zone_baseaddr +
+								 offset, length,
+								 (zone_index * pgstrom_numa_nodes) / num_zones);
+		offset += length;
+	}
+
 	/* NOTE: If run-time support host mapped memory which is larger than
 	 * zone-length, we map the host memory at once.
 	 * If unavailable (rc == CL_INVALID_BUFFER_SIZE), it tries to map
@@ -1335,7 +2457,7 @@ pgstrom_setup_shmem(Size zone_length,
 		Size	length;
 		long	blkno;
 		int		shift;
-		int		i;
+		int		i, j;
 
 		length = Min(zone_length, pgstrom_shmem_totalsize - offset);
 		Assert(length > 0 && length % SHMEM_BLOCKSZ == 0);
@@ -1348,13 +2470,41 @@ pgstrom_setup_shmem(Size zone_length,
 			((char *)pgstrom_shmem_head->zone_baseaddr + offset);
 		Assert((Size)zone % SHMEM_BLOCKSZ == 0);
 
-		SpinLockInit(&zone->lock);
 		zone->num_blocks = num_blocks;
-		for (i=0; i < SHMEM_BLOCKSZ_BITS_RANGE+1; i++)
+		zone->numa_node = (zone_index * pgstrom_numa_nodes) / num_zones;
+
+		/*
+		 * length of arena is the least 2^N blocks to split the zone into
+		 * the configured number of arenas, but no more than max number
+		 * of arenas and the largest block size.
+		 */
+		zone->arena_shift =
+			get_next_log2((num_blocks + pgstrom_shmem_zone_arenas - 1) /
+						  pgstrom_shmem_zone_arenas);
+		while ((num_blocks >> zone->arena_shift) >= SHMEM_ZONE_MAX_ARENAS)
+			zone->arena_shift++;
+		zone->arena_shift = Min(zone->arena_shift, SHMEM_BLOCKSZ_BITS_RANGE);
+		zone->num_arenas = ((num_blocks + (1L << zone->arena_shift) - 1)
+							>> zone->arena_shift);
+		Assert(zone->num_arenas <= SHMEM_ZONE_MAX_ARENAS);
+
+		for (i=0; i < zone->num_arenas; i++)
 		{
-			dlist_init(&zone->free_list[i]);
-			zone->num_active[i] = 0;
-			zone->num_free[i] = 0;
+			shmem_arena	*arena = &zone->arenas[i];
+
+			SpinLockInit(&arena->lock);
+			arena->start = ((long) i << zone->arena_shift);
+			arena->num_blocks = Min(num_blocks - arena->start,
+									1L << zone->arena_shift);
+			arena->free_mask = 0;
+			arena->active_blocks = 0;
+			arena->active_bytes = 0;
+			for (j=0; j < SHMEM_BLOCKSZ_BITS_RANGE+1; j++)
+			{
+				dlist_init(&arena->free_list[j]);
+				arena->num_active[j] = 0;
+				arena->num_free[j] = 0;
+			}
 		}
 		/*
 		 * Zero clear. Non-head block has all zero field, unless it becomes
@@ -1367,17 +2517,15 @@ pgstrom_setup_shmem(Size zone_length,
 			   (uintptr_t)zone->block_baseaddr + SHMEM_BLOCKSZ * num_blocks);
 
 		blkno = 0;
-		shift = SHMEM_BLOCKSZ_BITS_RANGE;
+		shift = zone->arena_shift;
 		while (blkno < zone->num_blocks)
 		{
 			int		nblocks = (1 << shift);
 
 			if (blkno + nblocks <= zone->num_blocks)
 			{
-				zone->blocks[blkno].blocksz = SHMEM_BLOCKSZ * nblocks;
-				dlist_push_tail(&zone->free_list[shift],
-								&zone->blocks[blkno].chain);
-				zone->num_free[shift]++;
+				shmem_arena_push_free(SHMEM_ZONE_GET_ARENA(zone, blkno),
+									  shift, &zone->blocks[blkno]);
 				blkno += nblocks;
 			}
 			else if (shift > 0)
@@ -1399,23 +2547,122 @@ pgstrom_setup_shmem(Size zone_length,
 	pgstrom_shmem_head->is_ready = true;
 }
 
+/*
+ * pgstrom_shmem_map_hugepages
+ *
+ * It tries to map an anonymous shared memory region backed by huge pages,
+ * being inherited to the backend processes and OpenCL server. Returns NULL
+ * if huge pages are not available on the system.
+ */
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT	26
+#endif
+
+static void
+pgstrom_shmem_unmap_segment(int code, Datum arg)
+{
+	if (munmap(pgstrom_shmem_head->segment_mapaddr,
+			   pgstrom_shmem_head->segment_maplen) != 0)
+		elog(LOG, "failed on munmap(2) of PG-Strom's shared memory: %m");
+}
+
+static void *
+pgstrom_shmem_map_hugepages(Size length, Size pagesz)
+{
+#ifdef MAP_HUGETLB
+	void   *address;
+	int		flags = MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB;
+
+	Assert(length % pagesz == 0);
+	flags |= (ffs(pagesz) - 1) << MAP_HUGE_SHIFT;
+	address = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (address == MAP_FAILED)
+	{
+		elog(LOG, "PG-Strom: unable to map %zuMB with %zuKB huge pages: %m",
+			 length >> 20, pagesz >> 10);
+		return NULL;
+	}
+	return address;
+#else
+	elog(LOG, "PG-Strom: huge pages are not supported on this platform");
+	return NULL;
+#endif
+}
+
 static void
 pgstrom_startup_shmem(void)
 {
 	Size	length;
 	bool	found;
+	void   *segment = NULL;
+	Size	pagesz = getpagesize();
 
 	if (shmem_startup_hook_next)
 		(*shmem_startup_hook_next)();
 
-	length = MAXALIGN(offsetof(shmem_head, zones[pgstrom_shmem_maxzones])) +
-		pgstrom_shmem_totalsize + SHMEM_BLOCKSZ;
+	length = MAXALIGN(offsetof(shmem_head, zones[pgstrom_shmem_maxzones]));
+	if (pgstrom_shmem_huge_pages == SHMEM_HUGE_PAGES_OFF)
+		length += pgstrom_shmem_totalsize + SHMEM_BLOCKSZ;
 
 	pgstrom_shmem_head = ShmemInitStruct("pgstrom_shmem_head",
 										 length, &found);
 	Assert(!found);
 
-	memset(pgstrom_shmem_head, 0, length);
+	/*
+	 * NOTE: Only the header portion is initialized. The segment to be
+	 * split into zones has to be untouched until each zone is bound to
+	 * a NUMA node on pgstrom_setup_shmem(); pages are allocated on the
+	 * first touch, and mbind(2) never migrates shared pages.
+	 */
+	memset(pgstrom_shmem_head, 0,
+		   MAXALIGN(offsetof(shmem_head, zones[pgstrom_shmem_maxzones])));
+	SpinLockInit(&pgstrom_shmem_head->reserve_lock);
+
+	/*
+	 * Set up the segment to be split into zones. If huge pages are
+	 * configured, we try to map them, then falls back to regular pages
+	 * if unavailable.
+	 */
+	if (pgstrom_shmem_huge_pages != SHMEM_HUGE_PAGES_OFF)
+	{
+		Size	hugepagesz = ((Size)pgstrom_shmem_huge_pages) << 10;
+
+		/*
+		 * Huge pages are larger than SHMEM_BLOCKSZ, so the segment is
+		 * already aligned. Elsewhere, mmap(2) returns an address aligned
+		 * to the page size only, so we map one more block to align the
+		 * zone base to SHMEM_BLOCKSZ.
+		 */
+		Assert(hugepagesz % SHMEM_BLOCKSZ == 0);
+		length = TYPEALIGN(hugepagesz, pgstrom_shmem_totalsize);
+		segment = pgstrom_shmem_map_hugepages(length, hugepagesz);
+		if (segment)
+			pagesz = hugepagesz;
+		else
+		{
+			length = TYPEALIGN(pagesz,
+							   pgstrom_shmem_totalsize + SHMEM_BLOCKSZ);
+			segment = mmap(NULL, length,
+						   PROT_READ | PROT_WRITE,
+						   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+			if (segment == MAP_FAILED)
+				elog(ERROR, "failed to map PG-Strom's shared memory: %m");
+			elog(LOG, "PG-Strom: shared memory falls back to regular pages");
+		}
+		pgstrom_shmem_head->segment_mapaddr = segment;
+		pgstrom_shmem_head->segment_maplen = length;
+		pgstrom_shmem_head->segment_baseaddr =
+			(void *)TYPEALIGN(SHMEM_BLOCKSZ, segment);
+		on_shmem_exit(pgstrom_shmem_unmap_segment, 0);
+	}
+	else
+	{
+		pgstrom_shmem_head->segment_baseaddr = (void *)
+			TYPEALIGN(SHMEM_BLOCKSZ,
+					  &pgstrom_shmem_head->zones[pgstrom_shmem_maxzones]);
+	}
+	pgstrom_shmem_head->segment_pagesz = pagesz;
+
 	/* initialize fields for slabs */
 	pgstrom_init_slab();
 }
@@ -1451,16 +2698,79 @@ pgstrom_init_shmem(void)
 							GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
 
+	DefineCustomIntVariable("pg_strom.shmem_zone_arenas",
+							"number of sub-arenas per shared memory zone",
+							NULL,
+							&pgstrom_shmem_zone_arenas,
+							4,
+							1,
+							SHMEM_ZONE_MAX_ARENAS,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
+	DefineCustomEnumVariable("pg_strom.shmem_huge_pages",
+							 "page size to back shared memory segment",
+							 "It falls back to regular pages if not available",
+							 &pgstrom_shmem_huge_pages,
+							 SHMEM_HUGE_PAGES_OFF,
+							 shmem_huge_pages_options,
+							 PGC_POSTMASTER,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pg_strom.numa_simulate_nodes",
+							"number of simulated NUMA nodes (0 = real topology)",
+							NULL,
+							&pgstrom_numa_simulate_nodes,
+							0,
+							0,
+							64,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	pgstrom_init_numa();
+
+	DefineCustomIntVariable("pg_strom.shmem_reservable",
+							"percentage of shared memory to be reserved",
+							NULL,
+							&pgstrom_shmem_reservable,
+							80,
+							1,
+							100,
+							PGC_SIGHUP,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pg_strom.shmem_reserve_timeout",
+							"timeout to wait for shared memory reservation",
+							NULL,
+							&pgstrom_shmem_reserve_timeout,
+							10000,	/* 10sec */
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_MS,
+							NULL, NULL, NULL);
+	RegisterXactCallback(pgstrom_shmem_reserve_xact_callback, NULL);
+
 	pgstrom_shmem_totalsize = ((Size)shmem_totalsize) << 20;
+	/* round up to the huge page size, if any */
+	if (pgstrom_shmem_huge_pages != SHMEM_HUGE_PAGES_OFF)
+		pgstrom_shmem_totalsize =
+			TYPEALIGN(((Size)pgstrom_shmem_huge_pages) << 10,
+					  pgstrom_shmem_totalsize);
 
 	/* Acquire shared memory segment */
 	length = offsetof(shmem_head, zones[pgstrom_shmem_maxzones]);
 	RequestAddinShmemSpace(MAXALIGN(length));
 	/*
-	 * XXX - to be replaced with dynamic shared memory or system
-	 *       mmap(2) on hugetlbfs in the future.
+	 * XXX - to be replaced with dynamic shared memory in the future.
+	 * If huge pages are configured, the segment is mapped by ourselves
+	 * on startup time instead.
 	 */
-	RequestAddinShmemSpace(pgstrom_shmem_totalsize + SHMEM_BLOCKSZ);
+	if (pgstrom_shmem_huge_pages == SHMEM_HUGE_PAGES_OFF)
+		RequestAddinShmemSpace(pgstrom_shmem_totalsize + SHMEM_BLOCKSZ);
 
 	shmem_startup_hook_next = shmem_startup_hook;
 	shmem_startup_hook = pgstrom_startup_shmem;